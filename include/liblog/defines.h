@@ -54,6 +54,14 @@
  */
 #define _LL_LINE __stringify(__LINE__)
 
+/**
+ * @def _LL_FIRST
+ *
+ * Provide first of variadic arguments, mostly format string.
+ */
+#define _LL_FIRST(...) _LL_FIRST_(__VA_ARGS__, 0)
+#define _LL_FIRST_(X, ...) X
+
 /**
  * @def _LL_ARGS
  *
@@ -76,6 +84,29 @@
 #	define _LL_ARGS(...) __FILE__ ":" _LL_LINE " " __VA_ARGS__
 #endif /* NDEBUG */
 
+/**
+ * @def _LL_UNLIKELY
+ *
+ * Hint to compiler, that condition is usually false.
+ */
+#ifdef __GNUC__
+#	define _LL_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#	define _LL_UNLIKELY(x) (x)
+#endif /* __GNUC__ */
+
+/**
+ * @def _LL_PRINTF
+ *
+ * Ask compiler to check arguments of printf-like function,
+ * FMT and ARGS are positions of format string and first argument.
+ */
+#ifdef __GNUC__
+#	define _LL_PRINTF(FMT, ARGS) __attribute__((format(printf, FMT, ARGS)))
+#else
+#	define _LL_PRINTF(FMT, ARGS)
+#endif /* __GNUC__ */
+
 /** @} */
 
 /*------------------------------------------------------------------------*/
@@ -101,6 +132,126 @@
 
 /*------------------------------------------------------------------------*/
 
+/**
+ * @defgroup liblog_typed_macros Typed call sites
+ * @brief Compile-time description of message arguments
+ *
+ * If application defines `LIBLOG_TYPED` before including liblog headers
+ * (C11 or C++11 is required), every logging macro emits static descriptor
+ * with types of its arguments. Descriptor is checked against format string
+ * once per call site, on mismatch message is always formatted immediately
+ * instead of deferred formatting by async thread.
+ *
+ * For C++14 and later format string is also checked at compile time, so
+ * mismatch is reported by `static_assert`. C code is checked by compiler
+ * with `-Wformat` anyway.
+ *
+ * Up to @ref _LL_ARGS_MAX arguments (including format string) are allowed.
+ * @{
+ */
+
+#define _LL_ARG_NONE		0	/**< No argument, "%%" */
+#define _LL_ARG_INT		1	/**< int, also char and short */
+#define _LL_ARG_LONG		2	/**< long */
+#define _LL_ARG_LLONG		3	/**< long long */
+#define _LL_ARG_INTMAX		4	/**< intmax_t */
+#define _LL_ARG_SIZE		5	/**< size_t */
+#define _LL_ARG_PTRDIFF		6	/**< ptrdiff_t */
+#define _LL_ARG_DOUBLE		7	/**< double, also float */
+#define _LL_ARG_LDOUBLE		8	/**< long double */
+#define _LL_ARG_PTR		9	/**< void * */
+#define _LL_ARG_STR		10	/**< const char * */
+
+/** Maximal number of arguments of typed call site */
+#define _LL_ARGS_MAX 16
+
+/**
+ * @def _LL_SITE
+ *
+ * Define static call site for arguments of logging macro.
+ */
+#if !defined(LIBLOG_TYPED)
+#	define _LL_SITE(...) static struct ll_site _ll_site
+#elif defined(__cplusplus) && __cplusplus >= 201103L
+#	if __cplusplus >= 201402L
+#		define _LL_SITE_CHECK(...)                                \
+	static_assert(ll_typed::check(_LL_FIRST(__VA_ARGS__),             \
+		decltype(ll_typed::of(__VA_ARGS__))::type,                \
+		decltype(ll_typed::of(__VA_ARGS__))::desc.n),             \
+		"format string doesn't match arguments")
+#	else
+#		define _LL_SITE_CHECK(...) static_assert(true, "")
+#	endif /* __cplusplus >= 201402L */
+
+#	define _LL_SITE(...)                                              \
+	_LL_SITE_CHECK(__VA_ARGS__);                                      \
+	static struct ll_site _ll_site = { NULL, NULL, NULL, NULL,        \
+		&decltype(ll_typed::of(__VA_ARGS__))::desc }
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+/** Type of argument, see enum ll_arg */
+#	define _LL_ARG_OF(X) _Generic((X),                                \
+		_Bool: _LL_ARG_INT,                                       \
+		char: _LL_ARG_INT,                                        \
+		signed char: _LL_ARG_INT,                                 \
+		unsigned char: _LL_ARG_INT,                               \
+		short: _LL_ARG_INT,                                       \
+		unsigned short: _LL_ARG_INT,                              \
+		int: _LL_ARG_INT,                                         \
+		unsigned: _LL_ARG_INT,                                    \
+		long: _LL_ARG_LONG,                                       \
+		unsigned long: _LL_ARG_LONG,                              \
+		long long: _LL_ARG_LLONG,                                 \
+		unsigned long long: _LL_ARG_LLONG,                        \
+		float: _LL_ARG_DOUBLE,                                    \
+		double: _LL_ARG_DOUBLE,                                   \
+		long double: _LL_ARG_LDOUBLE,                             \
+		char *: _LL_ARG_STR,                                      \
+		const char *: _LL_ARG_STR,                                \
+		default: _LL_ARG_PTR)
+
+/** Count arguments, up to @ref _LL_ARGS_MAX */
+#	define _LL_NARGS(...) _LL_NARGS_(__VA_ARGS__,                     \
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#	define _LL_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11,   \
+		_12, _13, _14, _15, _16, N, ...) N
+
+/** Apply macro M to each argument */
+#	define _LL_MAP(M, ...) _LL_MAP_N(_LL_NARGS(__VA_ARGS__), M, __VA_ARGS__)
+#	define _LL_MAP_N(N, M, ...) _LL_MAP__N(N, M, __VA_ARGS__)
+#	define _LL_MAP__N(N, M, ...) _LL_MAP_##N(M, __VA_ARGS__)
+#	define _LL_MAP_1(M, X) M(X)
+#	define _LL_MAP_2(M, X, ...) M(X), _LL_MAP_1(M, __VA_ARGS__)
+#	define _LL_MAP_3(M, X, ...) M(X), _LL_MAP_2(M, __VA_ARGS__)
+#	define _LL_MAP_4(M, X, ...) M(X), _LL_MAP_3(M, __VA_ARGS__)
+#	define _LL_MAP_5(M, X, ...) M(X), _LL_MAP_4(M, __VA_ARGS__)
+#	define _LL_MAP_6(M, X, ...) M(X), _LL_MAP_5(M, __VA_ARGS__)
+#	define _LL_MAP_7(M, X, ...) M(X), _LL_MAP_6(M, __VA_ARGS__)
+#	define _LL_MAP_8(M, X, ...) M(X), _LL_MAP_7(M, __VA_ARGS__)
+#	define _LL_MAP_9(M, X, ...) M(X), _LL_MAP_8(M, __VA_ARGS__)
+#	define _LL_MAP_10(M, X, ...) M(X), _LL_MAP_9(M, __VA_ARGS__)
+#	define _LL_MAP_11(M, X, ...) M(X), _LL_MAP_10(M, __VA_ARGS__)
+#	define _LL_MAP_12(M, X, ...) M(X), _LL_MAP_11(M, __VA_ARGS__)
+#	define _LL_MAP_13(M, X, ...) M(X), _LL_MAP_12(M, __VA_ARGS__)
+#	define _LL_MAP_14(M, X, ...) M(X), _LL_MAP_13(M, __VA_ARGS__)
+#	define _LL_MAP_15(M, X, ...) M(X), _LL_MAP_14(M, __VA_ARGS__)
+#	define _LL_MAP_16(M, X, ...) M(X), _LL_MAP_15(M, __VA_ARGS__)
+
+#	define _LL_SITE(...)                                              \
+	static const unsigned char _ll_type[] = {                         \
+		_LL_MAP(_LL_ARG_OF, __VA_ARGS__)                          \
+	};                                                                \
+	static const struct ll_args _ll_args = {                          \
+		sizeof(_ll_type), _ll_type                                \
+	};                                                                \
+	static struct ll_site _ll_site = { .args = &_ll_args }
+#else
+#	error "LIBLOG_TYPED requires C11 or C++11"
+#endif /* LIBLOG_TYPED */
+
+/** @} */
+
+/*------------------------------------------------------------------------*/
+
 /**
  * @defgroup liblog_extended_macros Extended logging
  * @brief Logging macros to specified namespace
@@ -121,19 +272,133 @@
  * @{
  */
 
+/**
+ * @brief Logging macro with extra condition of call site
+ * @param [in] NAMESPACE namespace of message
+ * @param [in] LEVEL logging level of message
+ * @param [in] DECL static declaration of call site (can be empty)
+ * @param [in] PASS condition, checked after logging level
+ */
+#define _LL_PR(NAMESPACE, LEVEL, DECL, PASS, ...)                         \
+do {                                                                      \
+	if (_LIBLOG_##NAMESPACE##_LEVEL >= LEVEL) {                       \
+		_LL_SITE(__VA_ARGS__);                                    \
+		DECL;                                                     \
+		const enum ll_level *_ll_level = __atomic_load_n(         \
+			&_ll_site.level, __ATOMIC_ACQUIRE);               \
+                                                                          \
+		if (_LL_UNLIKELY(!_ll_level)) {                           \
+			_ll_level = ll_site_bind(&_ll_site, #NAMESPACE);  \
+		}                                                         \
+                                                                          \
+		if (_LL_UNLIKELY((LEVEL) <= (int)__atomic_load_n(         \
+			_ll_level, __ATOMIC_RELAXED)) && (PASS)) {        \
+			ll_printf_site(&_ll_site, (enum ll_level)(LEVEL), \
+				_LL_ARGS(__VA_ARGS__));                   \
+		}                                                         \
+	}                                                                 \
+} while (0)
+
 /**
  * @brief Core logging macro, which call logging routine
  * @param [in] NAMESPACE namespace of message
  * @param [in] LEVEL logging level of message
  *
+ * Namespace is looked up only by first message of call site,
+ * further messages use cached pointer to logging level of namespace.
+ * If message is filtered by run-time logging level, arguments of message
+ * are not evaluated at all.
  */
 #define LL_PR(NAMESPACE, LEVEL, ...)                                      \
+	_LL_PR(NAMESPACE, LEVEL, , 1, __VA_ARGS__)
+
+/**
+ * @def _LL_RATE
+ *
+ * Define static rate limit of call site.
+ */
+#define _LL_RATE(RATE, BURST)                                             \
+	static struct ll_rate _ll_rate = { RATE, BURST, 0, 0, 0 }
+
+/**
+ * @brief Logging macro with rate limit of call site
+ * @param [in] NAMESPACE namespace of message
+ * @param [in] LEVEL logging level of message
+ * @param [in] RATE messages per second
+ * @param [in] BURST number of messages allowed at once
+ *
+ * Suppressed messages are not formatted and their arguments are not
+ * evaluated, number of them is logged once per second.
+ */
+#define LL_PR_LIMIT(NAMESPACE, LEVEL, RATE, BURST, ...)                   \
+	_LL_PR(NAMESPACE, LEVEL, _LL_RATE(RATE, BURST),                   \
+		ll_site_rate(&_ll_site, &_ll_rate,                        \
+			(enum ll_level)(LEVEL),                           \
+			_LL_FIRST(_LL_ARGS(__VA_ARGS__))), __VA_ARGS__)
+
+/**
+ * @brief Logging macro with deterministic sampling
+ * @param [in] NAMESPACE namespace of message
+ * @param [in] LEVEL logging level of message
+ * @param [in] TRACE trace id of message, 64-bit integer
+ *
+ * If namespace is sampled, messages with the same trace id are either
+ * all kept or all dropped, see "sample" option of namespace.
+ */
+#define LL_PR_TRACE(NAMESPACE, LEVEL, TRACE, ...)                         \
+	_LL_PR(NAMESPACE, LEVEL, , ll_sample_trace(TRACE), __VA_ARGS__)
+
+/**
+ * @brief Structured logging macro
+ * @param [in] NAMESPACE namespace of message
+ * @param [in] LEVEL logging level of message
+ * @param [in] MSG message, string literal and not a format string
+ *
+ * Other arguments are fields made by LL_F_* macros. If message is
+ * filtered by run-time logging level, fields are not evaluated at all.
+ */
+#define LL_PR_KV(NAMESPACE, LEVEL, MSG, ...)                              \
 do {                                                                      \
 	if (_LIBLOG_##NAMESPACE##_LEVEL >= LEVEL) {                       \
-		ll_printf(#NAMESPACE, LEVEL, _LL_ARGS(__VA_ARGS__));      \
+		static struct ll_site _ll_site;                           \
+		const enum ll_level *_ll_level = __atomic_load_n(         \
+			&_ll_site.level, __ATOMIC_ACQUIRE);               \
+                                                                          \
+		if (_LL_UNLIKELY(!_ll_level)) {                           \
+			_ll_level = ll_site_bind(&_ll_site, #NAMESPACE);  \
+		}                                                         \
+                                                                          \
+		if (_LL_UNLIKELY((LEVEL) <= (int)__atomic_load_n(         \
+			_ll_level, __ATOMIC_RELAXED))) {                  \
+			const struct ll_field _ll_kv[] = { __VA_ARGS__ }; \
+                                                                          \
+			ll_log_kv_site(&_ll_site, (enum ll_level)(LEVEL), \
+				_LL_ARGS(MSG), _ll_kv,                    \
+				sizeof(_ll_kv) / sizeof(_ll_kv[0]));      \
+		}                                                         \
 	}                                                                 \
 } while (0)
 
+/** Signed integer field of structured message, KEY is string literal */
+#define LL_F_INT(KEY, VAL) ll_field_int("" KEY, sizeof(KEY) - 1, (VAL))
+
+/** Unsigned integer field of structured message */
+#define LL_F_UINT(KEY, VAL) ll_field_uint("" KEY, sizeof(KEY) - 1, (VAL))
+
+/** Floating point field of structured message */
+#define LL_F_DOUBLE(KEY, VAL)                                             \
+	ll_field_double("" KEY, sizeof(KEY) - 1, (VAL))
+
+/** Boolean field of structured message */
+#define LL_F_BOOL(KEY, VAL) ll_field_bool("" KEY, sizeof(KEY) - 1, (VAL))
+
+/** String field of structured message */
+#define LL_F_STR(KEY, VAL) ll_field_str("" KEY, sizeof(KEY) - 1, (VAL))
+
+/** String field of structured message with known length */
+#define LL_F_STRN(KEY, VAL, LEN)                                          \
+	ll_field_strn("" KEY, sizeof(KEY) - 1, (VAL), (LEN))
+
 /**
  * @brief Print emergency message to specific namespace and abort the program
  * @param [in] NAMESPACE namespace of message
@@ -240,6 +505,17 @@ do {                                                                      \
 /** Print debug message to default namespace */
 #define LL_DEBUG(...) LL_PR(, _LL_LEVEL_DEBUG, __VA_ARGS__)
 
+/** Print message to default namespace with rate limit of call site */
+#define LL_LIMIT(LEVEL, RATE, BURST, ...)                                 \
+	LL_PR_LIMIT(, LEVEL, RATE, BURST, __VA_ARGS__)
+
+/** Print message to default namespace with sampling by trace id */
+#define LL_TRACE(LEVEL, TRACE, ...)                                       \
+	LL_PR_TRACE(, LEVEL, TRACE, __VA_ARGS__)
+
+/** Print structured message to default namespace */
+#define LL_KV(LEVEL, MSG, ...) LL_PR_KV(, LEVEL, MSG, __VA_ARGS__)
+
 /** @} */
 
 /** @} */
@@ -20,8 +20,14 @@
 #ifndef __LIBLOG_LOG_H
 #define __LIBLOG_LOG_H
 
+#include <stdint.h>
+#include <string.h>
 #include <liblog/types.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
 /**
  * @defgroup liblog_functions Functions
  * @brief Defines functions for liblog configuration and message logging
@@ -36,15 +42,224 @@
  * @return on success, zero is returned
  * @retval -1 error occurred
  */
-int ll_printf(const char *name, enum ll_level level, const char *format, ...);
+int ll_printf(const char *name, enum ll_level level, const char *format, ...)
+	_LL_PRINTF(3, 4);
+
+/**
+ * @brief Log message according to format to resolved namespace
+ * @param [in] ns pointer to namespace (can be NULL)
+ * @param [in] level logging level of message
+ * @param [in] format format string of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_printf_ns(struct ll_namespace *ns, enum ll_level level,
+	const char *format, ...) _LL_PRINTF(3, 4);
+
+/**
+ * @brief Log message of call site
+ * @param [in] site pointer to bound call site
+ * @param [in] level logging level of message
+ * @param [in] format format string of message, should be string literal
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_printf_site(struct ll_site *site, enum ll_level level,
+	const char *format, ...) _LL_PRINTF(3, 4);
+
+/**
+ * @brief Log structured message to namespace
+ * @param [in] name namespace
+ * @param [in] level logging level of message
+ * @param [in] msg message, it's not a format string
+ * @param [in] fields key/value fields of message
+ * @param [in] n number of fields
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Fields are encoded directly to encoding of every logger, without
+ * printf-like formatting and heap allocation.
+ */
+int ll_log_kv(const char *name, enum ll_level level, const char *msg,
+	const struct ll_field *fields, size_t n);
+
+/**
+ * @brief Log structured message of call site
+ * @param [in] site pointer to bound call site
+ * @param [in] level logging level of message
+ * @param [in] msg message, it's not a format string
+ * @param [in] fields key/value fields of message
+ * @param [in] n number of fields
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_log_kv_site(struct ll_site *site, enum ll_level level,
+	const char *msg, const struct ll_field *fields, size_t n);
+
+/**
+ * @brief Make signed integer field, see @ref LL_F_INT
+ * @param [in] key key of field
+ * @param [in] key_len length of key
+ * @param [in] v value of field
+ * @return field
+ */
+static inline struct ll_field ll_field_int(const char *key,
+	size_t key_len, int64_t v) {
+	struct ll_field f;
+
+	f.key = key;
+	f.key_len = key_len;
+	f.type = LL_FIELD_INT;
+	f.v.i = v;
+	f.len = 0;
+
+	return (f);
+}
+
+/**
+ * @brief Make unsigned integer field, see @ref LL_F_UINT
+ * @param [in] key key of field
+ * @param [in] key_len length of key
+ * @param [in] v value of field
+ * @return field
+ */
+static inline struct ll_field ll_field_uint(const char *key,
+	size_t key_len, uint64_t v) {
+	struct ll_field f;
+
+	f.key = key;
+	f.key_len = key_len;
+	f.type = LL_FIELD_UINT;
+	f.v.u = v;
+	f.len = 0;
+
+	return (f);
+}
+
+/**
+ * @brief Make floating point field, see @ref LL_F_DOUBLE
+ * @param [in] key key of field
+ * @param [in] key_len length of key
+ * @param [in] v value of field
+ * @return field
+ */
+static inline struct ll_field ll_field_double(const char *key,
+	size_t key_len, double v) {
+	struct ll_field f;
+
+	f.key = key;
+	f.key_len = key_len;
+	f.type = LL_FIELD_DOUBLE;
+	f.v.d = v;
+	f.len = 0;
+
+	return (f);
+}
+
+/**
+ * @brief Make boolean field, see @ref LL_F_BOOL
+ * @param [in] key key of field
+ * @param [in] key_len length of key
+ * @param [in] v value of field
+ * @return field
+ */
+static inline struct ll_field ll_field_bool(const char *key,
+	size_t key_len, int v) {
+	struct ll_field f;
+
+	f.key = key;
+	f.key_len = key_len;
+	f.type = LL_FIELD_BOOL;
+	f.v.b = !!v;
+	f.len = 0;
+
+	return (f);
+}
+
+/**
+ * @brief Make string field with known length, see @ref LL_F_STRN
+ * @param [in] key key of field
+ * @param [in] key_len length of key
+ * @param [in] s value of field, NULL is logged as "(null)"
+ * @param [in] len length of value
+ * @return field
+ */
+static inline struct ll_field ll_field_strn(const char *key,
+	size_t key_len, const char *s, size_t len) {
+	struct ll_field f;
+
+	f.key = key;
+	f.key_len = key_len;
+	f.type = LL_FIELD_STR;
+	f.v.s = s ? s : "(null)";
+	f.len = s ? len : 6;
+
+	return (f);
+}
+
+/**
+ * @brief Make string field, see @ref LL_F_STR
+ * @param [in] key key of field
+ * @param [in] key_len length of key
+ * @param [in] s null-terminated value of field (can be NULL)
+ * @return field
+ */
+static inline struct ll_field ll_field_str(const char *key,
+	size_t key_len, const char *s) {
+	return (ll_field_strn(key, key_len, s, s ? strlen(s) : 0));
+}
+
+/**
+ * @brief Resolve namespace of call site
+ * @param [in] site pointer to call site
+ * @param [in] name namespace
+ * @return pointer to logging level of namespace
+ *
+ * On error, pointer to @ref LL_LEVEL_INVALID is returned and call site
+ * stays unbound. Call site is reset back by ll_cleanup().
+ */
+const enum ll_level *ll_site_bind(struct ll_site *site, const char *name);
+
+/**
+ * @brief Apply rate limit of call site
+ * @param [in] site pointer to bound call site
+ * @param [in] rate pointer to rate limit of call site
+ * @param [in] level logging level of message
+ * @param [in] format format string of message
+ * @return non-zero, if message can be logged
+ *
+ * Used by @ref LL_PR_LIMIT, before arguments of message are evaluated.
+ * Suppressed messages are summarized once per second.
+ */
+int ll_site_rate(struct ll_site *site, struct ll_rate *rate,
+	enum ll_level level, const char *format);
+
+/**
+ * @brief Set trace id of next message of current thread
+ * @param [in] id trace id, given by caller
+ * @return always one
+ *
+ * Used by @ref LL_PR_TRACE. Sampling of next message is decided by hash
+ * of trace id instead of random number, so all messages with the same
+ * trace id are either kept or dropped together.
+ */
+int ll_sample_trace(uint64_t id);
 
 /**
  * @brief Setup logging namespace
  * @param [in] name namespace name
  * @param [in] level logging level of namespace
- * @param [in] uri logger parameters in URI format
+ * @param [in] uri logger parameters in URI format, empty for stderr
  * @return on success, zero is returned
  * @retval -1 error occurred
+ *
+ * It's safe to call it while other threads are logging, they are never
+ * blocked. New logger is switched atomically, old one is closed after
+ * all messages being written by it are done.
+ *
+ * Several loggers can be given by space-separated URIs, every one can
+ * have own logging level by option "level", like "ring:crash.log?level=7".
+ * Message is formatted once for all of them.
  */
 int ll_setup(const char *name, enum ll_level level, const char *uri);
 
@@ -65,6 +280,94 @@ enum ll_level ll_level_set(const char *name, enum ll_level level);
  */
 const char *ll_level_str(enum ll_level level);
 
+/**
+ * @brief Start asynchronous logging
+ * @param [in] size size of ring buffer of every thread in bytes
+ * @param [in] policy what to do, if ring buffer is full
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Messages are formatted by calling thread into own ring buffer,
+ * and written to loggers by dedicated writer thread.
+ */
+int ll_async_start(size_t size, enum ll_async_policy policy);
+
+/**
+ * @brief Stop asynchronous logging
+ *
+ * All queued messages are written before return. Should not be called,
+ * while other threads are logging.
+ */
+void ll_async_stop(void);
+
+/**
+ * @brief Enable deferred formatting of asynchronous logging
+ * @param [in] enable non-zero to enable
+ * @return previous state
+ *
+ * Messages of logging macros are not formatted by calling thread,
+ * only their arguments are copied. Formatting is done by writer thread.
+ */
+int ll_async_deferred(int enable);
+
+/**
+ * @brief Return number of messages dropped by asynchronous logging
+ * @return number of dropped messages
+ */
+uint64_t ll_async_dropped(void);
+
+/**
+ * @brief Write buffered messages of namespace and reopen its log
+ * @param [in] name namespace name
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Useful for logrotate, messages queued by asynchronous logging
+ * are written before.
+ */
+int ll_flush(const char *name);
+
+/**
+ * @brief Write buffered messages of all namespaces and reopen their logs
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_flush_all(void);
+
+/**
+ * @brief Enable statistics of namespaces
+ * @param [in] enable non-zero to enable
+ * @return previous state
+ *
+ * Counters are kept in shards per CPU, so logging threads don't contend
+ * on them. Time of every logger call is measured, that costs two reads
+ * of monotonic clock per message. Messages filtered by logging macros
+ * are never counted, they don't reach liblog at all.
+ */
+int ll_stats_enable(int enable);
+
+/**
+ * @brief Return statistics of namespace
+ * @param [in] name namespace name
+ * @param [out] st statistics
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Shards are summed on every call, so it's not intended for hot path.
+ */
+int ll_stats(const char *name, struct ll_stats *st);
+
+/**
+ * @brief Log statistics of all namespaces
+ * @param [in] name namespace, which receives statistics
+ * @param [in] level logging level of statistics
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * One line per namespace with collected statistics is logged.
+ */
+int ll_stats_dump(const char *name, enum ll_level level);
+
 /** Clean all memory used by liblog */
 void ll_cleanup(void);
 
@@ -77,6 +380,23 @@ void ll_cleanup(void);
  * @{
  */
 
+/**
+ * @brief Render log line for custom logger
+ * @param [out] rec rendered record
+ * @param [in] name namespace of message
+ * @param [in] level logging level of message
+ * @param [in] ts resolution of timestamp
+ * @param [in] format format of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Line is formatted into buffer of current thread without any locking,
+ * so logger can write it by one call, like write(fd, rec.line, rec.len).
+ */
+int ll_record_render(struct ll_record *rec, const char *name,
+	enum ll_level level, enum ll_ts ts, const char *format, va_list args);
+
 /**
  * @brief Register custom  logger in liblog
  * @param [in] logger callbacks info of logger
@@ -87,4 +407,8 @@ int ll_logger_custom(const struct ll_logger *logger);
 
 /** @} */
 
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
 #endif /* __LIBLOG_LOG_H */
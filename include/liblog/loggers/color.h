@@ -33,6 +33,9 @@
  *
  * Accepted URI for this logger type is:
  * @li color:
+ *
+ * Optional query parameters:
+ * @li ts=s|ms|us|ns - resolution of timestamps, seconds by default
  */
 int ll_logger_color(void);
 
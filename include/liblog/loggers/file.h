@@ -34,6 +34,29 @@
  * Accepted URI for this logger type is:
  * @li file:/FILENAME - absolute path
  * @li file:FILENAME - local path
+ *
+ * Optional query parameters:
+ * @li ts=s|ms|us|ns - resolution of timestamps, seconds by default
+ * @li buffer=SIZE - size of buffer with K, M or G suffix, 64K by default,
+ * 0 to write every message at once
+ * @li flush_ms=MS - write buffer periodically by separate thread,
+ * disabled by default
+ * @li flush_level=LEVEL - write buffer after message with this level
+ * or more important, ERR by default
+ * @li engine=write|uring - submit buffers by io_uring and continue
+ * with next one from pool, plain write() is used if io_uring
+ * is not available or file is not regular
+ * @li rotate_size=SIZE - rotate file, when it becomes bigger
+ * @li rotate_time=SEC - rotate file with this period
+ * @li compress=gzip|zstd - compress rotated files by external program
+ * @li hup=1 - reopen file on SIGHUP, also done by ll_flush()
+ *
+ * Rotated file is renamed to FILENAME.YYYYmmdd-HHMMSS. File is rotated
+ * by size before write, which would make it bigger than limit,
+ * and by time in separate thread, which also compresses rotated files.
+ *
+ * Messages are written by one system call, when buffer is full,
+ * after important message or on close.
  */
 int ll_logger_file(void);
 
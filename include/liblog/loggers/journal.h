@@ -0,0 +1,55 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_JOURNAL_LOGGER_H
+#define __LIBLOG_JOURNAL_LOGGER_H
+
+/**
+ * @addtogroup liblog_loggers
+ *
+ * @{
+ */
+
+/**
+ * @brief Register systemd journal logger in liblog
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Accepted URI for this logger type is:
+ * @li journal: - journal socket /run/systemd/journal/socket
+ * @li journal:/SOCKET - absolute path of Unix datagram socket
+ *
+ * Optional query parameters:
+ * @li facility=NAME - syslog facility by name or number, "user" by default
+ * @li ident=NAME - SYSLOG_IDENTIFIER, name of program by default
+ * @li queue=N - number of queued messages, 512 by default
+ * @li size=SIZE - maximum size of message with fields, longer ones are
+ * dropped, 4K by default
+ *
+ * Messages are sent by native journal protocol with PRIORITY, MESSAGE,
+ * SYSLOG_IDENTIFIER, SYSLOG_FACILITY, SYSLOG_PID and LIBLOG_NAMESPACE
+ * fields. Fields of structured messages are sent as journal fields,
+ * their keys are upper-cased. Messages are queued and sent like by
+ * ll_logger_syslog().
+ */
+int ll_logger_journal(void);
+
+/** @} */
+
+#endif /* __LIBLOG_JOURNAL_LOGGER_H */
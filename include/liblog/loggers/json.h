@@ -0,0 +1,53 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_JSON_LOGGER_H
+#define __LIBLOG_JSON_LOGGER_H
+
+/**
+ * @addtogroup liblog_loggers
+ *
+ * @{
+ */
+
+/**
+ * @brief Register JSON lines logger in liblog
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Accepted URI for this logger type is:
+ * @li json: - standard error output
+ * @li json:/FILENAME - absolute path
+ * @li json:FILENAME - local path
+ *
+ * Optional query parameters:
+ * @li ts=s|ms|us|ns - resolution of timestamps, seconds by default
+ *
+ * Every message is written as one JSON object per line:
+ * @code
+ * {"ts":1500000000.123,"ns":"MY","level":"INFO","msg":"done","bytes":512}
+ * @endcode
+ * Fields of structured messages follow "msg" key. File is opened for
+ * appending, and every line is written by one call.
+ */
+int ll_logger_json(void);
+
+/** @} */
+
+#endif /* __LIBLOG_JSON_LOGGER_H */
@@ -0,0 +1,51 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_MMAP_LOGGER_H
+#define __LIBLOG_MMAP_LOGGER_H
+
+/**
+ * @addtogroup liblog_loggers
+ *
+ * @{
+ */
+
+/**
+ * @brief Register memory-mapped file logger in liblog
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Accepted URI for this logger type is:
+ * @li mmap:/FILENAME - absolute path
+ * @li mmap:FILENAME - local path
+ *
+ * Optional query parameters:
+ * @li ts=s|ms|us|ns - resolution of timestamps, seconds by default
+ * @li size=SIZE - size of segment with K, M or G suffix, 64M by default
+ *
+ * Log is written to preallocated segments FILENAME, FILENAME.1, ..
+ * mapped to memory, messages are copied there without system calls.
+ * Next segment is prepared by separate thread, filled segment is
+ * truncated to its data and unmapped.
+ */
+int ll_logger_mmap(void);
+
+/** @} */
+
+#endif /* __LIBLOG_MMAP_LOGGER_H */
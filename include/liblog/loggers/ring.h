@@ -0,0 +1,59 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_RING_LOGGER_H
+#define __LIBLOG_RING_LOGGER_H
+
+/**
+ * @addtogroup liblog_loggers
+ *
+ * @{
+ */
+
+/**
+ * @brief Register in-memory flight recorder in liblog
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Accepted URI for this logger type is:
+ * @li ring:/FILENAME - absolute path of dump
+ * @li ring:FILENAME - local path of dump
+ *
+ * Optional query parameters:
+ * @li ts=s|ms|us|ns - resolution of timestamps, microseconds by default
+ * @li size=SIZE - size of ring of each thread with K, M or G suffix,
+ * 1M by default
+ *
+ * Messages are kept in preallocated ring of every logging thread,
+ * older messages are overwritten by newer ones and nothing is written,
+ * until program receives SIGSEGV, SIGBUS, SIGFPE, SIGILL or SIGABRT
+ * (raised by @ref LL_EMERG). Then rings are written to FILENAME by
+ * async-signal-safe calls, one section per thread, and previous handler
+ * of signal is called. Rings are also written by ll_flush().
+ *
+ * Option level=DEBUG of URI records debug messages, which are filtered
+ * out by other loggers of namespace.
+ * Messages queued by asynchronous mode are lost on crash, so use it
+ * in synchronous mode.
+ */
+int ll_logger_ring(void);
+
+/** @} */
+
+#endif /* __LIBLOG_RING_LOGGER_H */
@@ -0,0 +1,53 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_SHM_LOGGER_H
+#define __LIBLOG_SHM_LOGGER_H
+
+/**
+ * @addtogroup liblog_loggers
+ *
+ * @{
+ */
+
+/**
+ * @brief Register shared memory logger in liblog
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Accepted URI for this logger type is:
+ * @li shm: - ring is named by name of program
+ * @li shm:NAME - ring is named by NAME
+ *
+ * Optional query parameters:
+ * @li size=SIZE - size of ring, 1M by default
+ *
+ * Messages are copied to ring /dev/shm/liblog.NAME.PID.N without system
+ * calls, and written by liblog-collect process, which takes rings of
+ * all processes. Producer never waits for collector, messages, which
+ * don't fit into full ring, are dropped and counted as dropped by
+ * statistics. Collector is woken up by futex only, when it's sleeping
+ * on empty ring. Ring is removed by collector, when producer closed it
+ * or died, and all messages are taken.
+ */
+int ll_logger_shm(void);
+
+/** @} */
+
+#endif /* __LIBLOG_SHM_LOGGER_H */
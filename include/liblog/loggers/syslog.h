@@ -0,0 +1,55 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_SYSLOG_LOGGER_H
+#define __LIBLOG_SYSLOG_LOGGER_H
+
+/**
+ * @addtogroup liblog_loggers
+ *
+ * @{
+ */
+
+/**
+ * @brief Register syslog logger in liblog
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Accepted URI for this logger type is:
+ * @li syslog: - local syslog socket /dev/log
+ * @li syslog:/SOCKET - absolute path of Unix datagram socket
+ *
+ * Optional query parameters:
+ * @li facility=NAME - syslog facility by name or number, "user" by default
+ * @li ident=NAME - application name, name of program by default
+ * @li queue=N - number of queued messages, 1024 by default
+ * @li size=SIZE - maximum size of message, longer ones are truncated,
+ * 2K by default
+ *
+ * Messages are sent in RFC 5424 format, namespace is used as MSGID.
+ * Header is rendered once per namespace, only priority and timestamp
+ * are rendered per message. Messages are queued without locks and
+ * sent by own thread in batches by sendmmsg(). Messages, which don't
+ * fit into full queue, are dropped and counted as dropped by statistics.
+ */
+int ll_logger_syslog(void);
+
+/** @} */
+
+#endif /* __LIBLOG_SYSLOG_LOGGER_H */
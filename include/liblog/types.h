@@ -22,10 +22,18 @@
 
 #include <liblog/defines.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /** forward declaration of libtools/url.h */
 struct url;
 
+/** opaque logging namespace */
+struct ll_namespace;
+
+/** opaque parsed format string */
+struct ll_fmt;
+
 /**
  * @defgroup liblog_types Types
  * @brief Defines types useful for interaction with liblog
@@ -66,6 +74,102 @@ enum ll_level {
 	LL_LEVEL_DEBUG = _LL_LEVEL_DEBUG,
 };
 
+/** Resolution of timestamps written by loggers */
+enum ll_ts {
+	/** seconds */
+	LL_TS_SEC,
+
+	/** milliseconds */
+	LL_TS_MSEC,
+
+	/** microseconds */
+	LL_TS_USEC,
+
+	/** nanoseconds */
+	LL_TS_NSEC,
+};
+
+/** Type of argument taken by conversion of format string */
+enum ll_arg {
+	/** @copydoc _LL_ARG_NONE */
+	LL_ARG_NONE = _LL_ARG_NONE,
+
+	/** @copydoc _LL_ARG_INT */
+	LL_ARG_INT = _LL_ARG_INT,
+
+	/** @copydoc _LL_ARG_LONG */
+	LL_ARG_LONG = _LL_ARG_LONG,
+
+	/** @copydoc _LL_ARG_LLONG */
+	LL_ARG_LLONG = _LL_ARG_LLONG,
+
+	/** @copydoc _LL_ARG_INTMAX */
+	LL_ARG_INTMAX = _LL_ARG_INTMAX,
+
+	/** @copydoc _LL_ARG_SIZE */
+	LL_ARG_SIZE = _LL_ARG_SIZE,
+
+	/** @copydoc _LL_ARG_PTRDIFF */
+	LL_ARG_PTRDIFF = _LL_ARG_PTRDIFF,
+
+	/** @copydoc _LL_ARG_DOUBLE */
+	LL_ARG_DOUBLE = _LL_ARG_DOUBLE,
+
+	/** @copydoc _LL_ARG_LDOUBLE */
+	LL_ARG_LDOUBLE = _LL_ARG_LDOUBLE,
+
+	/** @copydoc _LL_ARG_PTR */
+	LL_ARG_PTR = _LL_ARG_PTR,
+
+	/** @copydoc _LL_ARG_STR */
+	LL_ARG_STR = _LL_ARG_STR,
+};
+
+/** Behaviour of asynchronous mode, when ring buffer of thread is full */
+enum ll_async_policy {
+	/** drop new message */
+	LL_ASYNC_DROP,
+
+	/** wait, until writer thread makes a room for message */
+	LL_ASYNC_BLOCK,
+
+	/** drop oldest messages to make a room for new one */
+	LL_ASYNC_OVERWRITE,
+};
+
+/** Type of value of structured field */
+enum ll_field_type {
+	/** signed integer */
+	LL_FIELD_INT,
+
+	/** unsigned integer */
+	LL_FIELD_UINT,
+
+	/** floating point number */
+	LL_FIELD_DOUBLE,
+
+	/** boolean */
+	LL_FIELD_BOOL,
+
+	/** string with known length */
+	LL_FIELD_STR,
+};
+
+/** Encoding of structured fields, passed to logger */
+enum ll_kv_enc {
+	/** key=value pairs separated by space, values quoted if needed */
+	LL_KV_LOGFMT,
+
+	/** "key":value pairs separated by comma, without braces */
+	LL_KV_JSON,
+
+	/** binary, see kv.h */
+	LL_KV_BINARY,
+
+	/** fields of native journal protocol, keys are upper-cased */
+	LL_KV_JOURNAL,
+};
+
 /**
  * @brief
  * @param [in] name namespace
@@ -93,6 +197,29 @@ typedef int (*ll_pr_cb_t)(void *priv, const char *name,
 	enum ll_level level, const char *format, va_list args
 );
 
+/**
+ * @brief Routine callback to write buffered messages and reopen log
+ * @param [in] priv pointer to private data of logger (can be NULL)
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+typedef int (*ll_flush_cb_t)(void *priv);
+
+/**
+ * @brief Routine callback for structured message logging
+ * @param [in] priv pointer to private data of logger
+ * @param [in] name namespace of message
+ * @param [in] level logging level of message
+ * @param [in] msg message
+ * @param [in] fields fields of message, encoded as asked by logger
+ * @param [in] len size of encoded fields
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+typedef int (*ll_kv_cb_t)(void *priv, const char *name,
+	enum ll_level level, const char *msg, const char *fields, size_t len
+);
+
 /**
  * @brief Routine callback to deallocate memory used by logger
  * @param [in] priv pointer to private data of logger (can be NULL)
@@ -118,13 +245,384 @@ struct ll_logger {
 	 */
 	const ll_pr_cb_t pr_cb;
 
+	/**
+	 * @brief Pointer to logger flush function (can be NULL)
+	 * @copydetails ll_flush_cb_t
+	 */
+	const ll_flush_cb_t flush_cb;
+
 	/**
 	 * @brief Pointer to logger close function
 	 * @copydetails ll_close_cb_t
 	 */
 	const ll_close_cb_t close_cb;
+
+	/**
+	 * @brief Pointer to structured message print function (can be NULL)
+	 * @copydetails ll_kv_cb_t
+	 *
+	 * If it's NULL, fields are appended to message in logfmt encoding
+	 * and message is passed to @ref pr_cb.
+	 */
+	const ll_kv_cb_t kv_cb;
+
+	/** encoding of fields passed to @ref kv_cb */
+	const enum ll_kv_enc kv_enc;
+};
+
+/**
+ * @brief Log line rendered by ll_record_render()
+ *
+ * Line is kept in buffer of current thread, so it's valid only until
+ * next rendering by the same thread.
+ */
+struct ll_record {
+	/** time of message in nanoseconds */
+	uint64_t ts;
+
+	/** namespace of message */
+	const char *name;
+
+	/** logging level of message */
+	enum ll_level level;
+
+	/** rendered line "TIME;NAMESPACE;LEVEL;MESSAGE\n" */
+	const char *line;
+
+	/** length of line, including newline */
+	size_t len;
+};
+
+/** Counters of messages of one logging level, see ll_stats() */
+struct ll_stats_level {
+	/** messages passed run-time logging level */
+	uint64_t emitted;
+
+	/** messages rejected by run-time logging level of ll_printf() */
+	uint64_t filtered;
+
+	/** messages lost by full ring buffer or error of logger */
+	uint64_t dropped;
+
+	/** bytes of lines rendered by loggers */
+	uint64_t bytes;
+};
+
+/**
+ * @brief Statistics of namespace, see ll_stats()
+ *
+ * Latencies are time of logger calls in nanoseconds, percentiles are
+ * approximated by histogram with precision of 12.5%.
+ */
+struct ll_stats {
+	/** counters per logging level */
+	struct ll_stats_level level[LL_LEVEL_DEBUG + 1];
+
+	/** number of logger calls */
+	uint64_t calls;
+
+	/** total time of logger calls */
+	uint64_t time;
+
+	/** minimal latency */
+	uint64_t min;
+
+	/** median latency */
+	uint64_t p50;
+
+	/** 90th percentile of latency */
+	uint64_t p90;
+
+	/** 99th percentile of latency */
+	uint64_t p99;
+
+	/** 99.9th percentile of latency */
+	uint64_t p999;
+
+	/** maximal latency */
+	uint64_t max;
+};
+
+/**
+ * @brief Rate limit of messages
+ *
+ * Generic cell rate algorithm (token bucket without tokens): state is
+ * one timestamp, updated by compare-and-swap, so limit doesn't lock.
+ */
+struct ll_rate {
+	/** messages per second, zero if unlimited */
+	uint32_t rate;
+
+	/** number of messages allowed at once */
+	uint32_t burst;
+
+	/** theoretical arrival time of next message, in nanoseconds */
+	uint64_t tat;
+
+	/** number of messages suppressed since last summary */
+	uint64_t suppressed;
+
+	/** time of last summary of suppressed messages */
+	uint64_t reported;
+};
+
+/**
+ * @brief Types of arguments of call site
+ *
+ * Emitted by logging macros, if `LIBLOG_TYPED` is defined.
+ */
+struct ll_args {
+	/** number of arguments, including format string */
+	size_t n;
+
+	/** types of arguments, see enum ll_arg */
+	const unsigned char *type;
+};
+
+/**
+ * @brief Logging call site
+ *
+ * Every logging macro keeps own static instance of this structure,
+ * so namespace is resolved only once per call site.
+ */
+struct ll_site {
+	/** logging level of namespace, NULL until first message */
+	const enum ll_level *level;
+
+	/** resolved namespace */
+	struct ll_namespace *ns;
+
+	/** parsed format string, used by deferred formatting */
+	struct ll_fmt *fmt;
+
+	/** next bound call site */
+	struct ll_site *next;
+
+	/** types of arguments, NULL if unknown */
+	const struct ll_args *args;
+};
+
+/**
+ * @brief Key/value field of structured message
+ *
+ * Made by LL_F_* macros, key is string literal and its length is known
+ * at compile time.
+ */
+struct ll_field {
+	/** key, isn't null-terminated for decoded fields */
+	const char *key;
+
+	/** length of key */
+	size_t key_len;
+
+	/** type of value */
+	enum ll_field_type type;
+
+	/** value */
+	union {
+		/** @ref LL_FIELD_INT */
+		int64_t i;
+
+		/** @ref LL_FIELD_UINT */
+		uint64_t u;
+
+		/** @ref LL_FIELD_DOUBLE */
+		double d;
+
+		/** @ref LL_FIELD_BOOL */
+		int b;
+
+		/** @ref LL_FIELD_STR, isn't null-terminated for decoded fields */
+		const char *s;
+	} v;
+
+	/** length of string */
+	size_t len;
 };
 
 /** @} */
+#if defined(LIBLOG_TYPED) && defined(__cplusplus)
+#	include <type_traits>
+
+namespace ll_typed {
+
+/** Type of argument, see enum ll_arg */
+template <typename T>
+struct arg {
+	static constexpr unsigned char value =
+		std::is_pointer<T>::value ? _LL_ARG_PTR :
+		std::is_enum<T>::value ? _LL_ARG_INT : _LL_ARG_NONE;
+};
+
+#	define _LL_ARG_OF(TYPE, ARG)                                    \
+	template <> struct arg<TYPE> {                                    \
+		static constexpr unsigned char value = ARG;               \
+	}
+
+_LL_ARG_OF(bool, _LL_ARG_INT);
+_LL_ARG_OF(char, _LL_ARG_INT);
+_LL_ARG_OF(signed char, _LL_ARG_INT);
+_LL_ARG_OF(unsigned char, _LL_ARG_INT);
+_LL_ARG_OF(short, _LL_ARG_INT);
+_LL_ARG_OF(unsigned short, _LL_ARG_INT);
+_LL_ARG_OF(int, _LL_ARG_INT);
+_LL_ARG_OF(unsigned, _LL_ARG_INT);
+_LL_ARG_OF(long, _LL_ARG_LONG);
+_LL_ARG_OF(unsigned long, _LL_ARG_LONG);
+_LL_ARG_OF(long long, _LL_ARG_LLONG);
+_LL_ARG_OF(unsigned long long, _LL_ARG_LLONG);
+_LL_ARG_OF(float, _LL_ARG_DOUBLE);
+_LL_ARG_OF(double, _LL_ARG_DOUBLE);
+_LL_ARG_OF(long double, _LL_ARG_LDOUBLE);
+_LL_ARG_OF(char *, _LL_ARG_STR);
+_LL_ARG_OF(const char *, _LL_ARG_STR);
+_LL_ARG_OF(decltype(nullptr), _LL_ARG_PTR);
+
+#	undef _LL_ARG_OF
+
+/** Descriptor of arguments */
+template <typename... T>
+struct args {
+	static_assert(sizeof...(T) <= _LL_ARGS_MAX, "too many arguments");
+
+	static constexpr unsigned char type[] = { arg<T>::value... };
+	static constexpr struct ll_args desc = { sizeof...(T), type };
+};
+
+template <typename... T>
+constexpr unsigned char args<T...>::type[];
+
+template <typename... T>
+constexpr struct ll_args args<T...>::desc;
+
+/** Deduce descriptor of arguments, never called */
+template <typename... T>
+args<typename std::decay<T>::type...> of(T &&...);
+
+#	if __cplusplus >= 201402L
+/** Size of integer argument, zero for other types */
+constexpr size_t size(unsigned char type)
+{
+	switch (type) {
+		case _LL_ARG_INT: return (sizeof(int));
+		case _LL_ARG_LONG: return (sizeof(long));
+		case _LL_ARG_LLONG: return (sizeof(long long));
+		case _LL_ARG_INTMAX: return (sizeof(intmax_t));
+		case _LL_ARG_SIZE: return (sizeof(size_t));
+		case _LL_ARG_PTRDIFF: return (sizeof(ptrdiff_t));
+		default: return (0);
+	}
+}
+
+/** Check, if argument of type can be taken by conversion */
+constexpr bool match(unsigned char want, unsigned char type)
+{
+	return (want == type || (size(want) && size(want) == size(type)) ||
+		(want == _LL_ARG_PTR && type == _LL_ARG_STR));
+}
+
+/** Check format string against types of arguments */
+constexpr bool check(const char *p, const unsigned char *type, size_t n)
+{
+	size_t i = 1;
+
+	while (*p) {
+		if (*p ++ != '%') {
+			continue;
+		}
+
+		if (*p == '%') {
+			++ p;
+			continue;
+		}
+
+		while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' ||
+			*p == '0' || *p == '\'') {
+			++ p;
+		}
+
+		if (*p == '*') {
+			if (i >= n || !match(_LL_ARG_INT, type[i ++])) {
+				return (false);
+			}
+
+			++ p;
+		}
+
+		while (*p >= '0' && *p <= '9') {
+			++ p;
+		}
+
+		if (*p == '.') {
+			if (*++ p == '*') {
+				if (i >= n || !match(_LL_ARG_INT, type[i ++])) {
+					return (false);
+				}
+
+				++ p;
+			}
+
+			while (*p >= '0' && *p <= '9') {
+				++ p;
+			}
+		}
+
+		unsigned char want = _LL_ARG_INT;
+
+		if (*p == 'h') {
+			p += p[1] == 'h' ? 2 : 1;
+		} else if (*p == 'l' && p[1] == 'l') {
+			want = _LL_ARG_LLONG;
+			p += 2;
+		} else if (*p == 'l') {
+			want = _LL_ARG_LONG;
+			++ p;
+		} else if (*p == 'j' || *p == 'z' || *p == 't' || *p == 'L') {
+			want = *p == 'j' ? _LL_ARG_INTMAX : *p == 'z' ? _LL_ARG_SIZE :
+				*p == 't' ? _LL_ARG_PTRDIFF : _LL_ARG_LDOUBLE;
+			++ p;
+		}
+
+		switch (*p ++) {
+			case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+				break;
+
+			case 'c':
+				want = _LL_ARG_INT;
+				break;
+
+			case 'f': case 'F': case 'e': case 'E':
+			case 'g': case 'G': case 'a': case 'A':
+				want = want == _LL_ARG_LDOUBLE ? _LL_ARG_LDOUBLE : _LL_ARG_DOUBLE;
+				break;
+
+			case 's':
+				want = want == _LL_ARG_LONG ? _LL_ARG_PTR : _LL_ARG_STR;
+				break;
+
+			case 'p':
+			case 'n':
+				want = _LL_ARG_PTR;
+				break;
+
+			case 'm':
+				continue;
+
+			default:
+				return (false);
+		}
+
+		if (i >= n || !match(want, type[i ++])) {
+			return (false);
+		}
+	}
+
+	return (i == n);
+}
+
+#	endif /* __cplusplus >= 201402L */
+
+} /* namespace ll_typed */
+#endif /* LIBLOG_TYPED && __cplusplus */
 
 #endif /* __LIBLOG_TYPES_H */
@@ -0,0 +1,759 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "liblog/log.h"
+#include "async.h"
+#include "clock.h"
+#include "format.h"
+#include "kv.h"
+
+/*------------------------------------------------------------------------*/
+
+/** minimal size of ring buffer */
+#define LL_ASYNC_RING_MIN 4096
+
+/** how long writer thread sleeps, if there is nothing to write (ms) */
+#define LL_ASYNC_IDLE_MS 100
+
+/** how long blocked thread waits for free space (ns) */
+#define LL_ASYNC_PAUSE_NS 50000
+
+/** Header of message in ring buffer */
+struct ll_async_rec {
+	/** size of record including header */
+	uint32_t size;
+
+	/** logging level of message */
+	int8_t level;
+
+	/** logging level of namespace, when message was logged */
+	int8_t base;
+
+	/** non-zero, if message is followed by binary fields, see kv.h */
+	uint8_t kv;
+
+	/** number of padding bytes at the end of record */
+	uint8_t pad;
+
+	/** namespace of message, NULL for padding */
+	struct ll_namespace *ns;
+
+	/** parsed format string, if message contains packed arguments */
+	const struct ll_fmt *fmt;
+
+	/** time of message in nanoseconds */
+	uint64_t ts;
+
+	/** null-terminated message (and fields) or packed arguments */
+	char msg[];
+};
+
+/** Ring buffer of one thread */
+struct ll_ring {
+	/** write position, updated by owner thread only */
+	size_t head __attribute__((aligned(LL_CACHELINE)));
+
+	/** read position, updated by writer thread (and owner on overwrite) */
+	size_t tail __attribute__((aligned(LL_CACHELINE)));
+
+	/** number of dropped messages */
+	uint64_t dropped __attribute__((aligned(LL_CACHELINE)));
+
+	/** non-zero, if owner thread has exited */
+	int orphan;
+
+	/** next ring buffer */
+	struct ll_ring *next;
+
+	/** buffer for formatting of messages */
+	char *scratch;
+
+	/** size of data minus one */
+	size_t mask;
+
+	/** ring data */
+	unsigned char data[];
+};
+
+/*------------------------------------------------------------------------*/
+
+/** state of asynchronous mode */
+static struct {
+	/** protect list of rings and wake up of writer */
+	pthread_mutex_t lock;
+
+	/** signal writer thread about new messages */
+	pthread_cond_t wake;
+
+	/** writer thread */
+	pthread_t thread;
+
+	/** thread specific ring buffer */
+	pthread_key_t key;
+
+	/** list of ring buffers */
+	struct ll_ring *rings;
+
+	/** size of ring buffer */
+	size_t size;
+
+	/** @copydoc ll_async_policy */
+	enum ll_async_policy policy;
+
+	/** non-zero, if writer thread is waiting for messages */
+	int sleeping;
+
+	/** non-zero, if writer thread should finish */
+	int stop;
+
+	/** number of messages dropped by freed ring buffers */
+	uint64_t dropped;
+} async = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+};
+
+int ll_async_running;
+int ll_async_defer;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Wake up writer thread
+ * @param [in] force wake it up, even if it's busy
+ */
+static void ll_async_wake(int force)
+{
+	/* pairs with writer thread, which check rings after sleeping is set */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (force || __atomic_load_n(&async.sleeping, __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&async.lock);
+		pthread_cond_signal(&async.wake);
+		pthread_mutex_unlock(&async.lock);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Mark ring buffer of exited thread
+ * @param [in] priv pointer to ring buffer
+ */
+static void ll_ring_orphan(void *priv)
+{
+	struct ll_ring *r = priv;
+
+	__atomic_store_n(&r->orphan, 1, __ATOMIC_RELEASE);
+	ll_async_wake(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Allocate ring buffer for calling thread
+ * @return pointer to ring buffer
+ * @retval NULL error occurred
+ */
+static struct ll_ring *ll_ring_new(void)
+{
+	struct ll_ring *r;
+
+	if (posix_memalign((void **)&r, LL_CACHELINE, sizeof(*r) + async.size)) {
+		return (NULL);
+	}
+
+	memset(r, 0, sizeof(*r));
+	r->mask = async.size - 1;
+
+	if (!(r->scratch = malloc(async.size / 4))) {
+		free(r);
+
+		return (NULL);
+	}
+
+	if (pthread_setspecific(async.key, r)) {
+		free(r->scratch);
+		free(r);
+
+		return (NULL);
+	}
+
+	pthread_mutex_lock(&async.lock);
+	r->next = async.rings;
+	__atomic_store_n(&async.rings, r, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&async.lock);
+
+	return (r);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return position of record, which follows specified one
+ * @param [in] r pointer to ring buffer
+ * @param [in] pos position of record
+ * @return position of next record
+ */
+static size_t ll_ring_next(const struct ll_ring *r, size_t pos)
+{
+	size_t left = r->mask + 1 - (pos & r->mask);
+
+	/* too small tail of buffer is skipped without padding record */
+	if (left < sizeof(struct ll_async_rec)) {
+		return (pos + left);
+	}
+
+	const struct ll_async_rec *rec = (const void *)(r->data + (pos & r->mask));
+
+	return (pos + rec->size);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Put record, prepared in scratch buffer, to ring buffer
+ * @param [in] r pointer to ring buffer of calling thread
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace
+ * @param [in] fmt parsed format string of packed arguments (can be NULL)
+ * @param [in] kv non-zero, if message is followed by binary fields
+ * @param [in] len size of record data in scratch buffer
+ * @return on success, zero is returned
+ * @retval -1 error occurred (message was dropped)
+ */
+static int ll_ring_put(struct ll_ring *r, struct ll_namespace *ns,
+	enum ll_level level, enum ll_level base, const struct ll_fmt *fmt,
+	int kv, size_t len) {
+	size_t need = (sizeof(struct ll_async_rec) + len +
+		sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	size_t head = r->head;
+	size_t skip;
+
+	for (;;) {
+		size_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+		size_t left = r->mask + 1 - (head & r->mask);
+
+		/* record can't be wrapped, so skip end of buffer */
+		skip = left < need ? left : 0;
+
+		if (head + skip + need - tail <= r->mask + 1) {
+			break;
+		}
+
+		switch (async.policy) {
+			case LL_ASYNC_DROP:
+				__atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+
+				return (-1);
+
+			case LL_ASYNC_BLOCK:
+				ll_async_wake(1);
+				nanosleep(&(struct timespec){0, LL_ASYNC_PAUSE_NS}, NULL);
+
+				break;
+
+			case LL_ASYNC_OVERWRITE: {
+				size_t next = ll_ring_next(r, tail);
+				int real = next - tail >= sizeof(struct ll_async_rec) &&
+					((struct ll_async_rec *)(r->data + (tail & r->mask)))->ns;
+
+				/* writer thread can take this record meanwhile */
+				if (__atomic_compare_exchange_n(&r->tail, &tail, next, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) && real) {
+					__atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+				}
+
+				break;
+			}
+		}
+	}
+
+	if (skip >= sizeof(struct ll_async_rec)) {
+		struct ll_async_rec *pad = (void *)(r->data + (head & r->mask));
+
+		pad->size = skip;
+		pad->ns = NULL;
+	}
+
+	head += skip;
+
+	struct ll_async_rec *rec = (void *)(r->data + (head & r->mask));
+
+	rec->size = need;
+	rec->level = level;
+	rec->base = base;
+	rec->kv = kv;
+	rec->pad = need - sizeof(*rec) - len;
+	rec->ns = ns;
+	rec->fmt = fmt;
+	rec->ts = ll_clock_now(LL_TS_NSEC);
+	memcpy(rec->msg, r->scratch, len);
+
+	__atomic_store_n(&r->head, head + need, __ATOMIC_RELEASE);
+	ll_async_wake(0);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_async_pr(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const struct ll_fmt *fmt, const char *format,
+	va_list args) {
+	assert(ns);
+	assert(format);
+
+	struct ll_ring *r = pthread_getspecific(async.key);
+
+	if (!r && !(r = ll_ring_new())) {
+		return (-1);
+	}
+
+	/* one message can't take more than quarter of ring buffer */
+	size_t max = (r->mask + 1) / 4 - sizeof(struct ll_async_rec);
+	int len = -1;
+
+	if (fmt && !fmt->eager) {
+		va_list ap;
+
+		/* copy arguments only, writer thread will format message */
+		va_copy(ap, args);
+		len = ll_fmt_pack(fmt, r->scratch, max, ap);
+		va_end(ap);
+	}
+
+	if (len < 0) {
+		/* can't be deferred, so format it right now */
+		fmt = NULL;
+
+		if ((len = vsnprintf(r->scratch, max, format, args)) < 0) {
+			return (-1);
+		}
+
+		if ((size_t)len >= max) {
+			len = max - 1;
+		}
+
+		r->scratch[len ++] = 0;
+	}
+
+	return (ll_ring_put(r, ns, level, base, fmt, 0, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_async_kv(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *msg, const struct ll_kv *kv) {
+	assert(ns);
+	assert(msg);
+	assert(kv);
+
+	struct ll_ring *r = pthread_getspecific(async.key);
+
+	if (!r && !(r = ll_ring_new())) {
+		return (-1);
+	}
+
+	/* one message can't take more than quarter of ring buffer */
+	size_t max = (r->mask + 1) / 4 - sizeof(struct ll_async_rec);
+	size_t len = strnlen(msg, max - 1);
+
+	/* fields are copied in binary encoding, so strings aren't borrowed */
+	memcpy(r->scratch, msg, len);
+	r->scratch[len ++] = 0;
+	len += ll_kv_pack(kv, (unsigned char *)r->scratch + len, max - len);
+
+	return (ll_ring_put(r, ns, level, base, NULL, 1, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass message to logger of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] format format of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_async_write(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *format, ...) {
+	va_list ap;
+
+	va_start(ap, format);
+	int rc = ll_ns_pr(ns, level, base, format, ap);
+	va_end(ap);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** Buffers of writer thread */
+struct ll_async_buf {
+	/** copy of record */
+	char *rec;
+
+	/** message formatted from packed arguments */
+	struct ll_buf msg;
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write all messages of ring buffer
+ * @param [in] r pointer to ring buffer
+ * @param [in] buf buffers of writer thread
+ * @return number of written messages
+ */
+static int ll_ring_drain(struct ll_ring *r, struct ll_async_buf *buf)
+{
+	size_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	int n = 0;
+
+	while (tail != __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) {
+		size_t left = r->mask + 1 - (tail & r->mask);
+		struct ll_namespace *ns = NULL;
+		const struct ll_fmt *fmt = NULL;
+		enum ll_level level = LL_LEVEL_INVALID;
+		enum ll_level base = LL_LEVEL_INVALID;
+		size_t next = tail + left;
+		size_t len = 0;
+		uint64_t ts = 0;
+		int kv = 0;
+
+		if (left >= sizeof(struct ll_async_rec)) {
+			const struct ll_async_rec *rec = (const void *)(r->data +
+				(tail & r->mask));
+			size_t size = __atomic_load_n(&rec->size, __ATOMIC_RELAXED);
+			size_t pad = __atomic_load_n(&rec->pad, __ATOMIC_RELAXED);
+
+			/*
+			 * overwritten by owner thread? Header can be torn, so bound
+			 * message by scratch buffer before it's copied
+			 */
+			if (size < sizeof(*rec) || size > left ||
+				pad > size - sizeof(*rec) ||
+				size - sizeof(*rec) - pad > async.size / 4) {
+				tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+				continue;
+			}
+
+			/* copy, because record can be overwritten after release */
+			ns = rec->ns;
+			fmt = rec->fmt;
+			ts = rec->ts;
+			level = rec->level;
+			base = rec->base;
+			kv = rec->kv;
+			len = size - sizeof(*rec) - pad;
+			memcpy(buf->rec, rec->msg, len);
+			next = tail + size;
+		}
+
+		if (!__atomic_compare_exchange_n(&r->tail, &tail, next, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			continue;
+		}
+
+		tail = next;
+
+		if (!ns) {
+			continue;
+		}
+
+		if (fmt) {
+			buf->msg.len = 0;
+
+			if (ll_fmt_render(fmt, buf->rec, len, &buf->msg)) {
+				continue;
+			}
+		}
+
+		/* loggers should write time, when message was logged */
+		ll_clock_pin(ts);
+
+		if (kv) {
+			size_t msg = strlen(buf->rec) + 1;
+			const struct ll_kv fields = { NULL, 0,
+				(unsigned char *)buf->rec + msg, len - msg };
+
+			ll_ns_kv(ns, level, base, buf->rec, &fields);
+		} else {
+			ll_async_write(ns, level, base, "%s",
+				fmt ? buf->msg.data : buf->rec);
+		}
+
+		ll_clock_pin(0);
+		++ n;
+	}
+
+	return (n);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, if there are not written messages
+ * @return non-zero, if some ring buffer is not empty
+ *
+ * Must be called with async.lock held, rings of exited threads are
+ * freed by writer thread under lock.
+ */
+static int ll_async_pending_locked(void)
+{
+	for (struct ll_ring *r = async.rings; r; r = r->next) {
+		if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) !=
+			__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) {
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, if there are not written messages
+ * @return non-zero, if some ring buffer is not empty
+ */
+static int ll_async_pending(void)
+{
+	pthread_mutex_lock(&async.lock);
+
+	int rc = ll_async_pending_locked();
+
+	pthread_mutex_unlock(&async.lock);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free ring buffer
+ * @param [in] r pointer to ring buffer
+ *
+ * Must be called with async.lock held.
+ */
+static void ll_ring_free(struct ll_ring *r)
+{
+	async.dropped += r->dropped;
+
+	free(r->scratch);
+	free(r);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** Free empty ring buffers of exited threads */
+static void ll_async_reap(void)
+{
+	pthread_mutex_lock(&async.lock);
+
+	for (struct ll_ring **p = &async.rings; *p;) {
+		struct ll_ring *r = *p;
+
+		if (__atomic_load_n(&r->orphan, __ATOMIC_ACQUIRE) &&
+			r->head == r->tail) {
+			*p = r->next;
+			ll_ring_free(r);
+		} else {
+			p = &r->next;
+		}
+	}
+
+	pthread_mutex_unlock(&async.lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Writer thread, drain all ring buffers to loggers
+ * @param [in] arg buffers of writer thread
+ * @return buffers of writer thread
+ */
+static void *ll_async_thread(void *arg)
+{
+	for (;;) {
+		int n = 0;
+
+		struct ll_ring *r = __atomic_load_n(&async.rings, __ATOMIC_ACQUIRE);
+
+		for (; r; r = r->next) {
+			n += ll_ring_drain(r, arg);
+		}
+
+		ll_async_reap();
+
+		if (n) {
+			continue;
+		}
+
+		/* finish only when all messages are written */
+		if (__atomic_load_n(&async.stop, __ATOMIC_ACQUIRE)) {
+			if (!ll_async_pending()) {
+				break;
+			}
+
+			continue;
+		}
+
+		pthread_mutex_lock(&async.lock);
+		__atomic_store_n(&async.sleeping, 1, __ATOMIC_SEQ_CST);
+
+		if (!ll_async_pending_locked() && !async.stop) {
+			struct timespec ts;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += LL_ASYNC_IDLE_MS * 1000000L;
+			ts.tv_sec += ts.tv_nsec / 1000000000L;
+			ts.tv_nsec %= 1000000000L;
+
+			pthread_cond_timedwait(&async.wake, &async.lock, &ts);
+		}
+
+		__atomic_store_n(&async.sleeping, 0, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&async.lock);
+	}
+
+	return (arg);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_async_sync(void)
+{
+	while (ll_async_pending()) {
+		ll_async_wake(1);
+		nanosleep(&(struct timespec){0, LL_ASYNC_PAUSE_NS}, NULL);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_async_start(size_t size, enum ll_async_policy policy)
+{
+	if (ll_async_running) {
+		return (-1);
+	}
+
+	/* ring buffer size should be power of two */
+	for (async.size = LL_ASYNC_RING_MIN; async.size < size;) {
+		async.size <<= 1;
+	}
+
+	async.policy = policy;
+	async.stop = 0;
+
+	if (pthread_key_create(&async.key, ll_ring_orphan)) {
+		return (-1);
+	}
+
+	struct ll_async_buf *buf = calloc(1, sizeof(*buf));
+
+	if (!buf || !(buf->rec = malloc(async.size / 4)) ||
+		pthread_create(&async.thread, NULL, ll_async_thread, buf)) {
+		pthread_key_delete(async.key);
+
+		if (buf) {
+			free(buf->rec);
+			free(buf);
+		}
+
+		return (-1);
+	}
+
+	__atomic_store_n(&ll_async_running, 1, __ATOMIC_RELEASE);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_async_stop(void)
+{
+	if (!ll_async_running) {
+		return;
+	}
+
+	/* new messages will be written synchronously */
+	__atomic_store_n(&ll_async_running, 0, __ATOMIC_RELEASE);
+
+	/* writer thread will finish, when all messages are written */
+	__atomic_store_n(&async.stop, 1, __ATOMIC_RELEASE);
+	ll_async_wake(1);
+
+	struct ll_async_buf *buf;
+
+	pthread_join(async.thread, (void **)&buf);
+	ll_buf_free(&buf->msg);
+	free(buf->rec);
+	free(buf);
+
+	/* rings of alive threads are not needed anymore */
+	pthread_key_delete(async.key);
+
+	pthread_mutex_lock(&async.lock);
+
+	while (async.rings) {
+		struct ll_ring *r = async.rings;
+
+		async.rings = r->next;
+		ll_ring_free(r);
+	}
+
+	pthread_mutex_unlock(&async.lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_async_deferred(int enable)
+{
+	return (__atomic_exchange_n(&ll_async_defer, !!enable, __ATOMIC_RELAXED));
+}
+
+/*------------------------------------------------------------------------*/
+
+uint64_t ll_async_dropped(void)
+{
+	pthread_mutex_lock(&async.lock);
+
+	uint64_t n = async.dropped;
+
+	for (struct ll_ring *r = async.rings; r; r = r->next) {
+		n += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_unlock(&async.lock);
+
+	return (n);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_ASYNC_H
+#define __LIBLOG_ASYNC_H
+
+#include "namespace.h"
+
+/** non-zero, if asynchronous mode is running */
+extern int ll_async_running;
+
+/** non-zero, if deferred formatting is enabled */
+extern int ll_async_defer;
+
+/**
+ * @brief Put message to ring buffer of calling thread
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace
+ * @param [in] fmt parsed format string to defer formatting (can be NULL)
+ * @param [in] format format of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred (message was dropped)
+ */
+int ll_async_pr(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const struct ll_fmt *fmt, const char *format,
+	va_list args
+);
+
+/**
+ * @brief Put structured message to ring buffer of calling thread
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace
+ * @param [in] msg message
+ * @param [in] kv fields of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred (message was dropped)
+ *
+ * Fields, which don't fit into ring buffer, are dropped.
+ */
+int ll_async_kv(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *msg, const struct ll_kv *kv
+);
+
+/** Wait until writer thread drain all ring buffers */
+void ll_async_sync(void);
+
+#endif /* __LIBLOG_ASYNC_H */
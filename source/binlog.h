@@ -0,0 +1,64 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_BINLOG_H
+#define __LIBLOG_BINLOG_H
+
+/**
+ * @brief Binary log file format
+ *
+ * File starts with @ref LL_BINLOG_MAGIC followed by variable length
+ * base timestamp in nanoseconds. Then records follow, every record is
+ * prefixed by variable length size of record and starts by its type:
+ *
+ * @li @ref LL_BINLOG_NS: id, length and name of namespace
+ * @li @ref LL_BINLOG_FMT: id, length and format string
+ * @li @ref LL_BINLOG_MSG: timestamp delta (zigzag), namespace id, level,
+ * format string id and packed arguments of message
+ * @li @ref LL_BINLOG_TEXT: timestamp delta (zigzag), namespace id, level,
+ * length and already formatted message
+ * @li @ref LL_BINLOG_KV: timestamp delta (zigzag), namespace id, level,
+ * length and message, followed by binary fields (see kv.h)
+ *
+ * Namespaces and format strings are written once per file,
+ * before first message which refers them.
+ */
+
+/** file signature, includes version of format */
+#define LL_BINLOG_MAGIC "LLBIN\001"
+
+/** size of file signature */
+#define LL_BINLOG_MAGIC_LEN 6
+
+/** namespace dictionary record */
+#define LL_BINLOG_NS 1
+
+/** format string dictionary record */
+#define LL_BINLOG_FMT 2
+
+/** message with packed arguments */
+#define LL_BINLOG_MSG 3
+
+/** formatted message */
+#define LL_BINLOG_TEXT 4
+
+/** structured message */
+#define LL_BINLOG_KV 5
+
+#endif /* __LIBLOG_BINLOG_H */
@@ -0,0 +1,142 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buf.h"
+
+/*------------------------------------------------------------------------*/
+
+/** minimal allocation of buffer */
+#define LL_BUF_MIN 256
+
+/*------------------------------------------------------------------------*/
+
+int ll_buf_reserve(struct ll_buf *b, size_t n)
+{
+	assert(b);
+
+	if (b->len + n <= b->size) {
+		return (0);
+	}
+
+	size_t size = b->size ? b->size : LL_BUF_MIN;
+
+	while (size < b->len + n) {
+		size *= 2;
+	}
+
+	char *data = realloc(b->data, size);
+
+	if (!data) {
+		return (-1);
+	}
+
+	b->data = data;
+	b->size = size;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_buf_append(struct ll_buf *b, const void *data, size_t n)
+{
+	assert(b);
+	assert(data || !n);
+
+	/* data of empty buffer can be NULL */
+	if (!n) {
+		return (0);
+	}
+
+	if (ll_buf_reserve(b, n)) {
+		return (-1);
+	}
+
+	memcpy(b->data + b->len, data, n);
+	b->len += n;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_buf_vprintf(struct ll_buf *b, const char *format, va_list args)
+{
+	assert(b);
+	assert(format);
+
+	va_list ap;
+
+	va_copy(ap, args);
+	int len = vsnprintf(b->data + b->len, b->size - b->len, format, ap);
+	va_end(ap);
+
+	if (len < 0) {
+		return (-1);
+	}
+
+	/* not enough space, so format it again */
+	if ((size_t)len >= b->size - b->len) {
+		if (ll_buf_reserve(b, len + 1)) {
+			return (-1);
+		}
+
+		va_copy(ap, args);
+		len = vsnprintf(b->data + b->len, b->size - b->len, format, ap);
+		va_end(ap);
+
+		if (len < 0) {
+			return (-1);
+		}
+	}
+
+	b->len += len;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_buf_printf(struct ll_buf *b, const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	int rc = ll_buf_vprintf(b, format, ap);
+	va_end(ap);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_buf_free(struct ll_buf *b)
+{
+	assert(b);
+
+	free(b->data);
+
+	b->data = NULL;
+	b->len = b->size = 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_BUF_H
+#define __LIBLOG_BUF_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/** Growable buffer */
+struct ll_buf {
+	/** data of buffer */
+	char *data;
+
+	/** length of data */
+	size_t len;
+
+	/** allocated size */
+	size_t size;
+};
+
+/** Static initializer of buffer */
+#define ll_buf_initializer { NULL, 0, 0 }
+
+/**
+ * @brief Make sure, buffer have a room for more data
+ * @param [in] b pointer to buffer
+ * @param [in] n number of bytes to append
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_buf_reserve(struct ll_buf *b, size_t n);
+
+/**
+ * @brief Append data to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] data pointer to data
+ * @param [in] n size of data
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_buf_append(struct ll_buf *b, const void *data, size_t n);
+
+/**
+ * @brief Append formatted string to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] format format of string
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Data of buffer is null-terminated after call.
+ */
+int ll_buf_vprintf(struct ll_buf *b, const char *format, va_list args);
+
+/**
+ * @brief Append formatted string to buffer
+ * @copydetails ll_buf_vprintf
+ */
+int ll_buf_printf(struct ll_buf *b, const char *format, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Free memory used by buffer
+ * @param [in] b pointer to buffer
+ */
+void ll_buf_free(struct ll_buf *b);
+
+#endif /* __LIBLOG_BUF_H */
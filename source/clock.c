@@ -0,0 +1,130 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "clock.h"
+
+/*------------------------------------------------------------------------*/
+
+/** Rendered seconds of timestamp, cached by every thread */
+struct ll_clock_cache {
+	/** cached seconds */
+	uint64_t sec;
+
+	/** length of text */
+	size_t len;
+
+	/** rendered seconds */
+	char text[LL_CLOCK_STR_MAX];
+};
+
+/*------------------------------------------------------------------------*/
+
+/** pinned time of messages */
+static __thread uint64_t ll_clock_pinned;
+
+/** rendered seconds */
+static __thread struct ll_clock_cache ll_clock_cache;
+
+/*------------------------------------------------------------------------*/
+
+uint64_t ll_clock_now(enum ll_ts res)
+{
+	struct timespec ts;
+
+	if (ll_clock_pinned) {
+		return (ll_clock_pinned);
+	}
+
+	clock_gettime(res == LL_TS_SEC ? CLOCK_REALTIME_COARSE : CLOCK_REALTIME,
+		&ts);
+
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_clock_pin(uint64_t ts)
+{
+	ll_clock_pinned = ts;
+}
+
+/*------------------------------------------------------------------------*/
+
+size_t ll_clock_str(char *buf, uint64_t ts, enum ll_ts res)
+{
+	static const unsigned digits[] = { 0, 3, 6, 9 };
+	static const uint32_t div[] = { 1000000000, 1000000, 1000, 1 };
+
+	assert(buf);
+	assert((unsigned)res <= LL_TS_NSEC);
+
+	struct ll_clock_cache *c = &ll_clock_cache;
+	uint64_t sec = ts / 1000000000;
+
+	if (!c->len || c->sec != sec) {
+		c->len = snprintf(c->text, sizeof(c->text), "%" PRIu64, sec);
+		c->sec = sec;
+	}
+
+	memcpy(buf, c->text, c->len);
+
+	size_t n = c->len;
+
+	if (res != LL_TS_SEC) {
+		uint32_t frac = (ts % 1000000000) / div[res];
+
+		buf[n] = '.';
+		n += digits[res] + 1;
+
+		for (size_t i = n - 1; i > c->len; -- i) {
+			buf[i] = '0' + frac % 10;
+			frac /= 10;
+		}
+	}
+
+	buf[n] = 0;
+
+	return (n);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_clock_res(const char *s, enum ll_ts *res)
+{
+	static const char * const names[] = { "s", "ms", "us", "ns" };
+
+	assert(s);
+	assert(res);
+
+	for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); ++ i) {
+		if (!strcmp(s, names[i])) {
+			*res = i;
+
+			return (0);
+		}
+	}
+
+	return (-1);
+}
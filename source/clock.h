@@ -0,0 +1,69 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_CLOCK_H
+#define __LIBLOG_CLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <liblog/types.h>
+
+/** size of buffer for rendered timestamp */
+#define LL_CLOCK_STR_MAX 32
+
+/**
+ * @brief Return current time
+ * @param [in] res required resolution
+ * @return number of nanoseconds since Epoch
+ *
+ * For resolution in seconds, cheap coarse clock is used. If time of
+ * messages was pinned by ll_clock_pin(), pinned time is returned.
+ */
+uint64_t ll_clock_now(enum ll_ts res);
+
+/**
+ * @brief Pin time of messages written by calling thread
+ * @param [in] ts number of nanoseconds since Epoch, zero to unpin
+ *
+ * Used to write messages with time, when they were logged.
+ */
+void ll_clock_pin(uint64_t ts);
+
+/**
+ * @brief Render timestamp as text
+ * @param [out] buf buffer, at least @ref LL_CLOCK_STR_MAX bytes
+ * @param [in] ts number of nanoseconds since Epoch
+ * @param [in] res resolution of text
+ * @return length of text
+ *
+ * Seconds are rendered once per second and cached by calling thread,
+ * fraction of second is appended by digits.
+ */
+size_t ll_clock_str(char *buf, uint64_t ts, enum ll_ts res);
+
+/**
+ * @brief Parse name of resolution
+ * @param [in] s name of resolution: "s", "ms", "us" or "ns"
+ * @param [out] res resolution
+ * @return on success, zero is returned
+ * @retval -1 unknown name
+ */
+int ll_clock_res(const char *s, enum ll_ts *res);
+
+#endif /* __LIBLOG_CLOCK_H */
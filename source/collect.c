@@ -0,0 +1,380 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libtools/list.h>
+#include <libtools/tools.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/binlog.h"
+#include "liblog/loggers/color.h"
+#include "liblog/loggers/file.h"
+#include "liblog/loggers/journal.h"
+#include "liblog/loggers/json.h"
+#include "liblog/loggers/mmap.h"
+#include "liblog/loggers/ring.h"
+#include "liblog/loggers/syslog.h"
+#include "buf.h"
+#include "clock.h"
+#include "kv.h"
+#include "namespace.h"
+#include "shm.h"
+
+/*------------------------------------------------------------------------*/
+
+/** how often new rings are searched (ms) */
+#define COLLECT_SCAN_MS 1000
+
+/** how long ring thread waits for messages (ms) */
+#define COLLECT_WAIT_MS 100
+
+/** Ring of producer process */
+struct collect_ring {
+	/** list node */
+	struct list list;
+
+	/** mapped ring */
+	struct ll_shm *s;
+
+	/** thread, which takes messages of ring */
+	pthread_t thread;
+
+	/** non-zero, if thread is finished */
+	int done;
+
+	/** number of dropped messages, which were reported */
+	uint64_t dropped;
+
+	/** name of producer, used for root namespace */
+	char ident[65];
+
+	/** name of ring file */
+	char name[];
+};
+
+/** no fields of message */
+static const struct ll_kv collect_none = { NULL, 0, NULL, 0 };
+
+/** non-zero, if collector should exit */
+static volatile sig_atomic_t collect_stop;
+
+/** namespace, which loggers write messages of all rings */
+static struct ll_namespace *collect_ns;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write message of ring
+ * @param [in] r pointer to ring
+ * @param [in] level logging level of message
+ * @param [in] ns namespace of message
+ * @param [in] ts timestamp of message in nanoseconds
+ * @param [in] msg message
+ * @param [in] kv fields of message
+ *
+ * Namespace is followed by pid of producer, like "MY[1234]", and root
+ * namespace is replaced by name of producer.
+ */
+static void collect_write(const struct collect_ring *r, enum ll_level level,
+	const char *ns, uint64_t ts, const char *msg, const struct ll_kv *kv) {
+	char name[128];
+
+	snprintf(name, sizeof(name), "%.100s[%d]", *ns ? ns : r->ident,
+		ll_shm_pid(r->s));
+
+	ll_clock_pin(ts);
+	ll_ns_relay(collect_ns, name, level, msg, kv);
+	ll_clock_pin(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Decode message of ring and write it
+ * @param [in] r pointer to ring
+ * @param [in] b message
+ * @return on success, zero is returned
+ * @retval -1 message is corrupted
+ */
+static int collect_msg(const struct collect_ring *r, const struct ll_buf *b)
+{
+	const char *end = b->data + b->len;
+	const char *ns = b->data + LL_SHM_HDR;
+	const char *msg, *fields;
+	uint64_t ts;
+
+	if (b->len < LL_SHM_HDR ||
+		(unsigned char)b->data[8] > LL_LEVEL_DEBUG ||
+		!(msg = memchr(ns, 0, end - ns)) ||
+		!(fields = memchr(msg + 1, 0, end - msg - 1))) {
+		return (-1);
+	}
+
+	++ msg;
+
+	const struct ll_kv kv = {
+		NULL, 0, (const unsigned char *)fields + 1, end - fields - 1
+	};
+
+	memcpy(&ts, b->data, sizeof(ts));
+	collect_write(r, b->data[8], ns, ts, msg, &kv);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Report messages, which were dropped since previous call
+ * @param [in] r pointer to ring
+ */
+static void collect_dropped(struct collect_ring *r)
+{
+	uint64_t dropped = ll_shm_dropped(r->s);
+	char msg[64];
+
+	if (dropped == r->dropped) {
+		return;
+	}
+
+	snprintf(msg, sizeof(msg), "%" PRIu64 " messages dropped",
+		dropped - r->dropped);
+	collect_write(r, LL_LEVEL_WARN, "", 0, msg, &collect_none);
+	r->dropped = dropped;
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Take messages of ring, until it's done or collector exits
+ * @param [in] arg pointer to ring
+ * @return @p arg
+ */
+static void *collect_thread(void *arg)
+{
+	struct collect_ring *r = arg;
+	struct ll_buf b = ll_buf_initializer;
+	int done = 0;
+
+	while (!done) {
+		int stop = collect_stop;
+
+		/* take the rest of messages without waiting, when exiting */
+		if (ll_shm_get(r->s, &b, stop ? 0 : COLLECT_WAIT_MS)) {
+			if (collect_msg(r, &b)) {
+				collect_write(r, LL_LEVEL_ERR, "", 0,
+					"corrupted message skipped", &collect_none);
+			}
+
+			continue;
+		}
+
+		collect_dropped(r);
+		done = ll_shm_done(r->s);
+
+		if (stop) {
+			break;
+		}
+	}
+
+	ll_buf_free(&b);
+	ll_shm_close(r->s, done);
+	__atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+
+	return (arg);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Map ring and start its thread
+ * @param [in] rings list of rings
+ * @param [in] name name of ring file
+ *
+ * Ring, which is not initialized yet, is mapped by next search.
+ */
+static void collect_start(struct list *rings, const char *name)
+{
+	struct collect_ring *r = calloc(1, sizeof(*r) + strlen(name) + 1);
+
+	if (!r) {
+		return;
+	}
+
+	strcpy(r->name, name);
+
+	/* name of ring is "liblog.IDENT.PID.N" */
+	snprintf(r->ident, sizeof(r->ident), "%s",
+		name + sizeof(LL_SHM_PREFIX) - 1);
+
+	for (int i = 0; i < 2; ++ i) {
+		char *dot = strrchr(r->ident, '.');
+
+		if (dot) {
+			*dot = '\0';
+		}
+	}
+
+	if (!(r->s = ll_shm_attach(name))) {
+		free(r);
+
+		return;
+	}
+
+	if (pthread_create(&r->thread, NULL, collect_thread, r)) {
+		ll_shm_close(r->s, 0);
+		free(r);
+
+		return;
+	}
+
+	list_add_head(rings, &r->list);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Join finished threads and free their rings
+ * @param [in] rings list of rings
+ * @param [in] all non-zero to wait for all threads
+ */
+static void collect_reap(struct list *rings, int all)
+{
+	struct collect_ring *i, *tmp;
+
+	list_foreach_safe(rings, i, tmp, struct collect_ring, list) {
+		if (all || __atomic_load_n(&i->done, __ATOMIC_ACQUIRE)) {
+			pthread_join(i->thread, NULL);
+			list_del_node(&i->list);
+			free(i);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Start threads for new rings
+ * @param [in] rings list of rings
+ */
+static void collect_scan(struct list *rings)
+{
+	DIR *d = opendir(LL_SHM_DIR);
+	struct dirent *e;
+
+	if (!d) {
+		return;
+	}
+
+	while ((e = readdir(d))) {
+		struct collect_ring *i;
+		int found = 0;
+
+		if (strncmp(e->d_name, LL_SHM_PREFIX, sizeof(LL_SHM_PREFIX) - 1)) {
+			continue;
+		}
+
+		list_foreach(rings, i, struct collect_ring, list) {
+			if (!strcmp(i->name, e->d_name)) {
+				found = 1;
+
+				break;
+			}
+		}
+
+		if (!found) {
+			collect_start(rings, e->d_name);
+		}
+	}
+
+	closedir(d);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Ask collector to exit
+ * @param [in] sig signal number
+ */
+static void collect_signal(int sig)
+{
+	unused(sig);
+
+	collect_stop = 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+	struct list rings = list_initializer(&rings);
+	struct ll_buf uris = ll_buf_initializer;
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = collect_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	ll_logger_binlog();
+	ll_logger_color();
+	ll_logger_file();
+	ll_logger_journal();
+	ll_logger_json();
+	ll_logger_mmap();
+	ll_logger_ring();
+	ll_logger_syslog();
+
+	/* arguments are URIs of loggers, stderr by default */
+	for (int i = 1; i < argc; ++ i) {
+		if (ll_buf_printf(&uris, i > 1 ? " %s" : "%s", argv[i])) {
+			return (EXIT_FAILURE);
+		}
+	}
+
+	if (ll_setup("", LL_LEVEL_DEBUG, uris.data ? uris.data : "") ||
+		!(collect_ns = ll_ns_lookup(""))) {
+		fprintf(stderr, "%s: can't open loggers\n", argv[0]);
+		ll_buf_free(&uris);
+
+		return (EXIT_FAILURE);
+	}
+
+	ll_buf_free(&uris);
+
+	while (!collect_stop) {
+		collect_reap(&rings, 0);
+		collect_scan(&rings);
+		nanosleep(&(struct timespec){ COLLECT_SCAN_MS / 1000,
+			COLLECT_SCAN_MS % 1000 * 1000000 }, NULL);
+	}
+
+	collect_reap(&rings, 1);
+	ll_cleanup();
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,297 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "liblog/log.h"
+#include "binlog.h"
+#include "buf.h"
+#include "format.h"
+#include "kv.h"
+
+/*------------------------------------------------------------------------*/
+
+/** Dictionaries of binary log file */
+struct decode {
+	/** namespaces, indexed by id */
+	char **names;
+
+	/** number of namespaces */
+	size_t names_n;
+
+	/** parsed format strings, indexed by id */
+	struct ll_fmt **formats;
+
+	/** number of format strings */
+	size_t formats_n;
+
+	/** timestamp of previous record in nanoseconds */
+	uint64_t last;
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Read variable length number from file
+ * @param [in] f file
+ * @param [out] v number
+ * @return on success, zero is returned
+ * @retval -1 end of file or error occurred
+ */
+static int decode_varint(FILE *f, uint64_t *v)
+{
+	*v = 0;
+
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		int c = getc(f);
+
+		if (c == EOF) {
+			return (-1);
+		}
+
+		*v |= (uint64_t)(c & 0x7f) << shift;
+
+		if (!(c & 0x80)) {
+			return (0);
+		}
+	}
+
+	return (-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Put string to dictionary
+ * @param [in,out] dict pointer to dictionary array
+ * @param [in,out] n number of strings in dictionary
+ * @param [in] id id of string
+ * @param [in] str string
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int decode_define(void ***dict, size_t *n, uint64_t id, void *str)
+{
+	if (id >= *n) {
+		void **p = realloc(*dict, (id + 1) * sizeof(*p));
+
+		if (!p) {
+			return (-1);
+		}
+
+		memset(p + *n, 0, (id + 1 - *n) * sizeof(*p));
+		*dict = p;
+		*n = id + 1;
+	}
+
+	(*dict)[id] = str;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Decode one record
+ * @param [in] d pointer to dictionaries
+ * @param [in] p record
+ * @param [in] end end of record
+ * @param [in] msg buffer for message
+ * @return on success, zero is returned
+ * @retval -1 record is corrupted
+ */
+static int decode_record(struct decode *d, const unsigned char *p,
+	const unsigned char *end, struct ll_buf *msg) {
+	uint64_t type, id, len, delta, level;
+
+	if (ll_varint_dec(&p, end, &type)) {
+		return (-1);
+	}
+
+	if (type == LL_BINLOG_NS || type == LL_BINLOG_FMT) {
+		if (ll_varint_dec(&p, end, &id) ||
+			ll_varint_dec(&p, end, &len) ||
+			len > (uint64_t)(end - p)) {
+			return (-1);
+		}
+
+		char *s = strndup((const char *)p, len);
+
+		if (!s) {
+			return (-1);
+		}
+
+		if (type == LL_BINLOG_NS) {
+			return (decode_define((void ***)&d->names, &d->names_n, id, s));
+		}
+
+		struct ll_fmt *fmt = ll_fmt_parse(s);
+
+		/* writer never defines formats, which can't be packed */
+		if (!fmt || fmt->eager || decode_define((void ***)&d->formats, &d->formats_n,
+			id, fmt)) {
+			ll_fmt_free(fmt);
+			free(s);
+
+			return (-1);
+		}
+
+		return (0);
+	}
+
+	if ((type != LL_BINLOG_MSG && type != LL_BINLOG_TEXT &&
+		type != LL_BINLOG_KV) ||
+		ll_varint_dec(&p, end, &delta) ||
+		ll_varint_dec(&p, end, &id) ||
+		ll_varint_dec(&p, end, &level) ||
+		id >= d->names_n || !d->names[id]) {
+		return (-1);
+	}
+
+	d->last += (int64_t)(delta >> 1) ^ -(int64_t)(delta & 1);
+	msg->len = 0;
+
+	if (type == LL_BINLOG_TEXT) {
+		if (ll_varint_dec(&p, end, &len) ||
+			len > (uint64_t)(end - p) ||
+			ll_buf_printf(msg, "%.*s", (int)len, p)) {
+			return (-1);
+		}
+	} else if (type == LL_BINLOG_KV) {
+		if (ll_varint_dec(&p, end, &len) ||
+			len > (uint64_t)(end - p) ||
+			ll_buf_append(msg, p, len)) {
+			return (-1);
+		}
+
+		const struct ll_kv kv = { NULL, 0, p + len, end - p - len };
+
+		/* fields follow message in logfmt encoding */
+		if ((kv.len && ll_buf_append(msg, " ", 1)) ||
+			ll_kv_encode(msg, LL_KV_LOGFMT, &kv) ||
+			ll_buf_append(msg, "", 1)) {
+			return (-1);
+		}
+	} else {
+		uint64_t fid;
+
+		if (ll_varint_dec(&p, end, &fid) ||
+			fid >= d->formats_n || !d->formats[fid] ||
+			ll_fmt_render(d->formats[fid], p, end - p, msg)) {
+			return (-1);
+		}
+	}
+
+	printf("%" PRIi64 ";%s;%s;%s\n", (int64_t)(d->last / 1000000000),
+		d->names[id], ll_level_str(level), msg->data);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Decode binary log file to standard output
+ * @param [in] f file
+ * @param [in] path name of file, for error messages
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int decode(FILE *f, const char *path)
+{
+	struct decode d = { NULL, 0, NULL, 0, 0 };
+	struct ll_buf rec = ll_buf_initializer;
+	struct ll_buf msg = ll_buf_initializer;
+	char magic[LL_BINLOG_MAGIC_LEN];
+	uint64_t len;
+	int rc = -1;
+
+	if (fread(magic, sizeof(magic), 1, f) != 1 ||
+		memcmp(magic, LL_BINLOG_MAGIC, sizeof(magic)) ||
+		decode_varint(f, &d.last)) {
+		fprintf(stderr, "%s: not a binary log file\n", path);
+
+		return (-1);
+	}
+
+	while (!decode_varint(f, &len)) {
+		rec.len = 0;
+
+		if (ll_buf_reserve(&rec, len) ||
+			fread(rec.data, 1, len, f) != len ||
+			decode_record(&d, (unsigned char *)rec.data,
+				(unsigned char *)rec.data + len, &msg)) {
+			fprintf(stderr, "%s: corrupted record\n", path);
+
+			goto out;
+		}
+	}
+
+	rc = feof(f) ? 0 : -1;
+
+out:
+	for (size_t i = 0; i < d.names_n; ++ i) {
+		free(d.names[i]);
+	}
+
+	for (size_t i = 0; i < d.formats_n; ++ i) {
+		if (d.formats[i]) {
+			free((char *)d.formats[i]->format);
+			ll_fmt_free(d.formats[i]);
+		}
+	}
+
+	free(d.names);
+	free(d.formats);
+	ll_buf_free(&rec);
+	ll_buf_free(&msg);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+	int rc = 0;
+
+	if (argc < 2) {
+		return (decode(stdin, "stdin") ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	for (int i = 1; i < argc; ++ i) {
+		FILE *f = fopen(argv[i], "r");
+
+		if (!f) {
+			perror(argv[i]);
+			rc = -1;
+
+			continue;
+		}
+
+		rc |= decode(f, argv[i]);
+		fclose(f);
+	}
+
+	return (rc ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,212 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "buf.h"
+#include "dedup.h"
+#include "printf.h"
+
+/*------------------------------------------------------------------------*/
+
+/** Last message of namespace, seen by thread */
+struct ll_dedup_slot {
+	/** namespace of message, NULL if slot is empty */
+	struct ll_namespace *ns;
+
+	/** hash of message */
+	uint64_t hash;
+
+	/** logging level of message */
+	enum ll_level level;
+
+	/** number of suppressed repeats */
+	uint64_t count;
+
+	/** time of first suppressed repeat */
+	uint64_t since;
+};
+
+/** Cache of current thread */
+struct ll_dedup_cache {
+	/** buffer of formatted message */
+	struct ll_buf body;
+
+	/** last messages, indexed by hash of namespace name */
+	struct ll_dedup_slot slot[LL_DEDUP_SLOTS];
+};
+
+/*------------------------------------------------------------------------*/
+
+/** initialize @ref ll_dedup_key */
+static pthread_once_t ll_dedup_once = PTHREAD_ONCE_INIT;
+
+/** free cache of exited thread */
+static pthread_key_t ll_dedup_key;
+
+/** cache of current thread */
+static __thread struct ll_dedup_cache *ll_dedup_cache;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free cache of exited thread
+ * @param [in] ptr pointer to cache
+ */
+static void ll_dedup_free(void *ptr)
+{
+	struct ll_dedup_cache *c = ptr;
+
+	ll_buf_free(&c->body);
+	free(c);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** Initialize key of caches once per process */
+static void ll_dedup_init(void)
+{
+	pthread_key_create(&ll_dedup_key, ll_dedup_free);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return cache of current thread
+ * @return pointer to cache
+ * @retval NULL error occurred
+ */
+static struct ll_dedup_cache *ll_dedup_get(void)
+{
+	struct ll_dedup_cache *c = ll_dedup_cache;
+
+	if (c) {
+		return (c);
+	}
+
+	pthread_once(&ll_dedup_once, ll_dedup_init);
+
+	if (!(c = calloc(1, sizeof(*c)))) {
+		return (NULL);
+	}
+
+	if (pthread_setspecific(ll_dedup_key, c)) {
+		free(c);
+
+		return (NULL);
+	}
+
+	return (ll_dedup_cache = c);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Mix data into hash (FNV-1a)
+ * @param [in] h current hash
+ * @param [in] data pointer to data
+ * @param [in] n size of data
+ * @return new hash
+ */
+static uint64_t ll_dedup_hash(uint64_t h, const void *data, size_t n)
+{
+	const unsigned char *p = data;
+
+	while (n --) {
+		h ^= *p ++;
+		h *= UINT64_C(1099511628211);
+	}
+
+	return (h);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_dedup(struct ll_namespace *ns, enum ll_level level, const char *format,
+	va_list args, const char **body, struct ll_dedup_repeat *repeat) {
+	assert(ns);
+	assert(format);
+	assert(body);
+	assert(repeat);
+
+	struct ll_dedup_cache *c = ll_dedup_get();
+
+	repeat->n = 0;
+
+	if (!c) {
+		return (-1);
+	}
+
+	c->body.len = 0;
+
+	if (ll_vformat(&c->body, format, args)) {
+		return (-1);
+	}
+
+	uint64_t h = UINT64_C(14695981039346656037);
+
+	h = ll_dedup_hash(h, &ns, sizeof(ns));
+	h = ll_dedup_hash(h, &level, sizeof(level));
+	h = ll_dedup_hash(h, &format, sizeof(format));
+	h = ll_dedup_hash(h, c->body.data, c->body.len);
+
+	struct ll_dedup_slot *s = &c->slot[ns->hash % LL_DEDUP_SLOTS];
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &t);
+
+	uint64_t now = t.tv_sec * UINT64_C(1000000000) + t.tv_nsec;
+
+	*body = c->body.data;
+
+	if (s->ns == ns && s->hash == h) {
+		if (!s->count ++) {
+			s->since = now;
+		}
+
+		/* long series of repeats is reported periodically */
+		if (now - s->since < LL_DEDUP_PERIOD) {
+			return (0);
+		}
+
+		repeat->ns = ns;
+		repeat->n = s->count;
+		repeat->level = s->level;
+		s->count = 0;
+
+		return (0);
+	}
+
+	/* series is over, or slot is taken by another namespace */
+	if (s->ns && s->count) {
+		repeat->ns = s->ns;
+		repeat->n = s->count;
+		repeat->level = s->level;
+	}
+
+	s->ns = ns;
+	s->hash = h;
+	s->level = level;
+	s->count = 0;
+
+	return (1);
+}
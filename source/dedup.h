@@ -0,0 +1,66 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_DEDUP_H
+#define __LIBLOG_DEDUP_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <liblog/types.h>
+
+#include "namespace.h"
+
+/** number of namespaces tracked by cache of every thread */
+#define LL_DEDUP_SLOTS 8
+
+/** repeats are summarized at least once per 30 seconds, like syslogd */
+#define LL_DEDUP_PERIOD (UINT64_C(30) * 1000000000)
+
+/** Summary of repeated message */
+struct ll_dedup_repeat {
+	/** namespace of repeated message */
+	struct ll_namespace *ns;
+
+	/** number of suppressed repeats, zero if nothing to report */
+	uint64_t n;
+
+	/** logging level of repeated message */
+	enum ll_level level;
+};
+
+/**
+ * @brief Format message and compare it with previous one of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] format format string of message
+ * @param [in] args list of arguments
+ * @param [out] body formatted message, valid until next call by thread
+ * @param [out] repeat summary of repeats to log before message
+ * @return 1 if message should be logged, 0 if it's duplicate
+ * @retval -1 error occurred
+ *
+ * Duplicates are detected by hash of namespace, level, format pointer
+ * and formatted message. Every thread has own cache, so only consecutive
+ * messages of the same thread are collapsed.
+ */
+int ll_dedup(struct ll_namespace *ns, enum ll_level level, const char *format,
+	va_list args, const char **body, struct ll_dedup_repeat *repeat
+);
+
+#endif /* __LIBLOG_DEDUP_H */
@@ -0,0 +1,506 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dgram.h"
+#include "namespace.h"
+
+/*------------------------------------------------------------------------*/
+
+/** maximum number of datagrams sent by one call */
+#define LL_DGRAM_BATCH 64
+
+/** how long drain thread waits for datagrams or socket (ms) */
+#define LL_DGRAM_IDLE_MS 100
+
+/** how long flush waits for drain thread (ns) */
+#define LL_DGRAM_PAUSE_NS 50000
+
+/** how many pauses flush waits for drain thread, one second in total */
+#define LL_DGRAM_FLUSH_PAUSES 20000
+
+/**
+ * @brief Slot of datagram queue
+ *
+ * Sequence of slot tells its state for position of queue: equal to
+ * position, if slot is free, position plus one, if datagram is ready.
+ */
+struct ll_dgram_cell {
+	/** sequence of slot */
+	size_t seq;
+
+	/** size of datagram */
+	size_t len;
+
+	/** datagram */
+	char data[];
+};
+
+/** Datagram sink */
+struct ll_dgram {
+	/** position of next datagram, taken by producers */
+	size_t head __attribute__((aligned(LL_CACHELINE)));
+
+	/** position of first queued datagram, moved by drain thread */
+	size_t tail __attribute__((aligned(LL_CACHELINE)));
+
+	/** number of dropped datagrams */
+	uint64_t dropped __attribute__((aligned(LL_CACHELINE)));
+
+	/** number of dropped datagrams, when flush was called */
+	uint64_t reported;
+
+	/** non-zero, if drain thread is waiting for datagrams */
+	int sleeping;
+
+	/** non-zero, if drain thread should finish */
+	int stop;
+
+	/** non-zero, if receiver didn't take datagrams while closing */
+	int stuck;
+
+	/** protect wake up of drain thread */
+	pthread_mutex_t lock;
+
+	/** signal drain thread about new datagrams */
+	pthread_cond_t wake;
+
+	/** drain thread */
+	pthread_t thread;
+
+	/** socket, -1 if not connected */
+	int fd;
+
+	/** number of slots minus one */
+	size_t mask;
+
+	/** maximum size of datagram */
+	size_t size;
+
+	/** size of slot */
+	size_t stride;
+
+	/** address of socket */
+	struct sockaddr_un addr;
+
+	/** slots */
+	unsigned char *cells;
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return slot of position
+ * @param [in] d pointer to datagram sink
+ * @param [in] pos position of queue
+ * @return pointer to slot
+ */
+static struct ll_dgram_cell *ll_dgram_cell(const struct ll_dgram *d,
+	size_t pos) {
+	return ((struct ll_dgram_cell *)(d->cells + (pos & d->mask) * d->stride));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, if datagram at given position is ready
+ * @param [in] d pointer to datagram sink
+ * @param [in] pos position of queue
+ * @return non-zero, if datagram is ready
+ */
+static int ll_dgram_ready(const struct ll_dgram *d, size_t pos)
+{
+	return (__atomic_load_n(&ll_dgram_cell(d, pos)->seq, __ATOMIC_ACQUIRE) ==
+		pos + 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief (Re)connect socket
+ * @param [in] d pointer to datagram sink
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_dgram_connect(struct ll_dgram *d)
+{
+	if (d->fd != -1) {
+		close(d->fd);
+	}
+
+	if (-1 == (d->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0))) {
+		return (-1);
+	}
+
+	if (connect(d->fd, (struct sockaddr *)&d->addr, sizeof(d->addr))) {
+		close(d->fd);
+		d->fd = -1;
+
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Wake up drain thread
+ * @param [in] d pointer to datagram sink
+ * @param [in] force wake it up, even if it's busy
+ */
+static void ll_dgram_wake(struct ll_dgram *d, int force)
+{
+	/* pairs with drain thread, which check queue after sleeping is set */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (force || __atomic_load_n(&d->sleeping, __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&d->lock);
+		pthread_cond_signal(&d->wake);
+		pthread_mutex_unlock(&d->lock);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Send batch of ready datagrams
+ * @param [in] d pointer to datagram sink
+ * @param [in] n number of ready datagrams
+ * @return number of datagrams, which can be released
+ */
+static int ll_dgram_send(struct ll_dgram *d, int n)
+{
+	struct mmsghdr msgs[LL_DGRAM_BATCH];
+	struct iovec iov[LL_DGRAM_BATCH];
+
+	/* don't wait for each batch, when sink is closing */
+	if (d->stuck) {
+		__atomic_add_fetch(&d->dropped, n, __ATOMIC_RELAXED);
+
+		return (n);
+	}
+
+	memset(msgs, 0, n * sizeof(msgs[0]));
+
+	for (int i = 0; i < n; ++ i) {
+		struct ll_dgram_cell *c = ll_dgram_cell(d, d->tail + i);
+
+		iov[i].iov_base = c->data;
+		iov[i].iov_len = c->len;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int sent = sendmmsg(d->fd, msgs, n, MSG_DONTWAIT);
+
+	if (sent >= 0) {
+		return (sent);
+	}
+
+	if (errno == EINTR) {
+		return (0);
+	}
+
+	/* receiver is busy, so wait for it, producers drop meanwhile */
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+		struct pollfd p = { d->fd, POLLOUT, 0 };
+
+		if (poll(&p, 1, LL_DGRAM_IDLE_MS) > 0 ||
+			!__atomic_load_n(&d->stop, __ATOMIC_ACQUIRE)) {
+			return (0);
+		}
+
+		/* receiver is stuck and sink is closing */
+		d->stuck = 1;
+		sent = n;
+	} else if (errno == EMSGSIZE) {
+		sent = 1;
+	} else {
+		/* receiver was restarted? */
+		sent = ll_dgram_connect(d) ? n : 1;
+	}
+
+	__atomic_add_fetch(&d->dropped, sent, __ATOMIC_RELAXED);
+
+	return (sent);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Drain thread, send queued datagrams to socket
+ * @param [in] arg pointer to datagram sink
+ * @return NULL
+ */
+static void *ll_dgram_thread(void *arg)
+{
+	struct ll_dgram *d = arg;
+
+	for (;;) {
+		int n = 0;
+
+		while (n < LL_DGRAM_BATCH && ll_dgram_ready(d, d->tail + n)) {
+			++ n;
+		}
+
+		if (n) {
+			int sent = ll_dgram_send(d, n);
+
+			/* slots are free for next round of queue */
+			for (int i = 0; i < sent; ++ i) {
+				__atomic_store_n(&ll_dgram_cell(d, d->tail + i)->seq,
+					d->tail + i + d->mask + 1, __ATOMIC_RELEASE);
+			}
+
+			__atomic_store_n(&d->tail, d->tail + sent, __ATOMIC_RELEASE);
+
+			continue;
+		}
+
+		/* finish only when all datagrams are sent */
+		if (__atomic_load_n(&d->stop, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+
+		pthread_mutex_lock(&d->lock);
+		__atomic_store_n(&d->sleeping, 1, __ATOMIC_SEQ_CST);
+
+		if (!ll_dgram_ready(d, d->tail) && !d->stop) {
+			struct timespec ts;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += LL_DGRAM_IDLE_MS * 1000000L;
+			ts.tv_sec += ts.tv_nsec / 1000000000L;
+			ts.tv_nsec %= 1000000000L;
+
+			pthread_cond_timedwait(&d->wake, &d->lock, &ts);
+		}
+
+		__atomic_store_n(&d->sleeping, 0, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&d->lock);
+	}
+
+	return (NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+struct ll_dgram *ll_dgram_open(const char *path, size_t slots, size_t size)
+{
+	assert(path);
+
+	struct ll_dgram *d;
+
+	if (strlen(path) >= sizeof(d->addr.sun_path) || !size ||
+		posix_memalign((void **)&d, LL_CACHELINE, sizeof(*d))) {
+		return (NULL);
+	}
+
+	memset(d, 0, sizeof(*d));
+	d->fd = -1;
+	d->size = size;
+	d->stride = (sizeof(struct ll_dgram_cell) + size + LL_CACHELINE - 1) &
+		~(size_t)(LL_CACHELINE - 1);
+	d->addr.sun_family = AF_UNIX;
+	strcpy(d->addr.sun_path, path);
+
+	size_t n = 2;
+
+	/* number of slots should be power of two */
+	while (n < slots) {
+		n <<= 1;
+	}
+
+	d->mask = n - 1;
+
+	if (posix_memalign((void **)&d->cells, LL_CACHELINE,
+		(d->mask + 1) * d->stride)) {
+		free(d);
+
+		return (NULL);
+	}
+
+	for (size_t i = 0; i <= d->mask; ++ i) {
+		ll_dgram_cell(d, i)->seq = i;
+	}
+
+	pthread_mutex_init(&d->lock, NULL);
+	pthread_cond_init(&d->wake, NULL);
+
+	if (ll_dgram_connect(d) ||
+		pthread_create(&d->thread, NULL, ll_dgram_thread, d)) {
+		if (d->fd != -1) {
+			close(d->fd);
+		}
+
+		pthread_cond_destroy(&d->wake);
+		pthread_mutex_destroy(&d->lock);
+		free(d->cells);
+		free(d);
+
+		return (NULL);
+	}
+
+	return (d);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_dgram_put(struct ll_dgram *d, const struct iovec *iov, int n,
+	int trunc) {
+	assert(d);
+	assert(iov);
+
+	size_t len = 0;
+
+	for (int i = 0; i < n; ++ i) {
+		len += iov[i].iov_len;
+	}
+
+	if (len > d->size) {
+		if (!trunc) {
+			__atomic_add_fetch(&d->dropped, 1, __ATOMIC_RELAXED);
+
+			return (-1);
+		}
+
+		len = d->size;
+	}
+
+	size_t pos = __atomic_load_n(&d->head, __ATOMIC_RELAXED);
+	struct ll_dgram_cell *c;
+
+	/* take free slot, other producers can take it meanwhile */
+	for (;;) {
+		c = ll_dgram_cell(d, pos);
+
+		intptr_t dif = (intptr_t)__atomic_load_n(&c->seq,
+			__ATOMIC_ACQUIRE) - (intptr_t)pos;
+
+		if (dif < 0) {
+			/* queue is full */
+			__atomic_add_fetch(&d->dropped, 1, __ATOMIC_RELAXED);
+
+			return (-1);
+		}
+
+		if (!dif && __atomic_compare_exchange_n(&d->head, &pos, pos + 1, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			break;
+		}
+
+		if (dif) {
+			pos = __atomic_load_n(&d->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	char *p = c->data;
+
+	for (int i = 0; i < n && p < c->data + len; ++ i) {
+		size_t k = iov[i].iov_len;
+
+		if (k > (size_t)(c->data + len - p)) {
+			k = c->data + len - p;
+		}
+
+		memcpy(p, iov[i].iov_base, k);
+		p += k;
+	}
+
+	c->len = len;
+	__atomic_store_n(&c->seq, pos + 1, __ATOMIC_RELEASE);
+	ll_dgram_wake(d, 0);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+uint64_t ll_dgram_dropped(struct ll_dgram *d)
+{
+	assert(d);
+
+	return (__atomic_load_n(&d->dropped, __ATOMIC_RELAXED));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_dgram_flush(struct ll_dgram *d)
+{
+	assert(d);
+
+	int rc = -1;
+
+	for (int i = 0; i < LL_DGRAM_FLUSH_PAUSES; ++ i) {
+		if (__atomic_load_n(&d->tail, __ATOMIC_ACQUIRE) ==
+			__atomic_load_n(&d->head, __ATOMIC_RELAXED)) {
+			rc = 0;
+
+			break;
+		}
+
+		ll_dgram_wake(d, 1);
+		nanosleep(&(struct timespec){0, LL_DGRAM_PAUSE_NS}, NULL);
+	}
+
+	uint64_t dropped = ll_dgram_dropped(d);
+
+	/* report loss once, including one by socket errors */
+	if (__atomic_exchange_n(&d->reported, dropped, __ATOMIC_RELAXED) !=
+		dropped) {
+		rc = -1;
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_dgram_close(struct ll_dgram *d)
+{
+	if (!d) {
+		return;
+	}
+
+	/* drain thread will finish, when all datagrams are sent */
+	__atomic_store_n(&d->stop, 1, __ATOMIC_RELEASE);
+	ll_dgram_wake(d, 1);
+	pthread_join(d->thread, NULL);
+
+	if (d->fd != -1) {
+		close(d->fd);
+	}
+
+	pthread_cond_destroy(&d->wake);
+	pthread_mutex_destroy(&d->lock);
+	free(d->cells);
+	free(d);
+}
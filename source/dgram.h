@@ -0,0 +1,81 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_DGRAM_H
+#define __LIBLOG_DGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+/** Datagram sink, see ll_dgram_open() */
+struct ll_dgram;
+
+/**
+ * @brief Connect to local datagram socket and start drain thread
+ * @param [in] path path of Unix socket
+ * @param [in] slots number of queued datagrams, rounded up to power of two
+ * @param [in] size maximum size of datagram
+ * @return pointer to datagram sink, free it by ll_dgram_close()
+ * @retval NULL error occurred
+ *
+ * Datagrams are queued by producers without locks, and sent by drain
+ * thread by batches of sendmmsg() without blocking on socket.
+ */
+struct ll_dgram *ll_dgram_open(const char *path, size_t slots, size_t size);
+
+/**
+ * @brief Queue datagram gathered from pieces
+ * @param [in] d pointer to datagram sink
+ * @param [in] iov pieces of datagram
+ * @param [in] n number of pieces
+ * @param [in] trunc non-zero to truncate too big datagram, zero to drop it
+ * @return on success, zero is returned
+ * @retval -1 queue is full or datagram is too big (datagram was dropped)
+ *
+ * Producer never waits for socket or drain thread, dropped datagrams
+ * are counted, see ll_dgram_dropped().
+ */
+int ll_dgram_put(struct ll_dgram *d, const struct iovec *iov, int n,
+	int trunc
+);
+
+/**
+ * @brief Return number of dropped datagrams
+ * @param [in] d pointer to datagram sink
+ * @return number of datagrams dropped by full queue or error of socket
+ */
+uint64_t ll_dgram_dropped(struct ll_dgram *d);
+
+/**
+ * @brief Wait until queued datagrams are sent
+ * @param [in] d pointer to datagram sink
+ * @return on success, zero is returned
+ * @retval -1 queue wasn't drained in time, or datagrams were dropped
+ * since previous call
+ */
+int ll_dgram_flush(struct ll_dgram *d);
+
+/**
+ * @brief Send queued datagrams, stop drain thread and close socket
+ * @param [in] d pointer to datagram sink (can be NULL)
+ */
+void ll_dgram_close(struct ll_dgram *d);
+
+#endif /* __LIBLOG_DGRAM_H */
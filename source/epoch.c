@@ -0,0 +1,281 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+
+#include "epoch.h"
+
+/*------------------------------------------------------------------------*/
+
+/** Epoch of thread */
+struct ll_epoch_rec {
+	/** global epoch shifted left by one, low bit is set inside section */
+	uint64_t epoch __attribute__((aligned(64)));
+
+	/** nesting of critical sections */
+	unsigned depth;
+
+	/** record is owned by thread */
+	int used;
+
+	/** next record */
+	struct ll_epoch_rec *next;
+};
+
+/*------------------------------------------------------------------------*/
+
+/** global epoch */
+static uint64_t ll_epoch;
+
+/** records of threads, they are reused and never freed */
+static struct ll_epoch_rec *ll_epoch_recs;
+
+/** retired objects, protected by @ref ll_epoch_lock */
+static struct ll_epoch_node *ll_epoch_objs;
+
+/** serialize reclamation */
+static pthread_mutex_t ll_epoch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** initialize @ref ll_epoch_key and @ref ll_epoch_light */
+static pthread_once_t ll_epoch_once = PTHREAD_ONCE_INIT;
+
+/** release record of exited thread */
+static pthread_key_t ll_epoch_key;
+
+/** membarrier() is available, so readers can skip memory barrier */
+static int ll_epoch_light;
+
+/** record of current thread */
+static __thread struct ll_epoch_rec *ll_epoch_self;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Release record of exited thread
+ * @param [in] ptr record of thread
+ */
+static void ll_epoch_release(void *ptr)
+{
+	struct ll_epoch_rec *r = ptr;
+
+	__atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** Initialize reclamation once per process */
+static void ll_epoch_init(void)
+{
+	pthread_key_create(&ll_epoch_key, ll_epoch_release);
+
+	/* writers will interrupt readers instead of readers pay for barrier */
+	ll_epoch_light = !syscall(__NR_membarrier,
+		MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Take record for current thread
+ * @return pointer to record
+ * @retval NULL error occurred
+ */
+static struct ll_epoch_rec *ll_epoch_register(void)
+{
+	struct ll_epoch_rec *r;
+
+	pthread_once(&ll_epoch_once, ll_epoch_init);
+
+	/* reuse record of exited thread */
+	for (r = __atomic_load_n(&ll_epoch_recs, __ATOMIC_ACQUIRE); r;
+		r = r->next) {
+		int used = 0;
+
+		if (__atomic_compare_exchange_n(&r->used, &used, 1, 0,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+
+	if (!r) {
+		if (posix_memalign((void **)&r, 64, sizeof(*r))) {
+			return (NULL);
+		}
+
+		r->epoch = 0;
+		r->used = 1;
+		r->next = __atomic_load_n(&ll_epoch_recs, __ATOMIC_RELAXED);
+
+		while (!__atomic_compare_exchange_n(&ll_epoch_recs, &r->next, r, 0,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+
+	r->depth = 0;
+	pthread_setspecific(ll_epoch_key, r);
+
+	return (ll_epoch_self = r);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_epoch_enter(void)
+{
+	struct ll_epoch_rec *r = ll_epoch_self;
+
+	if (!r && !(r = ll_epoch_register())) {
+		/* out of memory, it's better than crash */
+		abort();
+	}
+
+	if (r->depth ++) {
+		return;
+	}
+
+	uint64_t e = __atomic_load_n(&ll_epoch, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&r->epoch, e << 1 | 1, __ATOMIC_RELAXED);
+
+	/* make epoch visible before any read of protected objects */
+	if (ll_epoch_light) {
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	} else {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_epoch_exit(void)
+{
+	struct ll_epoch_rec *r = ll_epoch_self;
+
+	assert(r);
+	assert(r->depth);
+
+	if (!-- r->depth) {
+		__atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Advance global epoch and free objects, nobody can see anymore
+ * @return count of objects still waiting for reclamation
+ *
+ * Must be called with @ref ll_epoch_lock held.
+ */
+static size_t ll_epoch_reclaim(void)
+{
+	uint64_t e = __atomic_load_n(&ll_epoch, __ATOMIC_RELAXED);
+	struct ll_epoch_node **p = &ll_epoch_objs;
+	size_t pending = 0;
+	int advance = 1;
+
+	/* reclaimer can run before any reader, barrier protocol is chosen once */
+	pthread_once(&ll_epoch_once, ll_epoch_init);
+
+	/* make sure, that epochs published by readers are visible */
+	if (ll_epoch_light) {
+		syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+	} else {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+
+	for (struct ll_epoch_rec *r = __atomic_load_n(&ll_epoch_recs,
+		__ATOMIC_ACQUIRE); r; r = r->next) {
+		uint64_t v = __atomic_load_n(&r->epoch, __ATOMIC_ACQUIRE);
+
+		/* reader is still in previous epoch */
+		if ((v & 1) && (v >> 1) != e) {
+			advance = 0;
+			break;
+		}
+	}
+
+	if (advance) {
+		__atomic_store_n(&ll_epoch, ++ e, __ATOMIC_SEQ_CST);
+	}
+
+	/* objects retired two epochs ago are unreachable */
+	while (*p) {
+		struct ll_epoch_node *o = *p;
+
+		if (o->epoch + 2 <= e) {
+			*p = o->next;
+			o->free_cb(o);
+		} else {
+			p = &o->next;
+			++ pending;
+		}
+	}
+
+	return (pending);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_epoch_retire(struct ll_epoch_node *node,
+	void (*free_cb)(struct ll_epoch_node *node)) {
+	assert(node);
+	assert(free_cb);
+
+	const struct timespec ts = { .tv_nsec = 10000 };
+	const struct ll_epoch_rec *self = ll_epoch_self;
+
+	pthread_mutex_lock(&ll_epoch_lock);
+
+	node->epoch = __atomic_load_n(&ll_epoch, __ATOMIC_RELAXED);
+	node->free_cb = free_cb;
+	node->next = ll_epoch_objs;
+	ll_epoch_objs = node;
+
+	/* reader can't wait for itself */
+	while (ll_epoch_reclaim() && (!self || !self->depth)) {
+		pthread_mutex_unlock(&ll_epoch_lock);
+		nanosleep(&ts, NULL);
+		pthread_mutex_lock(&ll_epoch_lock);
+	}
+
+	pthread_mutex_unlock(&ll_epoch_lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_epoch_free(void)
+{
+	pthread_mutex_lock(&ll_epoch_lock);
+
+	while (ll_epoch_objs) {
+		struct ll_epoch_node *o = ll_epoch_objs;
+
+		ll_epoch_objs = o->next;
+		o->free_cb(o);
+	}
+
+	pthread_mutex_unlock(&ll_epoch_lock);
+}
@@ -0,0 +1,65 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_EPOCH_H
+#define __LIBLOG_EPOCH_H
+
+#include <stdint.h>
+
+/** Node of object waiting for reclamation, embedded in object */
+struct ll_epoch_node {
+	/** global epoch, when object was retired */
+	uint64_t epoch;
+
+	/** destructor of object */
+	void (*free_cb)(struct ll_epoch_node *node);
+
+	/** next retired object */
+	struct ll_epoch_node *next;
+};
+
+/**
+ * @brief Enter read-side critical section
+ *
+ * Objects retired by ll_epoch_retire() are not freed, while any thread,
+ * which could see them, stays in critical section. Sections can be nested.
+ * It's cheap: thread publishes the epoch it started in, without locking.
+ */
+void ll_epoch_enter(void);
+
+/** Leave read-side critical section */
+void ll_epoch_exit(void);
+
+/**
+ * @brief Free object, when all threads leave critical sections
+ * @param [in] node node embedded in object, already unreachable for readers
+ * @param [in] free_cb destructor of object
+ *
+ * Caller waits, until object can be freed, except when it's called
+ * from critical section itself. Then object is freed later by next call
+ * or by ll_epoch_free().
+ */
+void ll_epoch_retire(struct ll_epoch_node *node,
+	void (*free_cb)(struct ll_epoch_node *node)
+);
+
+/** Free all retired objects, there should be no readers anymore */
+void ll_epoch_free(void);
+
+#endif /* __LIBLOG_EPOCH_H */
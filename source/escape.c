@@ -0,0 +1,268 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <immintrin.h>
+#	define LL_ESCAPE_X86
+#endif /* __x86_64__ || __i386__ */
+
+#include "escape.h"
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Escape routine of string
+ * @param [out] p output, at least six bytes per byte of string
+ * @param [in] s string
+ * @param [in] len length of string
+ * @return end of output
+ */
+typedef char *(*ll_escape_cb_t)(char *p, const char *s, size_t len);
+
+/** escape routine chosen for CPU, NULL until first call */
+static ll_escape_cb_t ll_escape_impl;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, if byte should be escaped
+ * @param [in] c byte
+ * @return non-zero, if byte is quote, backslash or control character
+ */
+static inline int ll_escape_need(unsigned char c)
+{
+	return (c < 0x20 || c == '"' || c == '\\');
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write escape sequence of byte
+ * @param [out] p output, at least six bytes
+ * @param [in] c byte, which should be escaped
+ * @return end of output
+ */
+static inline char *ll_escape_char(char *p, unsigned char c)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	*p ++ = '\\';
+
+	switch (c) {
+		case '"':
+		case '\\':
+			*p ++ = c;
+			break;
+
+		case '\b':
+			*p ++ = 'b';
+			break;
+
+		case '\f':
+			*p ++ = 'f';
+			break;
+
+		case '\n':
+			*p ++ = 'n';
+			break;
+
+		case '\r':
+			*p ++ = 'r';
+			break;
+
+		case '\t':
+			*p ++ = 't';
+			break;
+
+		default:
+			*p ++ = 'u';
+			*p ++ = '0';
+			*p ++ = '0';
+			*p ++ = hex[c >> 4];
+			*p ++ = hex[c & 0xf];
+			break;
+	}
+
+	return (p);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Escape string byte by byte
+ * @copydetails ll_escape_cb_t
+ */
+static char *ll_escape_scalar(char *p, const char *s, size_t len)
+{
+	for (const char *end = s + len; s < end; ++ s) {
+		unsigned char c = *s;
+
+		if (ll_escape_need(c)) {
+			p = ll_escape_char(p, c);
+		} else {
+			*p ++ = c;
+		}
+	}
+
+	return (p);
+}
+
+/*------------------------------------------------------------------------*/
+
+#ifdef LL_ESCAPE_X86
+/**
+ * @brief Escape string by 16 bytes blocks
+ * @copydetails ll_escape_cb_t
+ *
+ * Block is copied as is, then output is rewound to first byte, which
+ * should be escaped. Output has a room for that, see ll_escape_json().
+ */
+__attribute__((target("sse2")))
+static char *ll_escape_sse2(char *p, const char *s, size_t len)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i slash = _mm_set1_epi8('\\');
+	const __m128i ctrl = _mm_set1_epi8(0x1f);
+	const char *end = s + len;
+
+	while (end - s >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)s);
+		__m128i m = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+				_mm_cmpeq_epi8(v, slash)),
+			/* unsigned v <= 0x1f */
+			_mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+		unsigned mask = _mm_movemask_epi8(m);
+
+		_mm_storeu_si128((__m128i *)p, v);
+
+		if (!mask) {
+			p += 16;
+			s += 16;
+
+			continue;
+		}
+
+		unsigned n = __builtin_ctz(mask);
+
+		p = ll_escape_char(p + n, s[n]);
+		s += n + 1;
+	}
+
+	return (ll_escape_scalar(p, s, end - s));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Escape string by 32 bytes blocks
+ * @copydetails ll_escape_sse2
+ */
+__attribute__((target("avx2")))
+static char *ll_escape_avx2(char *p, const char *s, size_t len)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i slash = _mm256_set1_epi8('\\');
+	const __m256i ctrl = _mm256_set1_epi8(0x1f);
+	const char *end = s + len;
+
+	while (end - s >= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)s);
+		__m256i m = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+				_mm256_cmpeq_epi8(v, slash)),
+			/* unsigned v <= 0x1f */
+			_mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl), v));
+		unsigned mask = _mm256_movemask_epi8(m);
+
+		_mm256_storeu_si256((__m256i *)p, v);
+
+		if (!mask) {
+			p += 32;
+			s += 32;
+
+			continue;
+		}
+
+		unsigned n = __builtin_ctz(mask);
+
+		p = ll_escape_char(p + n, s[n]);
+		s += n + 1;
+	}
+
+	return (ll_escape_sse2(p, s, end - s));
+}
+#endif /* LL_ESCAPE_X86 */
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Choose escape routine for CPU of process
+ * @return escape routine
+ */
+static ll_escape_cb_t ll_escape_choose(void)
+{
+#ifdef LL_ESCAPE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		return (ll_escape_avx2);
+	}
+
+	if (__builtin_cpu_supports("sse2")) {
+		return (ll_escape_sse2);
+	}
+#endif /* LL_ESCAPE_X86 */
+
+	return (ll_escape_scalar);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_escape_json(struct ll_buf *b, const char *s, size_t len)
+{
+	assert(b);
+	assert(s || !len);
+
+	ll_escape_cb_t cb = __atomic_load_n(&ll_escape_impl, __ATOMIC_RELAXED);
+
+	/* the same routine is chosen by every thread, so race is harmless */
+	if (!cb) {
+		cb = ll_escape_choose();
+		__atomic_store_n(&ll_escape_impl, cb, __ATOMIC_RELAXED);
+	}
+
+	/* the worst case, every byte is escaped by \u00XX */
+	if (ll_buf_reserve(b, len * 6 + 2)) {
+		return (-1);
+	}
+
+	char *p = b->data + b->len;
+
+	*p ++ = '"';
+	p = cb(p, s, len);
+	*p ++ = '"';
+	b->len = p - b->data;
+
+	return (0);
+}
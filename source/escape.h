@@ -0,0 +1,42 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_ESCAPE_H
+#define __LIBLOG_ESCAPE_H
+
+#include <stddef.h>
+
+#include "buf.h"
+
+/**
+ * @brief Append quoted JSON string to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] s string, isn't required to be null-terminated
+ * @param [in] len length of string
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Quote, backslash and control characters are escaped, other bytes are
+ * copied as is. Clean runs of string are scanned by SSE2 or AVX2, chosen
+ * once by CPU of process, or byte by byte on other architectures.
+ * Data of buffer is not null-terminated.
+ */
+int ll_escape_json(struct ll_buf *b, const char *s, size_t len);
+
+#endif /* __LIBLOG_ESCAPE_H */
@@ -0,0 +1,751 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "format.h"
+
+/*------------------------------------------------------------------------*/
+
+/** Position in buffer of packed arguments */
+struct ll_cursor {
+	/** current position */
+	unsigned char *p;
+
+	/** end of buffer */
+	unsigned char *end;
+};
+
+/*------------------------------------------------------------------------*/
+
+size_t ll_varint_enc(unsigned char *p, uint64_t v)
+{
+	size_t n = 0;
+
+	do {
+		p[n ++] = (v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+		v >>= 7;
+	} while (v);
+
+	return (n);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_varint_dec(const unsigned char **p, const unsigned char *end,
+	uint64_t *v) {
+	*v = 0;
+
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		if (*p == end) {
+			return (-1);
+		}
+
+		*v |= (uint64_t)(**p & 0x7f) << shift;
+
+		if (!(*(*p) ++ & 0x80)) {
+			return (0);
+		}
+	}
+
+	return (-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Parse number of format string
+ * @param [in,out] p pointer to format string
+ * @return parsed number
+ */
+static int ll_fmt_num(const char **p)
+{
+	int n = 0;
+
+	while (**p >= '0' && **p <= '9') {
+		n = n * 10 + *(*p) ++ - '0';
+	}
+
+	return (n);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Parse one conversion specification
+ * @param [in,out] p pointer to format string, right after '%'
+ * @param [out] c pointer to conversion
+ * @return on success, zero is returned
+ * @retval -1 conversion can't be deferred
+ */
+static int ll_fmt_conv(const char **p, struct ll_conv *c)
+{
+	size_t n = 0;
+
+	/* flags */
+	while (**p && strchr("-+ #0'I", **p)) {
+		if (n == sizeof(c->flags) - 1) {
+			return (-1);
+		}
+
+		c->flags[n ++] = *(*p) ++;
+	}
+
+	c->flags[n] = 0;
+
+	/* width */
+	if (**p == '*') {
+		c->width = -2;
+		++ *p;
+	} else if (**p >= '0' && **p <= '9') {
+		c->width = ll_fmt_num(p);
+	} else {
+		c->width = -1;
+	}
+
+	/* positional arguments are not supported */
+	if (**p == '$') {
+		return (-1);
+	}
+
+	/* precision */
+	c->prec = -1;
+
+	if (**p == '.') {
+		++ *p;
+
+		if (**p == '*') {
+			c->prec = -2;
+			++ *p;
+		} else {
+			c->prec = ll_fmt_num(p);
+		}
+	}
+
+	/* length modifier */
+	n = 0;
+
+	while (**p && strchr("hlLqjzZt", **p)) {
+		if (n == sizeof(c->length) - 1) {
+			return (-1);
+		}
+
+		c->length[n ++] = *(*p) ++;
+	}
+
+	c->length[n] = 0;
+	c->conv = *(*p) ++;
+
+	switch (c->conv) {
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'c':
+			if (!*c->length || *c->length == 'h' ||
+				(c->conv == 'c' && !strcmp(c->length, "l"))) {
+				c->type = LL_ARG_INT;
+			} else if (!strcmp(c->length, "l")) {
+				c->type = LL_ARG_LONG;
+			} else if (!strcmp(c->length, "ll") || !strcmp(c->length, "q")) {
+				c->type = LL_ARG_LLONG;
+			} else if (!strcmp(c->length, "j")) {
+				c->type = LL_ARG_INTMAX;
+			} else if (!strcmp(c->length, "z") || !strcmp(c->length, "Z")) {
+				c->type = LL_ARG_SIZE;
+			} else if (!strcmp(c->length, "t")) {
+				c->type = LL_ARG_PTRDIFF;
+			} else {
+				return (-1);
+			}
+
+			break;
+
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			if (!*c->length || !strcmp(c->length, "l")) {
+				c->type = LL_ARG_DOUBLE;
+			} else if (!strcmp(c->length, "L")) {
+				c->type = LL_ARG_LDOUBLE;
+			} else {
+				return (-1);
+			}
+
+			break;
+
+		case 'p':
+			c->type = LL_ARG_PTR;
+
+			break;
+
+		case 's':
+			if (*c->length) {
+				return (-1);
+			}
+
+			c->type = LL_ARG_STR;
+
+			break;
+
+		case '%':
+			c->type = LL_ARG_NONE;
+
+			break;
+
+		default:
+			/* "%n", "%m", wide strings, etc. */
+			return (-1);
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+struct ll_fmt *ll_fmt_parse(const char *format)
+{
+	assert(format);
+
+	size_t n = 0;
+
+	/* count maximal number of conversions */
+	for (const char *p = format; (p = strchr(p, '%')); ++ p) {
+		++ n;
+	}
+
+	struct ll_fmt *fmt = calloc(1, sizeof(*fmt) + n * sizeof(fmt->conv[0]));
+
+	if (!fmt) {
+		return (NULL);
+	}
+
+	fmt->format = format;
+
+	const char *lit = format;
+	const char *p = format;
+
+	while ((p = strchr(p, '%'))) {
+		struct ll_conv *c = &fmt->conv[fmt->n];
+
+		c->lit = lit;
+		c->lit_len = p ++ - lit;
+
+		if (ll_fmt_conv(&p, c)) {
+			fmt->eager = 1;
+			fmt->n = 0;
+
+			break;
+		}
+
+		lit = p;
+		++ fmt->n;
+	}
+
+	fmt->tail = lit;
+
+	return (fmt);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Put data to packed arguments
+ * @param [in,out] c pointer to cursor
+ * @param [in] data pointer to data
+ * @param [in] n size of data
+ * @return on success, zero is returned
+ * @retval -1 buffer is too small
+ */
+static int ll_put(struct ll_cursor *c, const void *data, size_t n)
+{
+	if ((size_t)(c->end - c->p) < n) {
+		return (-1);
+	}
+
+	memcpy(c->p, data, n);
+	c->p += n;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Put variable length number to packed arguments
+ * @param [in,out] c pointer to cursor
+ * @param [in] v number
+ * @return on success, zero is returned
+ * @retval -1 buffer is too small
+ */
+static int ll_put_varint(struct ll_cursor *c, uint64_t v)
+{
+	unsigned char tmp[LL_VARINT_MAX];
+
+	return (ll_put(c, tmp, ll_varint_enc(tmp, v)));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Put signed number to packed arguments
+ * @param [in,out] c pointer to cursor
+ * @param [in] v number
+ * @return on success, zero is returned
+ * @retval -1 buffer is too small
+ */
+static int ll_put_int(struct ll_cursor *c, int64_t v)
+{
+	/* zigzag encoding, to keep small negative numbers short */
+	return (ll_put_varint(c, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63)));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_fmt_pack(const struct ll_fmt *fmt, void *dst, size_t size,
+	va_list args) {
+	assert(fmt);
+	assert(!fmt->eager);
+
+	struct ll_cursor c = { dst, (unsigned char *)dst + size };
+
+	for (size_t i = 0; i < fmt->n; ++ i) {
+		const struct ll_conv *conv = &fmt->conv[i];
+		int prec = conv->prec;
+		int rc = 0;
+
+		if (conv->width == -2) {
+			rc |= ll_put_int(&c, va_arg(args, int));
+		}
+
+		if (conv->prec == -2) {
+			prec = va_arg(args, int);
+			rc |= ll_put_int(&c, prec);
+		}
+
+		switch (conv->type) {
+			case LL_ARG_NONE:
+				break;
+
+			case LL_ARG_INT:
+				rc |= ll_put_int(&c, va_arg(args, int));
+
+				break;
+
+			case LL_ARG_LONG:
+				rc |= ll_put_int(&c, va_arg(args, long));
+
+				break;
+
+			case LL_ARG_LLONG:
+				rc |= ll_put_int(&c, va_arg(args, long long));
+
+				break;
+
+			case LL_ARG_INTMAX:
+				rc |= ll_put_int(&c, va_arg(args, intmax_t));
+
+				break;
+
+			case LL_ARG_SIZE:
+				rc |= ll_put_int(&c, va_arg(args, size_t));
+
+				break;
+
+			case LL_ARG_PTRDIFF:
+				rc |= ll_put_int(&c, va_arg(args, ptrdiff_t));
+
+				break;
+
+			case LL_ARG_DOUBLE: {
+				double v = va_arg(args, double);
+
+				rc |= ll_put(&c, &v, sizeof(v));
+
+				break;
+			}
+
+			case LL_ARG_LDOUBLE: {
+				long double v = va_arg(args, long double);
+
+				rc |= ll_put(&c, &v, sizeof(v));
+
+				break;
+			}
+
+			case LL_ARG_PTR:
+				rc |= ll_put_varint(&c, (uintptr_t)va_arg(args, void *));
+
+				break;
+
+			case LL_ARG_STR: {
+				const char *s = va_arg(args, const char *);
+
+				/* zero length is reserved for NULL */
+				if (!s) {
+					rc |= ll_put_varint(&c, 0);
+
+					break;
+				}
+
+				size_t len = prec >= 0 ? strnlen(s, prec) : strlen(s);
+
+				rc |= ll_put_varint(&c, len + 1);
+				rc |= ll_put(&c, s, len);
+
+				break;
+			}
+		}
+
+		if (rc) {
+			return (-1);
+		}
+	}
+
+	return (c.p - (unsigned char *)dst);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Get variable length number from packed arguments
+ * @param [in,out] c pointer to cursor
+ * @param [out] v number
+ * @return on success, zero is returned
+ * @retval -1 packed arguments are corrupted
+ */
+static int ll_get_varint(struct ll_cursor *c, uint64_t *v)
+{
+	return (ll_varint_dec((const unsigned char **)&c->p, c->end, v));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Get signed number from packed arguments
+ * @param [in,out] c pointer to cursor
+ * @param [out] v number
+ * @return on success, zero is returned
+ * @retval -1 packed arguments are corrupted
+ */
+static int ll_get_int(struct ll_cursor *c, int64_t *v)
+{
+	uint64_t u;
+
+	if (ll_get_varint(c, &u)) {
+		return (-1);
+	}
+
+	*v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Get data from packed arguments
+ * @param [in,out] c pointer to cursor
+ * @param [out] data buffer for data
+ * @param [in] n size of data
+ * @return on success, zero is returned
+ * @retval -1 packed arguments are corrupted
+ */
+static int ll_get(struct ll_cursor *c, void *data, size_t n)
+{
+	if ((size_t)(c->end - c->p) < n) {
+		return (-1);
+	}
+
+	memcpy(data, c->p, n);
+	c->p += n;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Format one conversion from packed arguments
+ * @param [in] conv pointer to conversion
+ * @param [in,out] c pointer to cursor
+ * @param [out] b buffer for message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_fmt_render_conv(const struct ll_conv *conv, struct ll_cursor *c,
+	struct ll_buf *b) {
+	int64_t width = conv->width;
+	int64_t prec = conv->prec;
+	char spec[48];
+	size_t n;
+
+	if (conv->type == LL_ARG_NONE) {
+		return (ll_buf_append(b, "%", 1));
+	}
+
+	if ((width == -2 && ll_get_int(c, &width)) ||
+		(prec == -2 && ll_get_int(c, &prec))) {
+		return (-1);
+	}
+
+	/* build specification without arguments taken from list */
+	n = snprintf(spec, sizeof(spec), "%%%s", conv->flags);
+
+	/* width -1 taken from list means left justification */
+	if (conv->width != -1) {
+		n += snprintf(spec + n, sizeof(spec) - n, "%d", (int)width);
+	}
+
+	if (conv->type == LL_ARG_STR) {
+		uint64_t len;
+		const char *s = NULL;
+
+		if (ll_get_varint(c, &len) || len > (uint64_t)(c->end - c->p) + 1) {
+			return (-1);
+		}
+
+		/*
+		 * string was truncated by precision during packing, NULL is left
+		 * to libc with original precision, like immediate printing does
+		 */
+		if (len) {
+			s = (const char *)c->p;
+			prec = -- len;
+			c->p += len;
+		}
+
+		if (prec >= 0) {
+			n += snprintf(spec + n, sizeof(spec) - n, ".%d", (int)prec);
+		}
+
+		snprintf(spec + n, sizeof(spec) - n, "s");
+
+		return (ll_buf_printf(b, spec, s));
+	}
+
+	if (prec >= 0) {
+		n += snprintf(spec + n, sizeof(spec) - n, ".%d", (int)prec);
+	}
+
+	snprintf(spec + n, sizeof(spec) - n, "%s%c", conv->length, conv->conv);
+
+	switch (conv->type) {
+		case LL_ARG_DOUBLE: {
+			double v;
+
+			if (ll_get(c, &v, sizeof(v))) {
+				return (-1);
+			}
+
+			return (ll_buf_printf(b, spec, v));
+		}
+
+		case LL_ARG_LDOUBLE: {
+			long double v;
+
+			if (ll_get(c, &v, sizeof(v))) {
+				return (-1);
+			}
+
+			return (ll_buf_printf(b, spec, v));
+		}
+
+		case LL_ARG_PTR: {
+			uint64_t v;
+
+			if (ll_get_varint(c, &v)) {
+				return (-1);
+			}
+
+			return (ll_buf_printf(b, spec, (void *)(uintptr_t)v));
+		}
+
+		default:
+			break;
+	}
+
+	int64_t v;
+
+	if (ll_get_int(c, &v)) {
+		return (-1);
+	}
+
+	switch (conv->type) {
+		case LL_ARG_INT:
+			return (ll_buf_printf(b, spec, (int)v));
+
+		case LL_ARG_LONG:
+			return (ll_buf_printf(b, spec, (long)v));
+
+		case LL_ARG_LLONG:
+			return (ll_buf_printf(b, spec, (long long)v));
+
+		case LL_ARG_INTMAX:
+			return (ll_buf_printf(b, spec, (intmax_t)v));
+
+		case LL_ARG_SIZE:
+			return (ll_buf_printf(b, spec, (size_t)v));
+
+		case LL_ARG_PTRDIFF:
+			return (ll_buf_printf(b, spec, (ptrdiff_t)v));
+
+		default:
+			return (-1);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_fmt_render(const struct ll_fmt *fmt, const void *src, size_t len,
+	struct ll_buf *b) {
+	assert(fmt);
+	assert(b);
+
+	/* arguments of such format can't be packed, file is corrupted */
+	if (fmt->eager) {
+		return (-1);
+	}
+
+	struct ll_cursor c = {
+		(unsigned char *)src,
+		(unsigned char *)src + len
+	};
+
+	for (size_t i = 0; i < fmt->n; ++ i) {
+		const struct ll_conv *conv = &fmt->conv[i];
+
+		if (ll_buf_append(b, conv->lit, conv->lit_len) ||
+			ll_fmt_render_conv(conv, &c, b)) {
+			return (-1);
+		}
+	}
+
+	/* keep message null-terminated */
+	if (ll_buf_append(b, fmt->tail, strlen(fmt->tail) + 1)) {
+		return (-1);
+	}
+
+	-- b->len;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Size of integer argument
+ * @param [in] type type of argument
+ * @return size of integer, zero for other types
+ */
+static size_t ll_arg_size(enum ll_arg type)
+{
+	switch (type) {
+		case LL_ARG_INT:
+			return (sizeof(int));
+
+		case LL_ARG_LONG:
+			return (sizeof(long));
+
+		case LL_ARG_LLONG:
+			return (sizeof(long long));
+
+		case LL_ARG_INTMAX:
+			return (sizeof(intmax_t));
+
+		case LL_ARG_SIZE:
+			return (sizeof(size_t));
+
+		case LL_ARG_PTRDIFF:
+			return (sizeof(ptrdiff_t));
+
+		default:
+			return (0);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check next argument of call site
+ * @param [in] args types of arguments
+ * @param [in,out] i index of next argument
+ * @param [in] want type taken by conversion
+ * @return zero, if argument has compatible type
+ * @retval -1 mismatch found
+ */
+static int ll_fmt_check_arg(const struct ll_args *args, size_t *i,
+	enum ll_arg want) {
+	if (*i >= args->n) {
+		return (-1);
+	}
+
+	enum ll_arg type = args->type[(*i) ++];
+
+	/* integers of the same size are taken from va_list in the same way */
+	if (want == type || (ll_arg_size(want) &&
+		ll_arg_size(want) == ll_arg_size(type)) ||
+		(want == LL_ARG_PTR && type == LL_ARG_STR)) {
+		return (0);
+	}
+
+	return (-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_fmt_check(const struct ll_fmt *fmt, const struct ll_args *args)
+{
+	assert(fmt);
+	assert(args);
+
+	/* first argument is format string itself */
+	size_t i = 1;
+
+	for (size_t n = 0; n < fmt->n; ++ n) {
+		const struct ll_conv *conv = &fmt->conv[n];
+
+		if ((conv->width == -2 && ll_fmt_check_arg(args, &i, LL_ARG_INT)) ||
+			(conv->prec == -2 && ll_fmt_check_arg(args, &i, LL_ARG_INT)) ||
+			(conv->type != LL_ARG_NONE &&
+			ll_fmt_check_arg(args, &i, conv->type))) {
+			return (-1);
+		}
+	}
+
+	return (i == args->n ? 0 : -1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_fmt_free(struct ll_fmt *fmt)
+{
+	free(fmt);
+}
@@ -0,0 +1,152 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_FORMAT_H
+#define __LIBLOG_FORMAT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "liblog/types.h"
+#include "buf.h"
+
+/** maximal size of encoded variable length number */
+#define LL_VARINT_MAX 10
+
+/** Conversion specification of format string */
+struct ll_conv {
+	/** literal text before conversion */
+	const char *lit;
+
+	/** length of literal text */
+	size_t lit_len;
+
+	/** type of argument */
+	enum ll_arg type;
+
+	/** width, -1 if not set, -2 if taken from argument */
+	int width;
+
+	/** precision, -1 if not set, -2 if taken from argument */
+	int prec;
+
+	/** conversion character, for example 'd' */
+	char conv;
+
+	/** flags, null-terminated */
+	char flags[8];
+
+	/** length modifier, null-terminated */
+	char length[3];
+};
+
+/** Parsed format string */
+struct ll_fmt {
+	/** format string */
+	const char *format;
+
+	/** non-zero, if format can't be deferred */
+	int eager;
+
+	/** literal text after last conversion */
+	const char *tail;
+
+	/** number of conversions */
+	size_t n;
+
+	/** conversions */
+	struct ll_conv conv[];
+};
+
+/**
+ * @brief Encode variable length number (LEB128)
+ * @param [out] p buffer, at least @ref LL_VARINT_MAX bytes
+ * @param [in] v number
+ * @return size of encoded number
+ */
+size_t ll_varint_enc(unsigned char *p, uint64_t v);
+
+/**
+ * @brief Decode variable length number (LEB128)
+ * @param [in,out] p pointer to buffer, moved after number
+ * @param [in] end end of buffer
+ * @param [out] v number
+ * @return on success, zero is returned
+ * @retval -1 buffer is corrupted
+ */
+int ll_varint_dec(const unsigned char **p, const unsigned char *end,
+	uint64_t *v
+);
+
+/**
+ * @brief Parse format string
+ * @param [in] format format string, should be valid while result is used
+ * @return pointer to parsed format string
+ * @retval NULL error occurred
+ *
+ * If format string uses conversions which can't be deferred (like "%n"),
+ * eager flag of result is set.
+ */
+struct ll_fmt *ll_fmt_parse(const char *format);
+
+/**
+ * @brief Pack arguments of format string
+ * @param [in] fmt pointer to parsed format string
+ * @param [out] dst buffer for packed arguments
+ * @param [in] size size of buffer
+ * @param [in] args list of arguments
+ * @return size of packed arguments
+ * @retval -1 buffer is too small
+ *
+ * Integers are packed as variable length numbers, strings are copied.
+ */
+int ll_fmt_pack(const struct ll_fmt *fmt, void *dst, size_t size,
+	va_list args
+);
+
+/**
+ * @brief Format message from packed arguments
+ * @param [in] fmt pointer to parsed format string
+ * @param [in] src packed arguments
+ * @param [in] len size of packed arguments
+ * @param [out] b buffer for message, data will be null-terminated
+ * @return on success, zero is returned
+ * @retval -1 error occurred, or format can't have packed arguments
+ */
+int ll_fmt_render(const struct ll_fmt *fmt, const void *src, size_t len,
+	struct ll_buf *b
+);
+
+/**
+ * @brief Check parsed format string against types of arguments
+ * @param [in] fmt pointer to parsed format string
+ * @param [in] args types of arguments, including format string
+ * @return zero, if every conversion takes argument of compatible type
+ * @retval -1 mismatch found
+ */
+int ll_fmt_check(const struct ll_fmt *fmt, const struct ll_args *args);
+
+/**
+ * @brief Free parsed format string
+ * @param [in] fmt pointer to parsed format string (can be NULL)
+ */
+void ll_fmt_free(struct ll_fmt *fmt);
+
+#endif /* __LIBLOG_FORMAT_H */
@@ -0,0 +1,601 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "escape.h"
+#include "format.h"
+#include "kv.h"
+#include "printf.h"
+
+/*------------------------------------------------------------------------*/
+
+/** number of encodings cached per thread */
+#define LL_KV_ENC_MAX 4
+
+/** maximum length of journal field name */
+#define LL_KV_JOURNAL_KEY 64
+
+/** key of encoding buffers of thread, freed when thread exits */
+static pthread_key_t ll_kv_key;
+
+/** initialization of @ref ll_kv_key */
+static pthread_once_t ll_kv_once = PTHREAD_ONCE_INIT;
+
+/** encoding buffers of current thread */
+static __thread struct ll_buf *ll_kv_buf;
+
+/** bit mask of encodings made for current message */
+static __thread unsigned ll_kv_valid;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return size of field in binary encoding
+ * @param [in] f pointer to field
+ * @return size of encoded field
+ */
+static size_t ll_kv_bin_size(const struct ll_field *f)
+{
+	unsigned char tmp[LL_VARINT_MAX];
+	size_t n = ll_varint_enc(tmp, f->key_len) + f->key_len + 1;
+
+	switch (f->type) {
+		case LL_FIELD_INT:
+			return (n + ll_varint_enc(tmp, ((uint64_t)f->v.i << 1) ^
+				(uint64_t)(f->v.i >> 63)));
+
+		case LL_FIELD_UINT:
+			return (n + ll_varint_enc(tmp, f->v.u));
+
+		case LL_FIELD_DOUBLE:
+			return (n + 8);
+
+		case LL_FIELD_BOOL:
+			return (n + 1);
+
+		case LL_FIELD_STR:
+			return (n + ll_varint_enc(tmp, f->len) + f->len);
+	}
+
+	return (n);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Encode field to binary form
+ * @param [out] p buffer, at least ll_kv_bin_size() bytes
+ * @param [in] f pointer to field
+ * @return size of encoded field
+ */
+static size_t ll_kv_bin_put(unsigned char *p, const struct ll_field *f)
+{
+	unsigned char *start = p;
+	uint64_t u;
+
+	p += ll_varint_enc(p, f->key_len);
+	memcpy(p, f->key, f->key_len);
+	p += f->key_len;
+	*p ++ = f->type;
+
+	switch (f->type) {
+		case LL_FIELD_INT:
+			p += ll_varint_enc(p, ((uint64_t)f->v.i << 1) ^
+				(uint64_t)(f->v.i >> 63));
+			break;
+
+		case LL_FIELD_UINT:
+			p += ll_varint_enc(p, f->v.u);
+			break;
+
+		case LL_FIELD_DOUBLE:
+			memcpy(&u, &f->v.d, sizeof(u));
+
+			for (int i = 0; i < 8; ++ i, u >>= 8) {
+				*p ++ = u;
+			}
+			break;
+
+		case LL_FIELD_BOOL:
+			*p ++ = !!f->v.b;
+			break;
+
+		case LL_FIELD_STR:
+			p += ll_varint_enc(p, f->len);
+			memcpy(p, f->v.s, f->len);
+			p += f->len;
+			break;
+	}
+
+	return (p - start);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Decode field from binary form
+ * @param [in,out] p encoded field, moved to next one
+ * @param [in] end end of encoded fields
+ * @param [out] f field
+ * @return on success, zero is returned
+ * @retval -1 encoding is corrupted
+ */
+static int ll_kv_bin_get(const unsigned char **p, const unsigned char *end,
+	struct ll_field *f) {
+	uint64_t v;
+
+	if (ll_varint_dec(p, end, &v) || v >= (uint64_t)(end - *p)) {
+		return (-1);
+	}
+
+	f->key = (const char *)*p;
+	f->key_len = v;
+	*p += v;
+	f->type = *(*p) ++;
+	f->len = 0;
+
+	switch (f->type) {
+		case LL_FIELD_INT:
+			if (ll_varint_dec(p, end, &v)) {
+				return (-1);
+			}
+
+			f->v.i = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+			break;
+
+		case LL_FIELD_UINT:
+			return (ll_varint_dec(p, end, &f->v.u));
+
+		case LL_FIELD_DOUBLE:
+			if (end - *p < 8) {
+				return (-1);
+			}
+
+			v = 0;
+
+			for (int i = 7; i >= 0; -- i) {
+				v = (v << 8) | (*p)[i];
+			}
+
+			memcpy(&f->v.d, &v, sizeof(v));
+			*p += 8;
+			break;
+
+		case LL_FIELD_BOOL:
+			if (*p == end) {
+				return (-1);
+			}
+
+			f->v.b = *(*p) ++;
+			break;
+
+		case LL_FIELD_STR:
+			if (ll_varint_dec(p, end, &v) || v > (uint64_t)(end - *p)) {
+				return (-1);
+			}
+
+			f->v.s = (const char *)*p;
+			f->len = v;
+			*p += v;
+			break;
+
+		default:
+			return (-1);
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_kv_next(const struct ll_kv *kv, size_t *pos, struct ll_field *f)
+{
+	assert(kv);
+	assert(pos);
+	assert(f);
+
+	if (!kv->bin) {
+		if (*pos >= kv->n) {
+			return (0);
+		}
+
+		*f = kv->field[(*pos) ++];
+
+		return (1);
+	}
+
+	if (*pos >= kv->len) {
+		return (0);
+	}
+
+	const unsigned char *p = kv->bin + *pos;
+
+	if (ll_kv_bin_get(&p, kv->bin + kv->len, f)) {
+		return (-1);
+	}
+
+	*pos = p - kv->bin;
+
+	return (1);
+}
+
+/*------------------------------------------------------------------------*/
+
+size_t ll_kv_pack(const struct ll_kv *kv, unsigned char *p, size_t max)
+{
+	assert(kv);
+
+	/* already encoded, keep whole fields only */
+	if (kv->bin) {
+		size_t pos = 0, end = 0;
+		struct ll_field f;
+
+		while (ll_kv_next(kv, &pos, &f) > 0 && pos <= max) {
+			end = pos;
+		}
+
+		memcpy(p, kv->bin, end);
+
+		return (end);
+	}
+
+	size_t len = 0;
+
+	for (size_t i = 0; i < kv->n; ++ i) {
+		if (ll_kv_bin_size(&kv->field[i]) > max - len) {
+			continue;
+		}
+
+		len += ll_kv_bin_put(p + len, &kv->field[i]);
+	}
+
+	return (len);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, if logfmt value should be quoted
+ * @param [in] s string
+ * @param [in] len length of string
+ * @return non-zero, if string is empty or contains special characters
+ */
+static int ll_kv_logfmt_quoted(const char *s, size_t len)
+{
+	if (!len) {
+		return (1);
+	}
+
+	for (const char *end = s + len; s < end; ++ s) {
+		unsigned char c = *s;
+
+		if (c <= ' ' || c == '=' || c == '"' || c == '\\' || c == 0x7f) {
+			return (1);
+		}
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Append floating point number to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] enc encoding of fields
+ * @param [in] d number
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Number is written by the least precision, which keeps its value.
+ */
+static int ll_kv_double(struct ll_buf *b, enum ll_kv_enc enc, double d)
+{
+	char tmp[32];
+	int n;
+
+	/* JSON doesn't have NaN and infinity */
+	if (enc == LL_KV_JSON && !isfinite(d)) {
+		return (ll_buf_append(b, "null", 4));
+	}
+
+	/* 17 digits are always enough */
+	for (int prec = 15;; ++ prec) {
+		n = snprintf(tmp, sizeof(tmp), "%.*g", prec, d);
+
+		if (prec == 17 || !isfinite(d) || strtod(tmp, NULL) == d) {
+			break;
+		}
+	}
+
+	return (ll_buf_append(b, tmp, n));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Append value of field to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] enc encoding of fields, except of @ref LL_KV_BINARY
+ * @param [in] f pointer to field
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_kv_value(struct ll_buf *b, enum ll_kv_enc enc,
+	const struct ll_field *f) {
+	switch (f->type) {
+		case LL_FIELD_INT:
+			return (ll_format_dec(b, f->v.i < 0 ? -(uint64_t)f->v.i :
+				(uint64_t)f->v.i, f->v.i < 0));
+
+		case LL_FIELD_UINT:
+			return (ll_format_dec(b, f->v.u, 0));
+
+		case LL_FIELD_DOUBLE:
+			return (ll_kv_double(b, enc, f->v.d));
+
+		case LL_FIELD_BOOL:
+			return (f->v.b ? ll_buf_append(b, "true", 4) :
+				ll_buf_append(b, "false", 5));
+
+		case LL_FIELD_STR:
+			/* journal fields are binary safe */
+			if (enc == LL_KV_JOURNAL || (enc == LL_KV_LOGFMT &&
+				!ll_kv_logfmt_quoted(f->v.s, f->len))) {
+				return (ll_buf_append(b, f->v.s, f->len));
+			}
+
+			/* quoted logfmt value is escaped as JSON string */
+			return (ll_escape_json(b, f->v.s, f->len));
+	}
+
+	return (-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Append text encoding of field to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] enc encoding of fields, @ref LL_KV_JSON or @ref LL_KV_LOGFMT
+ * @param [in] f pointer to field
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_kv_text(struct ll_buf *b, enum ll_kv_enc enc,
+	const struct ll_field *f) {
+	int json = enc == LL_KV_JSON;
+
+	if (json ? ll_escape_json(b, f->key, f->key_len) :
+		ll_buf_append(b, f->key, f->key_len)) {
+		return (-1);
+	}
+
+	if (ll_buf_append(b, json ? ":" : "=", 1)) {
+		return (-1);
+	}
+
+	return (ll_kv_value(b, enc, f));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Append field of native journal protocol to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] f pointer to field
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Key is upper-cased, other characters than letters, digits and
+ * underscore are replaced by underscore. Key can't start by underscore
+ * or digit, so such key is prefixed by "F". Value is written in binary
+ * safe form: key, newline, 64-bit little-endian size, value, newline.
+ */
+static int ll_kv_journal(struct ll_buf *b, const struct ll_field *f)
+{
+	/* journal limits length of field name */
+	size_t n = f->key_len < LL_KV_JOURNAL_KEY ? f->key_len :
+		LL_KV_JOURNAL_KEY;
+
+	if (ll_buf_reserve(b, n + 10)) {
+		return (-1);
+	}
+
+	char *p = b->data + b->len;
+
+	if (!n || f->key[0] == '_' || (f->key[0] >= '0' && f->key[0] <= '9')) {
+		*p ++ = 'F';
+		n -= n == LL_KV_JOURNAL_KEY;
+	}
+
+	for (size_t i = 0; i < n; ++ i) {
+		char c = f->key[i];
+
+		if (c >= 'a' && c <= 'z') {
+			c -= 'a' - 'A';
+		} else if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) {
+			c = '_';
+		}
+
+		*p ++ = c;
+	}
+
+	*p ++ = '\n';
+	b->len = p - b->data + 8;
+
+	size_t off = b->len;
+
+	if (ll_kv_value(b, LL_KV_JOURNAL, f) || ll_buf_append(b, "\n", 1)) {
+		return (-1);
+	}
+
+	/* size of value is known after it's written */
+	uint64_t len = b->len - off - 1;
+
+	for (int i = 0; i < 8; ++ i, len >>= 8) {
+		b->data[off - 8 + i] = len;
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_kv_encode(struct ll_buf *b, enum ll_kv_enc enc, const struct ll_kv *kv)
+{
+	assert(b);
+	assert(kv);
+
+	struct ll_field f;
+	size_t pos = 0;
+	int rc;
+
+	if (enc == LL_KV_BINARY) {
+		if (kv->bin) {
+			return (ll_buf_append(b, kv->bin, kv->len));
+		}
+
+		for (size_t i = 0; i < kv->n; ++ i) {
+			size_t n = ll_kv_bin_size(&kv->field[i]);
+
+			if (ll_buf_reserve(b, n)) {
+				return (-1);
+			}
+
+			b->len += ll_kv_bin_put((unsigned char *)b->data + b->len,
+				&kv->field[i]);
+		}
+
+		return (0);
+	}
+
+	for (size_t i = 0; (rc = ll_kv_next(kv, &pos, &f)) > 0; ++ i) {
+		if (enc == LL_KV_JOURNAL) {
+			if (ll_kv_journal(b, &f)) {
+				return (-1);
+			}
+
+			continue;
+		}
+
+		if ((i && ll_buf_append(b, enc == LL_KV_JSON ? "," : " ", 1)) ||
+			ll_kv_text(b, enc, &f)) {
+			return (-1);
+		}
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free encoding buffers of exited thread
+ * @param [in] ptr pointer to buffers
+ */
+static void ll_kv_free(void *ptr)
+{
+	struct ll_buf *b = ptr;
+
+	for (int i = 0; i < LL_KV_ENC_MAX; ++ i) {
+		ll_buf_free(&b[i]);
+	}
+
+	free(ptr);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** Initialize key of encoding buffers once per process */
+static void ll_kv_init(void)
+{
+	pthread_key_create(&ll_kv_key, ll_kv_free);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_kv_get(const struct ll_kv *kv, enum ll_kv_enc enc, const char **data,
+	size_t *len) {
+	assert(kv);
+	assert(data);
+	assert(len);
+
+	/* binary fields are passed as is */
+	if (enc == LL_KV_BINARY && kv->bin) {
+		*data = (const char *)kv->bin;
+		*len = kv->len;
+
+		return (0);
+	}
+
+	if ((unsigned)enc >= LL_KV_ENC_MAX) {
+		return (-1);
+	}
+
+	struct ll_buf *b = ll_kv_buf;
+
+	if (!b) {
+		pthread_once(&ll_kv_once, ll_kv_init);
+
+		if (!(b = calloc(LL_KV_ENC_MAX, sizeof(*b)))) {
+			return (-1);
+		}
+
+		if (pthread_setspecific(ll_kv_key, b)) {
+			free(b);
+
+			return (-1);
+		}
+
+		ll_kv_buf = b;
+	}
+
+	b += enc;
+
+	if (!(ll_kv_valid & (1u << enc))) {
+		b->len = 0;
+
+		if (ll_kv_encode(b, enc, kv)) {
+			return (-1);
+		}
+
+		ll_kv_valid |= 1u << enc;
+	}
+
+	/* buffer isn't allocated, if there are no fields */
+	*data = b->data ? b->data : "";
+	*len = b->len;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_kv_reset(void)
+{
+	ll_kv_valid = 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_KV_H
+#define __LIBLOG_KV_H
+
+#include <stddef.h>
+#include <liblog/types.h>
+
+#include "buf.h"
+
+/**
+ * @brief Fields of structured message
+ *
+ * Fields are given either by array of caller, or by binary encoding
+ * (@ref LL_KV_BINARY) of asynchronous record or binary log file. Every
+ * binary field is:
+ *
+ * @li variable length size of key and key itself
+ * @li one byte of @ref ll_field_type
+ * @li value: zigzag variable length number for @ref LL_FIELD_INT,
+ * variable length number for @ref LL_FIELD_UINT, 8 bytes little-endian
+ * for @ref LL_FIELD_DOUBLE, one byte for @ref LL_FIELD_BOOL,
+ * variable length size and data for @ref LL_FIELD_STR
+ */
+struct ll_kv {
+	/** array of fields, NULL if fields are encoded */
+	const struct ll_field *field;
+
+	/** number of fields in array */
+	size_t n;
+
+	/** binary encoded fields */
+	const unsigned char *bin;
+
+	/** size of binary encoded fields */
+	size_t len;
+};
+
+/**
+ * @brief Take next field
+ * @param [in] kv pointer to fields
+ * @param [in,out] pos position of field, zero for first one
+ * @param [out] f field, strings of decoded field aren't null-terminated
+ * @return one, if field is taken
+ * @retval 0 no more fields
+ * @retval -1 binary encoding is corrupted
+ */
+int ll_kv_next(const struct ll_kv *kv, size_t *pos, struct ll_field *f);
+
+/**
+ * @brief Encode fields to binary form
+ * @param [in] kv pointer to fields
+ * @param [out] p buffer
+ * @param [in] max size of buffer
+ * @return size of encoded fields
+ *
+ * Fields, which don't fit into buffer, are dropped.
+ */
+size_t ll_kv_pack(const struct ll_kv *kv, unsigned char *p, size_t max);
+
+/**
+ * @brief Append encoded fields to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] enc encoding of fields
+ * @param [in] kv pointer to fields
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Data of buffer is not null-terminated.
+ */
+int ll_kv_encode(struct ll_buf *b, enum ll_kv_enc enc,
+	const struct ll_kv *kv
+);
+
+/**
+ * @brief Return fields of current message in given encoding
+ * @param [in] kv pointer to fields
+ * @param [in] enc encoding of fields
+ * @param [out] data encoded fields
+ * @param [out] len size of encoded fields
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Every encoding is made once per message and kept by current thread,
+ * until ll_kv_reset() is called.
+ */
+int ll_kv_get(const struct ll_kv *kv, enum ll_kv_enc enc, const char **data,
+	size_t *len
+);
+
+/** Forget encodings of previous message of current thread */
+void ll_kv_reset(void);
+
+#endif /* __LIBLOG_KV_H */
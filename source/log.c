@@ -18,37 +18,253 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
 #include <libtools/tools.h>
 
 #include "liblog/log.h"
+#include "async.h"
+#include "kv.h"
 #include "logger.h"
 #include "namespace.h"
+#include "rate.h"
+#include "sample.h"
+#include "stats.h"
 
 /*------------------------------------------------------------------------*/
 
-int ll_printf(const char *name, enum ll_level level, const char *format, ...)
+/**
+ * @brief Pass message to logger of namespace, maybe asynchronously
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] fmt parsed format string for deferred formatting (can be NULL)
+ * @param [in] format format string of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_dispatch(struct ll_namespace *ns, enum ll_level level,
+	const struct ll_fmt *fmt, const char *format, va_list args) {
+	/* loggers following namespace get what passes its level now */
+	enum ll_level base = __atomic_load_n(&ns->base, __ATOMIC_RELAXED);
+
+	if (__atomic_load_n(&ll_async_running, __ATOMIC_RELAXED)) {
+		if (level != LL_LEVEL_EMERG) {
+			int rc = ll_async_pr(ns, level, base, fmt, format, args);
+
+			if (rc && __atomic_load_n(&ll_stats_on, __ATOMIC_RELAXED)) {
+				ll_stats_add(ns, level, LL_STAT_DROPPED, 1);
+			}
+
+			return (rc);
+		}
+
+		/* program will be aborted, so write queued messages first */
+		ll_async_sync();
+	}
+
+	return (ll_ns_pr(ns, level, base, format, args));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass message of liblog itself to logger of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] format format string of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_dispatch_printf(struct ll_namespace *ns, enum ll_level level,
+	const char *format, ...) {
+	va_list ap;
+
+	va_start(ap, format);
+	int rc = ll_dispatch(ns, level, NULL, format, ap);
+	va_end(ap);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Decide, if message passes filters of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @return non-zero, if message should be passed to loggers
+ *
+ * Message is checked by sampling, logging level and rate limit of
+ * namespace, and accounted by statistics.
+ */
+static int ll_pass(struct ll_namespace *ns, enum ll_level level)
 {
-	assert(name);
+	int stats = __atomic_load_n(&ll_stats_on, __ATOMIC_RELAXED);
+	uint64_t sample = 0;
+
+	if (level >= __atomic_load_n(&ns->sample_level, __ATOMIC_RELAXED)) {
+		sample = __atomic_load_n(&ns->sample, __ATOMIC_RELAXED);
+	}
+
+	/* skip message, if it have low level or it is not sampled? */
+	if (!ll_sample_keep(sample) ||
+		level > __atomic_load_n(&ns->level, __ATOMIC_RELAXED)) {
+		if (stats) {
+			ll_stats_add(ns, level, LL_STAT_FILTERED, 1);
+		}
+
+		return (0);
+	}
+
+	uint64_t report;
+	int pass = ll_rate_take(&ns->rate, &report);
+
+	if (report) {
+		ll_dispatch_printf(ns, level, "suppressed %" PRIu64 " messages",
+			report);
+	}
+
+	/* storm of messages is cut before they are formatted */
+	if (!pass) {
+		if (stats) {
+			ll_stats_add(ns, level, LL_STAT_DROPPED, 1);
+		}
+
+		return (0);
+	}
+
+	if (stats) {
+		ll_stats_add(ns, level, LL_STAT_EMITTED, 1);
+	}
+
+	return (1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Log message to namespace
+ * @param [in] ns pointer to namespace (can be NULL)
+ * @param [in] level logging level of message
+ * @param [in] fmt parsed format string for deferred formatting (can be NULL)
+ * @param [in] format format string of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_vprintf_ns(struct ll_namespace *ns, enum ll_level level,
+	const struct ll_fmt *fmt, const char *format, va_list args) {
 	assert(format);
 
-	struct ll_namespace *ns = ll_ns_lookup(name);
+	/* out of memory? */
+	if (!ns) {
+		return (-1);
+	}
+
+	if (!ll_pass(ns, level)) {
+		return (0);
+	}
+
+	return (ll_dispatch(ns, level, fmt, format, args));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Log structured message to namespace
+ * @param [in] ns pointer to namespace (can be NULL)
+ * @param [in] level logging level of message
+ * @param [in] msg message
+ * @param [in] fields fields of message
+ * @param [in] n number of fields
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_log_kv_ns(struct ll_namespace *ns, enum ll_level level,
+	const char *msg, const struct ll_field *fields, size_t n) {
+	assert(msg);
+	assert(fields || !n);
 
 	/* out of memory? */
 	if (!ns) {
 		return (-1);
 	}
 
-	/* skip message, if it have low level? */
-	if (level > ns->level) {
+	if (!ll_pass(ns, level)) {
 		return (0);
 	}
 
-	assert(ns->pr_cb);
+	const struct ll_kv kv = { fields, n, NULL, 0 };
+	enum ll_level base = __atomic_load_n(&ns->base, __ATOMIC_RELAXED);
+
+	if (__atomic_load_n(&ll_async_running, __ATOMIC_RELAXED)) {
+		if (level != LL_LEVEL_EMERG) {
+			int rc = ll_async_kv(ns, level, base, msg, &kv);
+
+			if (rc && __atomic_load_n(&ll_stats_on, __ATOMIC_RELAXED)) {
+				ll_stats_add(ns, level, LL_STAT_DROPPED, 1);
+			}
+
+			return (rc);
+		}
+
+		/* program will be aborted, so write queued messages first */
+		ll_async_sync();
+	}
+
+	return (ll_ns_kv(ns, level, base, msg, &kv));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_printf(const char *name, enum ll_level level, const char *format, ...)
+{
+	assert(name);
+	assert(format);
+
+	va_list ap;
+
+	va_start(ap, format);
+	int rc = ll_vprintf_ns(ll_ns_lookup(name), level, NULL, format, ap);
+	va_end(ap);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_printf_ns(struct ll_namespace *ns, enum ll_level level,
+	const char *format, ...) {
+	assert(format);
+
+	va_list ap;
+
+	va_start(ap, format);
+	int rc = ll_vprintf_ns(ns, level, NULL, format, ap);
+	va_end(ap);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_printf_site(struct ll_site *site, enum ll_level level,
+	const char *format, ...) {
+	assert(site);
+	assert(format);
+
+	const struct ll_fmt *fmt = NULL;
+
+	/* format string of call site is literal, so it can be parsed once */
+	if (site->ns && __atomic_load_n(&ll_async_running, __ATOMIC_RELAXED) &&
+		__atomic_load_n(&ll_async_defer, __ATOMIC_RELAXED)) {
+		fmt = ll_site_fmt(site, format);
+	}
 
 	va_list ap;
 
 	va_start(ap, format);
-	int rc = ns->pr_cb(ns->priv, name, level, format, ap);
+	int rc = ll_vprintf_ns(site->ns, level, fmt, format, ap);
 	va_end(ap);
 
 	return (rc);
@@ -56,6 +272,55 @@ int ll_printf(const char *name, enum ll_level level, const char *format, ...)
 
 /*------------------------------------------------------------------------*/
 
+int ll_log_kv(const char *name, enum ll_level level, const char *msg,
+	const struct ll_field *fields, size_t n) {
+	assert(name);
+
+	return (ll_log_kv_ns(ll_ns_lookup(name), level, msg, fields, n));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_log_kv_site(struct ll_site *site, enum ll_level level,
+	const char *msg, const struct ll_field *fields, size_t n) {
+	assert(site);
+
+	return (ll_log_kv_ns(site->ns, level, msg, fields, n));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_setup(const char *name, enum ll_level level, const char *uri)
+{
+	assert(name);
+
+	struct ll_namespace *ns = ll_ns_lookup(name);
+	struct ll_ns_opts opts;
+	struct ll_sinks *sinks;
+
+	/* out of memory? */
+	if (!ns) {
+		return (-1);
+	}
+
+	ll_ns_opts_init(&opts);
+
+	/* empty list of URIs gives default logger */
+	if (!(sinks = ll_logger_open_all(uri ? uri : "", ns->name, level,
+		&opts))) {
+		return (-1);
+	}
+
+	/* writers never wait for this, old loggers are closed after them */
+	ll_ns_opts_set(ns, &opts);
+	ll_ns_sinks_set(ns, sinks);
+	ll_ns_level_set(ns, level);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
 enum ll_level ll_level_set(const char *name, enum ll_level level)
 {
 	assert(name);
@@ -69,8 +334,7 @@ enum ll_level ll_level_set(const char *name, enum ll_level level)
 	}
 
 	/* update logging level and return old value */
-	ret = ns->level;
-	ns->level = level;
+	ret = ll_ns_level_set(ns, level);
 
 	return (ret);
 }
@@ -99,8 +363,40 @@ const char *ll_level_str(enum ll_level level)
 
 /*------------------------------------------------------------------------*/
 
+int ll_flush(const char *name)
+{
+	assert(name);
+
+	struct ll_namespace *ns = ll_ns_lookup(name);
+
+	/* out of memory? */
+	if (!ns) {
+		return (-1);
+	}
+
+	if (__atomic_load_n(&ll_async_running, __ATOMIC_RELAXED)) {
+		ll_async_sync();
+	}
+
+	return (ll_ns_flush(ns));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_flush_all(void)
+{
+	if (__atomic_load_n(&ll_async_running, __ATOMIC_RELAXED)) {
+		ll_async_sync();
+	}
+
+	return (ll_ns_flush_all());
+}
+
+/*------------------------------------------------------------------------*/
+
 void ll_cleanup(void)
 {
+	ll_async_stop();
 	ll_logger_free();
 	ll_ns_free();
 }
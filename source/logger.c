@@ -21,6 +21,8 @@
 #include <string.h>
 
 #include "logger.h"
+#include "query.h"
+#include "stderr.h"
 
 /*------------------------------------------------------------------------*/
 
@@ -35,9 +37,18 @@ struct logger {
 	/** @copydoc ll_pr_cb_t */
 	ll_pr_cb_t pr_cb;
 
+	/** @copydoc ll_flush_cb_t */
+	ll_flush_cb_t flush_cb;
+
 	/** @copydoc ll_close_cb_t */
 	ll_close_cb_t close_cb;
 
+	/** @copydoc ll_kv_cb_t */
+	ll_kv_cb_t kv_cb;
+
+	/** encoding of fields passed to @ref kv_cb */
+	enum ll_kv_enc kv_enc;
+
 	/** logger name */
 	char name[];
 };
@@ -72,7 +83,10 @@ int ll_logger_custom(const struct ll_logger *l)
 
 	i->open_cb = l->open_cb;
 	i->pr_cb = l->pr_cb;
+	i->flush_cb = l->flush_cb;
 	i->close_cb = l->close_cb;
+	i->kv_cb = l->kv_cb;
+	i->kv_enc = l->kv_enc;
 	strcpy(i->name, l->name);
 
 	list_add_head(&loggers, &i->list);
@@ -82,33 +96,141 @@ int ll_logger_custom(const struct ll_logger *l)
 
 /*------------------------------------------------------------------------*/
 
-int ll_logger_open(struct url *u, struct ll_namespace *ns)
-{
+struct ll_sink *ll_logger_open(struct url *u, const char *name,
+	enum ll_level level) {
 	assert(u);
-	assert(ns);
+	assert(name);
 
 	/* if scheme is not present in URI, abort */
 	if (!u->scheme) {
-		return (-1);
+		return (NULL);
 	}
 
 	struct logger *i;
 
 	list_foreach(&loggers, i, struct logger, list) {
 		if (!strcasecmp(i->name, u->scheme)) {
-			ns->pr_cb = i->pr_cb;
-			ns->close_cb = i->close_cb;
+			struct ll_sink *sink = calloc(1, sizeof(*sink));
+
+			if (!sink) {
+				return (NULL);
+			}
+
+			sink->pr_cb = i->pr_cb;
+			sink->flush_cb = i->flush_cb;
+			sink->close_cb = i->close_cb;
+			sink->kv_cb = i->kv_cb;
+			sink->kv_enc = i->kv_enc;
+			sink->level = LL_LEVEL_INVALID;
 
 			/* ignore, if logger does not have constructor */
-			if (!i->open_cb) {
-				return (0);
+			if (i->open_cb && i->open_cb(name, level, u, &sink->priv)) {
+				free(sink);
+
+				return (NULL);
 			}
 
-			return (i->open_cb(ns->name, ns->level, u, &ns->priv));
+			return (sink);
 		}
 	}
 
-	return (-1);
+	return (NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Open logger by one URI of list
+ * @param [in] uri URI, not terminated by NUL
+ * @param [in] len length of URI
+ * @param [in] name namespace name
+ * @param [in] level logging level of namespace
+ * @param [in,out] opts options of namespace
+ * @return pointer to opened logger, free it by ll_sink_free()
+ * @retval NULL error occurred
+ */
+static struct ll_sink *ll_logger_open_one(const char *uri, size_t len,
+	const char *name, enum ll_level level, struct ll_ns_opts *opts) {
+	enum ll_level own = LL_LEVEL_INVALID;
+	struct ll_sink *sink = NULL;
+	char s[len + 1];
+	struct url *u;
+
+	memcpy(s, uri, len);
+	s[len] = '\0';
+
+	if (!url_parse(s, &u)) {
+		return (NULL);
+	}
+
+	if (!ll_ns_opts_parse(u->query, opts) &&
+		!ll_query_level(u->query, "level", &own) &&
+		(sink = ll_logger_open(u, name, own < 0 ? level : own))) {
+		sink->level = own;
+	}
+
+	url_free(u);
+
+	return (sink);
+}
+
+/*------------------------------------------------------------------------*/
+
+struct ll_sinks *ll_logger_open_all(const char *uris, const char *name,
+	enum ll_level level, struct ll_ns_opts *opts) {
+	assert(uris);
+	assert(name);
+	assert(opts);
+
+	static const char space[] = " \t\n";
+	const char *p = uris + strspn(uris, space);
+	size_t n = 0;
+
+	/* count URIs */
+	for (const char *i = p; *i; i += strspn(i, space)) {
+		i += strcspn(i, space);
+		++ n;
+	}
+
+	struct ll_sinks *sinks = ll_sinks_new(n ? n : 1);
+
+	if (!sinks) {
+		return (NULL);
+	}
+
+	/* default logger */
+	if (!n) {
+		if (!(sinks->sink[sinks->n ++] = ll_stderr_sink())) {
+			ll_sinks_free(sinks);
+
+			return (NULL);
+		}
+
+		return (sinks);
+	}
+
+	while (*p) {
+		size_t len = strcspn(p, space);
+		struct ll_sink *sink = ll_logger_open_one(p, len, name, level,
+			opts);
+
+		if (!sink) {
+			ll_sinks_free(sinks);
+
+			return (NULL);
+		}
+
+		sinks->sink[sinks->n ++] = sink;
+
+		if (sink->level > sinks->level) {
+			sinks->level = sink->level;
+		}
+
+		p += len;
+		p += strspn(p, space);
+	}
+
+	return (sinks);
 }
 
 /*------------------------------------------------------------------------*/
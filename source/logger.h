@@ -25,13 +25,32 @@
 #include "namespace.h"
 
 /**
- * @brief Open and setup logger for specified namespace
+ * @brief Open logger for specified namespace
  * @param [in] u pointer to parsed URI
- * @param [in] ns pointer to namespace
- * @return on success, zero is returned
- * @retval -1 error occurred
+ * @param [in] name namespace name
+ * @param [in] level logging level of namespace
+ * @return pointer to opened logger, free it by ll_sink_free()
+ * @retval NULL error occurred
  */
-int ll_logger_open(struct url *u, struct ll_namespace *ns);
+struct ll_sink *ll_logger_open(struct url *u, const char *name,
+	enum ll_level level
+);
+
+/**
+ * @brief Open loggers for specified namespace
+ * @param [in] uris space-separated URIs, empty for stderr
+ * @param [in] name namespace name
+ * @param [in] level logging level of namespace
+ * @param [in,out] opts options of namespace, given by any URI
+ * @return pointer to opened loggers, free it by ll_sinks_free()
+ * @retval NULL error occurred
+ *
+ * Every URI can have option "level", then logger gets messages up to
+ * this level, independently of logging level of namespace.
+ */
+struct ll_sinks *ll_logger_open_all(const char *uris, const char *name,
+	enum ll_level level, struct ll_ns_opts *opts
+);
 
 /** Unregister loggers */
 void ll_logger_free(void);
@@ -0,0 +1,553 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libtools/tools.h>
+#include <libtools/url.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/binlog.h"
+#include "../binlog.h"
+#include "../buf.h"
+#include "../clock.h"
+#include "../format.h"
+
+/*------------------------------------------------------------------------*/
+
+/** initial number of slots in dictionary */
+#define BINLOG_DICT_SIZE 64
+
+/** Dictionary entry of string, written once per file */
+struct binlog_key {
+	/** pointer to original string */
+	const char *ptr;
+
+	/** copy of string, NULL if it wasn't written to file */
+	char *str;
+
+	/** parsed format string, NULL for namespaces */
+	struct ll_fmt *fmt;
+
+	/** id of string in file */
+	uint64_t id;
+};
+
+/** Dictionary of strings, keyed by their pointers */
+struct binlog_dict {
+	/** slots */
+	struct binlog_key *keys;
+
+	/** number of slots minus one */
+	size_t mask;
+
+	/** number of used slots */
+	size_t n;
+
+	/** next id of string */
+	uint64_t id;
+};
+
+/** Private data of binary logger */
+struct binlog {
+	/** serialize writing of records */
+	pthread_mutex_t lock;
+
+	/** log file */
+	FILE *f;
+
+	/** timestamp of previous record in nanoseconds */
+	uint64_t last;
+
+	/** dictionary of namespaces */
+	struct binlog_dict names;
+
+	/** dictionary of format strings */
+	struct binlog_dict formats;
+
+	/** buffer for record */
+	struct ll_buf rec;
+
+	/** buffer for formatted message */
+	struct ll_buf msg;
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Append variable length number to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] v number
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int binlog_varint(struct ll_buf *b, uint64_t v)
+{
+	unsigned char tmp[LL_VARINT_MAX];
+
+	return (ll_buf_append(b, tmp, ll_varint_enc(tmp, v)));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Look for string in dictionary, add it if not found
+ * @param [in] d pointer to dictionary
+ * @param [in] s string
+ * @param [out] added set to non-zero, if string was added
+ * @return pointer to dictionary entry
+ * @retval NULL error occurred
+ */
+static struct binlog_key *binlog_dict(struct binlog_dict *d, const char *s,
+	int *added) {
+	*added = 0;
+
+	/* keep load factor below 1/2 */
+	if ((d->n + 1) * 2 > d->mask + 1) {
+		size_t size = d->keys ? (d->mask + 1) * 2 : BINLOG_DICT_SIZE;
+		struct binlog_key *keys = calloc(size, sizeof(*keys));
+
+		if (!keys) {
+			return (NULL);
+		}
+
+		for (size_t i = 0; d->keys && i <= d->mask; ++ i) {
+			if (d->keys[i].ptr) {
+				size_t j = ((uintptr_t)d->keys[i].ptr >> 3) & (size - 1);
+
+				while (keys[j].ptr) {
+					j = (j + 1) & (size - 1);
+				}
+
+				keys[j] = d->keys[i];
+			}
+		}
+
+		free(d->keys);
+		d->keys = keys;
+		d->mask = size - 1;
+	}
+
+	size_t i = ((uintptr_t)s >> 3) & d->mask;
+
+	while (d->keys[i].ptr && d->keys[i].ptr != s) {
+		i = (i + 1) & d->mask;
+	}
+
+	struct binlog_key *k = &d->keys[i];
+
+	/* pointer matched, but buffer can be reused for other string */
+	if (k->ptr && k->str && !strcmp(k->str, s)) {
+		return (k);
+	}
+
+	char *str = strdup(s);
+
+	if (!str) {
+		return (NULL);
+	}
+
+	if (k->ptr) {
+		free(k->str);
+		ll_fmt_free(k->fmt);
+	} else {
+		++ d->n;
+	}
+
+	k->ptr = s;
+	k->str = str;
+	k->fmt = NULL;
+	k->id = d->id ++;
+	*added = 1;
+
+	return (k);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Forget string, which wasn't written to file
+ * @param [in] k pointer to dictionary entry
+ *
+ * Slot keeps pointer, so probing of other strings isn't broken,
+ * and string is added again by next lookup.
+ */
+static void binlog_dict_forget(struct binlog_key *k)
+{
+	free(k->str);
+	ll_fmt_free(k->fmt);
+	k->str = NULL;
+	k->fmt = NULL;
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free dictionary
+ * @param [in] d pointer to dictionary
+ */
+static void binlog_dict_free(struct binlog_dict *d)
+{
+	for (size_t i = 0; d->keys && i <= d->mask; ++ i) {
+		free(d->keys[i].str);
+		ll_fmt_free(d->keys[i].fmt);
+	}
+
+	free(d->keys);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write record to file
+ * @param [in] b pointer to binary logger
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int binlog_write(struct binlog *b)
+{
+	unsigned char tmp[LL_VARINT_MAX];
+	size_t n = ll_varint_enc(tmp, b->rec.len);
+
+	if (fwrite(tmp, n, 1, b->f) != 1 ||
+		fwrite(b->rec.data, b->rec.len, 1, b->f) != 1) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write dictionary record to file
+ * @param [in] b pointer to binary logger
+ * @param [in] type type of record
+ * @param [in] k pointer to dictionary entry
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int binlog_define(struct binlog *b, int type, const struct binlog_key *k)
+{
+	size_t len = strlen(k->str);
+
+	b->rec.len = 0;
+
+	if (binlog_varint(&b->rec, type) ||
+		binlog_varint(&b->rec, k->id) ||
+		binlog_varint(&b->rec, len) ||
+		ll_buf_append(&b->rec, k->str, len)) {
+		return (-1);
+	}
+
+	return (binlog_write(b));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Start record of message
+ * @param [in] b pointer to binary logger
+ * @param [in] type type of record
+ * @param [in] now timestamp of message
+ * @param [in] ns namespace of message
+ * @param [in] level logging level of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int binlog_head(struct binlog *b, int type, uint64_t now,
+	const struct binlog_key *ns, enum ll_level level) {
+	int64_t delta = now - b->last;
+
+	b->rec.len = 0;
+
+	if (binlog_varint(&b->rec, type) ||
+		binlog_varint(&b->rec, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)) ||
+		binlog_varint(&b->rec, ns->id) ||
+		binlog_varint(&b->rec, level)) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write message to file
+ * @param [in] b pointer to binary logger
+ * @param [in] now timestamp of message
+ * @copydetails ll_pr_cb_t
+ */
+static int binlog_msg(struct binlog *b, uint64_t now, const char *name,
+	enum ll_level level, const char *format, va_list args) {
+	struct binlog_key *ns, *f;
+	int added;
+
+	if (!(ns = binlog_dict(&b->names, name, &added))) {
+		return (-1);
+	}
+
+	if (added && binlog_define(b, LL_BINLOG_NS, ns)) {
+		binlog_dict_forget(ns);
+
+		return (-1);
+	}
+
+	if (!(f = binlog_dict(&b->formats, format, &added))) {
+		return (-1);
+	}
+
+	/* format string is parsed once, its copy is used for that */
+	if (added && (!(f->fmt = ll_fmt_parse(f->str)) ||
+		(!f->fmt->eager && binlog_define(b, LL_BINLOG_FMT, f)))) {
+		binlog_dict_forget(f);
+
+		return (-1);
+	}
+
+	if (binlog_head(b, f->fmt->eager ? LL_BINLOG_TEXT : LL_BINLOG_MSG, now,
+		ns, level)) {
+		return (-1);
+	}
+
+	if (f->fmt->eager) {
+		b->msg.len = 0;
+
+		if (ll_buf_vprintf(&b->msg, format, args) ||
+			binlog_varint(&b->rec, b->msg.len) ||
+			ll_buf_append(&b->rec, b->msg.data, b->msg.len)) {
+			return (-1);
+		}
+	} else {
+		if (binlog_varint(&b->rec, f->id)) {
+			return (-1);
+		}
+
+		size_t off = b->rec.len;
+
+		/* grow buffer, until all arguments are packed */
+		for (size_t size = 256;; size *= 2) {
+			if (ll_buf_reserve(&b->rec, size)) {
+				return (-1);
+			}
+
+			va_list ap;
+
+			va_copy(ap, args);
+			int len = ll_fmt_pack(f->fmt, b->rec.data + off,
+				b->rec.size - off, ap);
+			va_end(ap);
+
+			if (len >= 0) {
+				b->rec.len = off + len;
+
+				break;
+			}
+		}
+	}
+
+	b->last = now;
+
+	return (binlog_write(b));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Open binary log file
+ * @copydetails ll_open_cb_t
+ */
+static int binlog_open(const char *name, enum ll_level level, struct url *u,
+	void **priv) {
+	unused(name);
+	unused(level);
+
+	assert(u);
+
+	if (u->username ||
+		u->password ||
+		u->hostname ||
+		u->port ||
+		!u->path ||
+		u->query ||
+		u->fragment) {
+		return (-1);
+	}
+
+	struct binlog *b = calloc(1, sizeof(*b));
+
+	if (!b) {
+		return (-1);
+	}
+
+	if (!(b->f = fopen(u->path, "w"))) {
+		free(b);
+
+		return (-1);
+	}
+
+	unsigned char tmp[LL_VARINT_MAX];
+
+	b->last = ll_clock_now(LL_TS_NSEC);
+
+	/* file header */
+	if (fwrite(LL_BINLOG_MAGIC, LL_BINLOG_MAGIC_LEN, 1, b->f) != 1 ||
+		fwrite(tmp, ll_varint_enc(tmp, b->last), 1, b->f) != 1) {
+		fclose(b->f);
+		free(b);
+
+		return (-1);
+	}
+
+	pthread_mutex_init(&b->lock, NULL);
+
+	*priv = b;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write message to binary log file
+ * @copydetails ll_pr_cb_t
+ */
+static int binlog_pr(void *priv, const char *name, enum ll_level level,
+	const char *format, va_list args) {
+	assert(priv);
+	assert(name);
+	assert(format);
+
+	struct binlog *b = priv;
+	uint64_t now = ll_clock_now(LL_TS_NSEC);
+
+	pthread_mutex_lock(&b->lock);
+	int rc = binlog_msg(b, now, name, level, format, args);
+	pthread_mutex_unlock(&b->lock);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write structured message to binary log file
+ * @copydetails ll_kv_cb_t
+ */
+static int binlog_kv(void *priv, const char *name, enum ll_level level,
+	const char *msg, const char *fields, size_t len) {
+	assert(priv);
+	assert(name);
+	assert(msg);
+
+	struct binlog *b = priv;
+	uint64_t now = ll_clock_now(LL_TS_NSEC);
+	size_t msg_len = strlen(msg);
+	struct binlog_key *ns;
+	int added, rc = -1;
+
+	pthread_mutex_lock(&b->lock);
+
+	if ((ns = binlog_dict(&b->names, name, &added)) && added &&
+		binlog_define(b, LL_BINLOG_NS, ns)) {
+		binlog_dict_forget(ns);
+		ns = NULL;
+	}
+
+	/* fields are in binary encoding already, so just copy them */
+	if (ns &&
+		!binlog_head(b, LL_BINLOG_KV, now, ns, level) &&
+		!binlog_varint(&b->rec, msg_len) &&
+		!ll_buf_append(&b->rec, msg, msg_len) &&
+		!ll_buf_append(&b->rec, fields, len)) {
+		b->last = now;
+		rc = binlog_write(b);
+	}
+
+	pthread_mutex_unlock(&b->lock);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write buffered records to binary log file
+ * @copydetails ll_flush_cb_t
+ */
+static int binlog_flush(void *priv)
+{
+	assert(priv);
+
+	struct binlog *b = priv;
+
+	pthread_mutex_lock(&b->lock);
+	int rc = fflush(b->f) ? -1 : 0;
+	pthread_mutex_unlock(&b->lock);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Close binary log file
+ * @copydetails ll_close_cb_t
+ */
+static int binlog_close(void *priv)
+{
+	struct binlog *b = priv;
+
+	if (!b) {
+		return (0);
+	}
+
+	int rc = fclose(b->f) ? -1 : 0;
+
+	binlog_dict_free(&b->names);
+	binlog_dict_free(&b->formats);
+	ll_buf_free(&b->rec);
+	ll_buf_free(&b->msg);
+	pthread_mutex_destroy(&b->lock);
+	free(b);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_logger_binlog(void)
+{
+	const struct ll_logger binlog_cb = {
+		.name = "binlog",
+		.open_cb = binlog_open,
+		.pr_cb = binlog_pr,
+		.flush_cb = binlog_flush,
+		.close_cb = binlog_close,
+		.kv_cb = binlog_kv,
+		.kv_enc = LL_KV_BINARY,
+	};
+
+	return (ll_logger_custom(&binlog_cb));
+}
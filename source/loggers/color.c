@@ -18,109 +18,121 @@
  */
 
 #include <assert.h>
-#include <inttypes.h>
-#include <stdio.h>
-#include <time.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <libtools/tools.h>
+#include <libtools/url.h>
 
 #include "liblog/log.h"
 #include "liblog/loggers/color.h"
+#include "../clock.h"
+#include "../query.h"
+#include "../record.h"
 
 /*------------------------------------------------------------------------*/
 
-/**
- * @brief Write colored message to stderr
- * @copydetails ll_pr_cb_t
- */
-static int color_pr(void *priv, const char *name, enum ll_level level,
-	const char *format, va_list args) {
-	unused(priv);
+/** Private data of colored logger */
+struct color {
+	/** resolution of timestamps */
+	enum ll_ts ts;
+};
 
-	assert(name);
-	assert(format);
-
-	int rc = -1;
-
-	flockfile(stderr);
-
-	do {
-		if (fprintf(stderr, "%" PRIi64 ";%s;%s;",
-			(int64_t)time(NULL), name, ll_level_str(level)) < 0) {
-			break;
-		}
+/*------------------------------------------------------------------------*/
 
-		switch (level) {
-			case LL_LEVEL_EMERG:
-				if (fputs("\033[41;91;5m", stderr) < 0) {
-					goto err;
-				}
+/**
+ * @brief Setup colored output
+ * @copydetails ll_open_cb_t
+ */
+static int color_open(const char *name, enum ll_level level, struct url *u,
+	void **priv) {
+	static const char * const keys[] = { "ts", NULL };
 
-				break;
+	unused(name);
+	unused(level);
 
-			case LL_LEVEL_ALERT:
-				if (fputs("\033[41m", stderr) < 0) {
-					goto err;
-				}
+	assert(u);
 
-				break;
+	if (u->username ||
+		u->password ||
+		u->hostname ||
+		u->port ||
+		(u->path && *u->path) ||
+		ll_query_check(u->query, keys) ||
+		u->fragment) {
+		return (-1);
+	}
 
-			case LL_LEVEL_CRIT:
-				if (fputs("\033[91m", stderr) < 0) {
-					goto err;
-				}
+	struct color *c = malloc(sizeof(*c));
+	char val[8];
 
-				break;
+	if (!c) {
+		return (-1);
+	}
 
-			case LL_LEVEL_ERR:
-				if (fputs("\033[31m", stderr) < 0) {
-					goto err;
-				}
+	c->ts = LL_TS_SEC;
 
-				break;
+	if (ll_query_get(u->query, "ts", val, sizeof(val)) ||
+		(*val && ll_clock_res(val, &c->ts))) {
+		free(c);
 
-			case LL_LEVEL_WARN:
-				if (fputs("\033[93m", stderr) < 0) {
-					goto err;
-				}
+		return (-1);
+	}
 
-				break;
+	*priv = c;
 
-			case LL_LEVEL_NOTICE:
-				if (fputs("\033[33m", stderr) < 0) {
-					goto err;
-				}
+	return (0);
+}
 
-				break;
+/*------------------------------------------------------------------------*/
 
-			case LL_LEVEL_INFO:
-				break;
+/**
+ * @brief Write colored message to stderr
+ * @copydetails ll_pr_cb_t
+ */
+static int color_pr(void *priv, const char *name, enum ll_level level,
+	const char *format, va_list args) {
+	static const char * const colors[] = {
+		[LL_LEVEL_EMERG] = "\033[41;91;5m",
+		[LL_LEVEL_ALERT] = "\033[41m",
+		[LL_LEVEL_CRIT] = "\033[91m",
+		[LL_LEVEL_ERR] = "\033[31m",
+		[LL_LEVEL_WARN] = "\033[93m",
+		[LL_LEVEL_NOTICE] = "\033[33m",
+		[LL_LEVEL_INFO] = "",
+		[LL_LEVEL_DEBUG] = "\033[32m",
+	};
 
-			case LL_LEVEL_DEBUG:
-				if (fputs("\033[32m", stderr) < 0) {
-					goto err;
-				}
+	assert(priv);
+	assert(name);
+	assert(format);
 
-				break;
+	const struct color *c = priv;
+	const char *color = "";
+	struct ll_record rec;
 
-			default:
-				break;
-		}
+	if ((unsigned)level < countof(colors)) {
+		color = colors[level];
+	}
 
-		if (vfprintf(stderr, format, args) < 0) {
-			break;
-		}
+	if (ll_record_vrender(&rec, name, level, c->ts, color, "\033[0m", format,
+		args)) {
+		return (-1);
+	}
 
-		if (fputs("\033[0m\n", stderr) < 0) {
-			break;
-		}
+	return (ll_record_write(STDERR_FILENO, &rec));
+}
 
-		rc = 0;
-	} while (0);
+/*------------------------------------------------------------------------*/
 
-err:
-	funlockfile(stderr);
+/**
+ * @brief Free colored output
+ * @copydetails ll_close_cb_t
+ */
+static int color_close(void *priv)
+{
+	free(priv);
 
-	return (rc);
+	return (0);
 }
 
 /*------------------------------------------------------------------------*/
@@ -129,7 +141,9 @@ int ll_logger_color(void)
 {
 	const struct ll_logger cbs = {
 		.name = "color",
+		.open_cb = color_open,
 		.pr_cb = color_pr,
+		.close_cb = color_close,
 	};
 
 	return (ll_logger_custom(&cbs));
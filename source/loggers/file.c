@@ -18,19 +18,797 @@
  */
 
 #include <assert.h>
-#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
 #include <libtools/tools.h>
 #include <libtools/url.h>
 
 #include "liblog/log.h"
 #include "liblog/loggers/file.h"
+#include "../clock.h"
+#include "../query.h"
+#include "../record.h"
+#include "../uring.h"
+
+/** Default size of buffer */
+#define FILE_BUFFER_SIZE (64 << 10)
+
+/** Count of buffers in flight for io_uring engine */
+#define FILE_URING_BUFFERS 4
+
+/** Maximum length of suffix of rotated file */
+#define FILE_SUFFIX_MAX 32
+
+/*------------------------------------------------------------------------*/
+
+/** Rotated file, which waits for compression */
+struct file_rotated {
+	/** next rotated file */
+	struct file_rotated *next;
+
+	/** path to file */
+	char path[];
+};
+
+/** Private data of file logger */
+struct file {
+	/** protect buffer and file */
+	pthread_mutex_t lock;
+
+	/** wake up worker thread */
+	pthread_cond_t wake;
+
+	/** worker thread, flushes buffer and rotates file */
+	pthread_t thread;
+
+	/** worker thread is running */
+	int worker;
+
+	/** serialize reopening of file */
+	pthread_mutex_t reopen;
+
+	/** log file */
+	int fd;
+
+	/** offset of buffered data in file */
+	off_t off;
+
+	/** file is regular, data is written by offset */
+	int seekable;
+
+	/** io_uring writer, if enabled */
+	struct ll_uring *uring;
+
+	/** resolution of timestamps */
+	enum ll_ts ts;
+
+	/** messages with this level or more important are written at once */
+	enum ll_level flush_level;
+
+	/** period of flusher thread in milliseconds, 0 - no flusher thread */
+	size_t flush_ms;
+
+	/** worker thread should exit */
+	int stop;
+
+	/** rotate file, when it becomes bigger, 0 - disabled */
+	size_t rotate_size;
+
+	/** rotate file with this period in seconds, 0 - disabled */
+	size_t rotate_time;
+
+	/** count of rotations, reopening is dropped, if it's changed */
+	unsigned gen;
+
+	/** time, when failed rotation by size is retried */
+	time_t retry;
+
+	/** rotated files, which wait for compression */
+	struct file_rotated *rotated;
+
+	/** compressor of rotated files (can be NULL) */
+	const char *compress;
+
+	/** reopen file on SIGHUP */
+	int hup;
+
+	/** next logger, which reopens file on SIGHUP */
+	struct file *hup_next;
+
+	/** length of buffered data */
+	size_t len;
+
+	/** size of buffer */
+	size_t size;
+
+	/** buffered messages */
+	char *buf;
+
+	/** path to file */
+	char path[];
+};
+
+/*------------------------------------------------------------------------*/
+
+/** Loggers, which reopen files on SIGHUP */
+static struct {
+	/** protect list of loggers */
+	pthread_mutex_t lock;
+
+	/** serialize start and stop of thread */
+	pthread_mutex_t setup;
+
+	/** posted by signal handler */
+	sem_t sem;
+
+	/** thread, which reopens files */
+	pthread_t thread;
+
+	/** previous handler of SIGHUP */
+	struct sigaction old;
+
+	/** thread should exit */
+	int stop;
+
+	/** loggers */
+	struct file *list;
+} hup = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.setup = PTHREAD_MUTEX_INITIALIZER,
+};
 
 /*------------------------------------------------------------------------*/
 
 /**
- * @brief Write message to file
+ * @brief Write all data to end of file
+ * @param [in] f private data of logger, should be locked
+ * @param [in] iov data to write (modified)
+ * @param [in] cnt count of @p iov
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int file_writev(struct file *f, struct iovec *iov, int cnt)
+{
+	while (cnt) {
+		/* pipes, terminals and devices can't be written by offset */
+		ssize_t n = f->seekable ? pwritev(f->fd, iov, cnt, f->off) :
+			writev(f->fd, iov, cnt);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return (-1);
+		}
+
+		f->off += n;
+
+		while (cnt && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			++ iov;
+			-- cnt;
+		}
+
+		if (cnt) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Compress rotated file by external program
+ * @param [in] prog name of compressor
+ * @param [in] path path to rotated file
+ *
+ * Compressor removes rotated file, when it's done.
+ */
+static void file_compress(const char *prog, const char *path)
+{
+	char *gzip[] = { "gzip", "-f", "--", (char *)path, NULL };
+	char *zstd[] = { "zstd", "-q", "-f", "--rm", "--", (char *)path, NULL };
+	int status;
+	pid_t pid;
+
+	if (!posix_spawnp(&pid, prog, NULL, NULL, strcmp(prog, "zstd") ? gzip : zstd,
+		environ)) {
+		while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Compress and free list of rotated files
+ * @param [in] prog name of compressor
+ * @param [in] r list of rotated files
+ */
+static void file_compress_all(const char *prog, struct file_rotated *r)
+{
+	while (r) {
+		struct file_rotated *next = r->next;
+
+		file_compress(prog, r->path);
+		free(r);
+		r = next;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, if rotated file already exists
+ * @param [in] f private data of logger
+ * @param [in] path path to rotated file
+ * @return nonzero, if file or its compressed copy exists
+ */
+static int file_exists(const struct file *f, const char *path)
+{
+	char z[strlen(path) + 8];
+
+	if (!access(path, F_OK)) {
+		return (1);
+	}
+
+	if (!f->compress) {
+		return (0);
+	}
+
+	sprintf(z, "%s.%s", path, strcmp(f->compress, "zstd") ? "gz" : "zst");
+
+	return (!access(z, F_OK));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Rename log file and continue with new one
+ * @param [in] f private data of logger, should be locked
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Rotated file is queued for compression by worker thread.
+ */
+static int file_rotate(struct file *f)
+{
+	char path[strlen(f->path) + FILE_SUFFIX_MAX];
+	time_t now = time(NULL);
+	struct tm tm;
+	size_t n;
+	int rc = 0;
+
+	/* writes in flight use descriptor of old file */
+	if (f->uring && ll_uring_wait(f->uring)) {
+		rc = -1;
+	}
+
+	localtime_r(&now, &tm);
+	n = sprintf(path, "%s.", f->path);
+	n += strftime(path + n, FILE_SUFFIX_MAX - 2, "%Y%m%d-%H%M%S", &tm);
+
+	/* don't overwrite file rotated at the same second */
+	for (unsigned i = 1; file_exists(f, path) && i < 1000; ++ i) {
+		sprintf(path + n, ".%u", i);
+	}
+
+	if (rename(f->path, path)) {
+		return (-1);
+	}
+
+	int fd = open(f->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd < 0) {
+		/* continue with old file */
+		rename(path, f->path);
+
+		return (-1);
+	}
+
+	close(f->fd);
+	f->fd = fd;
+	f->off = 0;
+	__atomic_add_fetch(&f->gen, 1, __ATOMIC_RELEASE);
+
+	struct file_rotated *r;
+
+	if (f->compress && (r = malloc(sizeof(*r) + strlen(path) + 1))) {
+		strcpy(r->path, path);
+		r->next = f->rotated;
+		f->rotated = r;
+		pthread_cond_signal(&f->wake);
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Rotate file, if data would make it bigger than limit
+ * @param [in] f private data of logger, should be locked
+ * @param [in] len length of data to write
+ */
+static void file_limit(struct file *f, size_t len)
+{
+	if (!f->rotate_size || !f->seekable || !f->off ||
+		(size_t)f->off + len <= f->rotate_size) {
+		return;
+	}
+
+	time_t now = time(NULL);
+
+	if (now < f->retry) {
+		return;
+	}
+
+	/* don't retry failed rotation for every write */
+	if (file_rotate(f) && f->off) {
+		f->retry = now + 1;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write buffered messages to file
+ * @param [in] f private data of logger, should be locked
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int file_flush(struct file *f)
+{
+	struct iovec iov = {
+		.iov_base = f->buf,
+		.iov_len = f->len,
+	};
+	int rc;
+
+	if (f->len) {
+		file_limit(f, f->len);
+	}
+
+	if (!f->uring || !f->seekable || !f->len) {
+		f->len = 0;
+
+		return (file_writev(f, &iov, !!iov.iov_len));
+	}
+
+	/* hand buffer to kernel and continue with free one */
+	rc = ll_uring_write(f->uring, f->fd, f->buf, f->len, f->off);
+	f->off += f->len;
+	f->len = 0;
+
+	if (!(f->buf = ll_uring_buf(f->uring))) {
+		/* io_uring is broken, continue with plain writes */
+		ll_uring_free(f->uring);
+		f->uring = NULL;
+		f->buf = malloc(f->size);
+		rc = -1;
+	}
+
+	return (f->buf ? rc : -1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write buffered messages and reopen log file
+ * @param [in] f private data of logger
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * New file is opened without the lock, so writers don't wait for it.
+ * They continue writing to old file, until new one is swapped in.
+ */
+static int file_reopen(struct file *f)
+{
+	int rc = 0;
+	off_t off = 0;
+
+	pthread_mutex_lock(&f->reopen);
+
+	unsigned gen = __atomic_load_n(&f->gen, __ATOMIC_ACQUIRE);
+	int fd = open(f->path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	struct stat st;
+
+	if (fd < 0 || fstat(fd, &st)) {
+		if (fd >= 0) {
+			close(fd);
+		}
+
+		pthread_mutex_unlock(&f->reopen);
+
+		return (-1);
+	}
+
+	pthread_mutex_lock(&f->lock);
+
+	/* buffered messages belong to old file */
+	if (file_flush(f) || (f->uring && ll_uring_wait(f->uring))) {
+		rc = -1;
+	}
+
+	/* file was rotated meanwhile, opened one can be already renamed */
+	if (gen != f->gen) {
+		pthread_mutex_unlock(&f->lock);
+		close(fd);
+		pthread_mutex_unlock(&f->reopen);
+
+		return (rc);
+	}
+
+	/* end of file is known, when all writes to it are finished */
+	if (S_ISREG(st.st_mode) && (off = lseek(fd, 0, SEEK_END)) < 0) {
+		pthread_mutex_unlock(&f->lock);
+		close(fd);
+		pthread_mutex_unlock(&f->reopen);
+
+		return (-1);
+	}
+
+	int old = f->fd;
+
+	f->fd = fd;
+	f->off = off;
+	f->seekable = S_ISREG(st.st_mode);
+
+	pthread_mutex_unlock(&f->lock);
+
+	close(old);
+
+	pthread_mutex_unlock(&f->reopen);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Add nanoseconds to time
+ * @param [in] ts time
+ * @param [in] ns nanoseconds
+ * @return sum of @p ts and @p ns
+ */
+static struct timespec file_ts_add(struct timespec ts, uint64_t ns)
+{
+	ns += ts.tv_nsec;
+	ts.tv_sec += ns / 1000000000;
+	ts.tv_nsec = ns % 1000000000;
+
+	return (ts);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Compare times
+ * @param [in] a time
+ * @param [in] b time
+ * @return nonzero, if @p a is before @p b
+ */
+static int file_ts_before(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec < b->tv_sec ||
+		(a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Flush buffered messages periodically and rotate file
+ * @param [in] arg private data of logger
+ * @return @p arg
+ */
+static void *file_worker(void *arg)
+{
+	struct file *f = arg;
+	struct timespec now, flush, rotate;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	flush = file_ts_add(now, f->flush_ms * 1000000);
+	rotate = file_ts_add(now, (uint64_t)f->rotate_time * 1000000000);
+
+	pthread_mutex_lock(&f->lock);
+
+	while (!f->stop) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		if (f->rotate_time && !file_ts_before(&now, &rotate)) {
+			rotate = file_ts_add(now, (uint64_t)f->rotate_time * 1000000000);
+
+			/* buffered messages belong to old file */
+			file_flush(f);
+
+			if (f->seekable) {
+				file_rotate(f);
+			}
+		}
+
+		/* compressor is waited for without the lock */
+		if (f->rotated) {
+			struct file_rotated *r = f->rotated;
+
+			f->rotated = NULL;
+			pthread_mutex_unlock(&f->lock);
+			file_compress_all(f->compress, r);
+			pthread_mutex_lock(&f->lock);
+
+			continue;
+		}
+
+		if (f->flush_ms && !file_ts_before(&now, &flush)) {
+			flush = file_ts_add(now, f->flush_ms * 1000000);
+			file_flush(f);
+		}
+
+		/* sleep until nearest deadline */
+		if (f->flush_ms && f->rotate_time) {
+			pthread_cond_timedwait(&f->wake, &f->lock,
+				file_ts_before(&flush, &rotate) ? &flush : &rotate);
+		} else if (f->flush_ms || f->rotate_time) {
+			pthread_cond_timedwait(&f->wake, &f->lock,
+				f->flush_ms ? &flush : &rotate);
+		} else {
+			pthread_cond_wait(&f->wake, &f->lock);
+		}
+	}
+
+	pthread_mutex_unlock(&f->lock);
+
+	return (arg);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Wake up SIGHUP thread
+ * @param [in] sig signal number
+ * @param [in] info information about signal
+ * @param [in] ctx context of interrupted thread
+ */
+static void file_hup_handler(int sig, siginfo_t *info, void *ctx)
+{
+	int err = errno;
+
+	sem_post(&hup.sem);
+
+	/* chain previous handler */
+	if (hup.old.sa_flags & SA_SIGINFO) {
+		hup.old.sa_sigaction(sig, info, ctx);
+	} else if (hup.old.sa_handler != SIG_DFL &&
+		hup.old.sa_handler != SIG_IGN) {
+		hup.old.sa_handler(sig);
+	}
+
+	errno = err;
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Reopen files of loggers on SIGHUP
+ * @param [in] arg unused
+ * @return @p arg
+ */
+static void *file_hup_thread(void *arg)
+{
+	while (1) {
+		while (sem_wait(&hup.sem) && errno == EINTR);
+
+		if (__atomic_load_n(&hup.stop, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+
+		pthread_mutex_lock(&hup.lock);
+
+		for (struct file *f = hup.list; f; f = f->hup_next) {
+			file_reopen(f);
+		}
+
+		pthread_mutex_unlock(&hup.lock);
+	}
+
+	return (arg);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Reopen file of logger on SIGHUP
+ * @param [in] f private data of logger
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int file_hup_add(struct file *f)
+{
+	struct sigaction sa;
+	int rc = 0;
+
+	pthread_mutex_lock(&hup.setup);
+
+	if (!hup.list) {
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_sigaction = file_hup_handler;
+		sa.sa_flags = SA_RESTART | SA_SIGINFO;
+		sigemptyset(&sa.sa_mask);
+		hup.stop = 0;
+
+		if (sem_init(&hup.sem, 0, 0)) {
+			rc = -1;
+		} else if (pthread_create(&hup.thread, NULL, file_hup_thread, NULL)) {
+			sem_destroy(&hup.sem);
+			rc = -1;
+		} else {
+			sigaction(SIGHUP, &sa, &hup.old);
+		}
+	}
+
+	if (!rc) {
+		pthread_mutex_lock(&hup.lock);
+		f->hup_next = hup.list;
+		hup.list = f;
+		pthread_mutex_unlock(&hup.lock);
+	}
+
+	pthread_mutex_unlock(&hup.setup);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Don't reopen file of logger on SIGHUP anymore
+ * @param [in] f private data of logger
+ */
+static void file_hup_del(struct file *f)
+{
+	pthread_mutex_lock(&hup.setup);
+	pthread_mutex_lock(&hup.lock);
+
+	for (struct file **i = &hup.list; *i; i = &(*i)->hup_next) {
+		if (*i == f) {
+			*i = f->hup_next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&hup.lock);
+
+	if (!hup.list) {
+		sigaction(SIGHUP, &hup.old, NULL);
+		__atomic_store_n(&hup.stop, 1, __ATOMIC_RELEASE);
+		sem_post(&hup.sem);
+		pthread_join(hup.thread, NULL);
+		sem_destroy(&hup.sem);
+	}
+
+	pthread_mutex_unlock(&hup.setup);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free private data of file logger
+ * @param [in] f private data of logger
+ */
+static void file_free(struct file *f)
+{
+	if (f->fd >= 0) {
+		close(f->fd);
+	}
+
+	pthread_cond_destroy(&f->wake);
+	pthread_mutex_destroy(&f->reopen);
+	pthread_mutex_destroy(&f->lock);
+
+	if (f->uring) {
+		ll_uring_free(f->uring);
+	} else {
+		free(f->buf);
+	}
+
+	free(f);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Parse options of file logger
+ * @param [in] f private data of logger
+ * @param [in] query query of URI (can be NULL)
+ * @param [out] uring io_uring engine is requested
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int file_opts(struct file *f, const char *query, int *uring)
+{
+	static const char * const keys[] = {
+		"ts",
+		"buffer",
+		"flush_ms",
+		"flush_level",
+		"engine",
+		"rotate_size",
+		"rotate_time",
+		"compress",
+		"hup",
+		NULL,
+	};
+	size_t hup = 0;
+	char val[8];
+
+	if (ll_query_check(query, keys)) {
+		return (-1);
+	}
+
+	if (ll_query_get(query, "ts", val, sizeof(val)) ||
+		(*val && ll_clock_res(val, &f->ts))) {
+		return (-1);
+	}
+
+	if (ll_query_get(query, "engine", val, sizeof(val))) {
+		return (-1);
+	}
+
+	if (*val) {
+		if (!strcmp(val, "uring")) {
+			*uring = 1;
+		} else if (strcmp(val, "write")) {
+			return (-1);
+		}
+	}
+
+	if (ll_query_get(query, "compress", val, sizeof(val))) {
+		return (-1);
+	}
+
+	if (*val) {
+		if (!strcmp(val, "gzip")) {
+			f->compress = "gzip";
+		} else if (!strcmp(val, "zstd")) {
+			f->compress = "zstd";
+		} else {
+			return (-1);
+		}
+	}
+
+	if (ll_query_num(query, "buffer", &f->size) ||
+		ll_query_num(query, "flush_ms", &f->flush_ms) ||
+		ll_query_level(query, "flush_level", &f->flush_level) ||
+		ll_query_num(query, "rotate_size", &f->rotate_size) ||
+		ll_query_num(query, "rotate_time", &f->rotate_time) ||
+		ll_query_num(query, "hup", &hup)) {
+		return (-1);
+	}
+
+	f->hup = !!hup;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Open file for logging
  * @copydetails ll_open_cb_t
  */
 static int file_open(const char *name, enum ll_level level, struct url *u,
@@ -45,16 +823,83 @@ static int file_open(const char *name, enum ll_level level, struct url *u,
 		u->hostname ||
 		u->port ||
 		!u->path ||
-		u->query ||
 		u->fragment) {
 		return (-1);
 	}
 
-	if (!(*priv = fopen(u->path, "w"))) {
+	struct file *f = calloc(1, sizeof(*f) + strlen(u->path) + 1);
+	pthread_condattr_t attr;
+	int uring = 0;
+
+	if (!f) {
 		return (-1);
 	}
 
-	return (0);
+	strcpy(f->path, u->path);
+	pthread_mutex_init(&f->lock, NULL);
+	pthread_mutex_init(&f->reopen, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&f->wake, &attr);
+	pthread_condattr_destroy(&attr);
+
+	f->fd = -1;
+	f->ts = LL_TS_SEC;
+	f->flush_level = LL_LEVEL_ERR;
+	f->size = FILE_BUFFER_SIZE;
+
+	do {
+		if (file_opts(f, u->query, &uring)) {
+			break;
+		}
+
+		f->fd = open(u->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			0644);
+
+		struct stat st;
+
+		if (f->fd < 0 || fstat(f->fd, &st)) {
+			break;
+		}
+
+		f->seekable = S_ISREG(st.st_mode);
+
+		/* fall back to plain writes, if io_uring is not available */
+		if (uring && f->size && f->seekable &&
+			(f->uring = ll_uring_new(FILE_URING_BUFFERS, f->size))) {
+			f->buf = ll_uring_buf(f->uring);
+		} else if (f->size) {
+			f->buf = malloc(f->size);
+		}
+
+		if (f->size && !f->buf) {
+			break;
+		}
+
+		if (!f->size) {
+			f->flush_ms = 0;
+		}
+
+		f->worker = f->flush_ms || f->rotate_size || f->rotate_time;
+
+		if (f->worker && pthread_create(&f->thread, NULL, file_worker, f)) {
+			f->worker = 0;
+			break;
+		}
+
+		if (f->hup && file_hup_add(f)) {
+			f->hup = 0;
+			break;
+		}
+
+		*priv = f;
+
+		return (0);
+	} while (0);
+
+	file_free(f);
+
+	return (-1);
 }
 
 /*------------------------------------------------------------------------*/
@@ -62,6 +907,9 @@ static int file_open(const char *name, enum ll_level level, struct url *u,
 /**
  * @brief Write message to file
  * @copydetails ll_pr_cb_t
+ *
+ * Messages are collected in buffer, which is written by one system call,
+ * when it's full, on important message or by flusher thread.
  */
 static int file_pr(void *priv, const char *name, enum ll_level level,
 	const char *format, va_list args) {
@@ -69,29 +917,53 @@ static int file_pr(void *priv, const char *name, enum ll_level level,
 	assert(name);
 	assert(format);
 
-	FILE *f = priv;
+	struct file *f = priv;
+	struct ll_record rec;
 	int rc = -1;
 
-	flockfile(f);
+	/* render message without lock, so lock is held only for copying */
+	if (ll_record_render(&rec, name, level, f->ts, format, args)) {
+		return (-1);
+	}
+
+	pthread_mutex_lock(&f->lock);
 
 	do {
-		if (fprintf(f, "%" PRIi64 ";%s;%s;",
-			(int64_t)time(NULL), name, ll_level_str(level)) < 0) {
+		if (rec.len > f->size - f->len && file_flush(f)) {
 			break;
 		}
 
-		if (vfprintf(f, format, args) < 0) {
-			break;
+		if (rec.len <= f->size) {
+			/* message is buffered */
+			memcpy(f->buf + f->len, rec.line, rec.len);
+			f->len += rec.len;
+		} else {
+			/* message is bigger than buffer */
+			struct iovec iov = {
+				.iov_base = (char *)rec.line,
+				.iov_len = rec.len,
+			};
+
+			/* keep order of messages */
+			if (f->uring && ll_uring_wait(f->uring)) {
+				break;
+			}
+
+			file_limit(f, rec.len);
+
+			if (file_writev(f, &iov, 1)) {
+				break;
+			}
 		}
 
-		if (fputc('\n', f) < 0) {
+		if (level <= f->flush_level && file_flush(f)) {
 			break;
 		}
 
 		rc = 0;
 	} while (0);
 
-	funlockfile(f);
+	pthread_mutex_unlock(&f->lock);
 
 	return (rc);
 }
@@ -99,18 +971,60 @@ static int file_pr(void *priv, const char *name, enum ll_level level,
 /*------------------------------------------------------------------------*/
 
 /**
- * @brief Write message to file
+ * @brief Write buffered messages and reopen file
+ * @copydetails ll_flush_cb_t
+ */
+static int file_flush_cb(void *priv)
+{
+	assert(priv);
+
+	return (file_reopen(priv));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write buffered messages and close file
  * @copydetails ll_close_cb_t
  */
 static int file_close(void *priv)
 {
-	FILE *f = priv;
+	struct file *f = priv;
+	int rc = 0;
 
-	if (f && fclose(f)) {
-		return (-1);
+	if (!f) {
+		return (0);
 	}
 
-	return (0);
+	if (f->hup) {
+		file_hup_del(f);
+	}
+
+	if (f->worker) {
+		pthread_mutex_lock(&f->lock);
+		f->stop = 1;
+		pthread_cond_signal(&f->wake);
+		pthread_mutex_unlock(&f->lock);
+		pthread_join(f->thread, NULL);
+	}
+
+	rc = file_flush(f);
+
+	if (f->uring && ll_uring_wait(f->uring)) {
+		rc = -1;
+	}
+
+	if (close(f->fd)) {
+		rc = -1;
+	}
+
+	file_compress_all(f->compress, f->rotated);
+	f->rotated = NULL;
+
+	f->fd = -1;
+	file_free(f);
+
+	return (rc);
 }
 
 /*------------------------------------------------------------------------*/
@@ -121,6 +1035,7 @@ int ll_logger_file(void)
 		.name = "file",
 		.open_cb = file_open,
 		.pr_cb = file_pr,
+		.flush_cb = file_flush_cb,
 		.close_cb = file_close,
 	};
 
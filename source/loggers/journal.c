@@ -0,0 +1,289 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libtools/tools.h>
+#include <libtools/url.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/journal.h"
+#include "../dgram.h"
+#include "../query.h"
+#include "../record.h"
+
+/*------------------------------------------------------------------------*/
+
+/** default path of journal socket */
+#define JOURNAL_PATH "/run/systemd/journal/socket"
+
+/** default number of queued messages */
+#define JOURNAL_QUEUE 512
+
+/** default maximum size of message */
+#define JOURNAL_SIZE 4096
+
+/** Private data of journal logger */
+struct jlog {
+	/** datagram sink */
+	struct ll_dgram *d;
+
+	/** length of header */
+	int hdr_len;
+
+	/** fields, which are constant for namespace */
+	char hdr[];
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Replace newlines, they can't be in value of simple field
+ * @param [in,out] s value of field
+ * @return value of field
+ */
+static char *journal_clean(char *s)
+{
+	for (char *p = s; (p = strchr(p, '\n')); ++ p) {
+		*p = ' ';
+	}
+
+	return (s);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Connect to journal socket
+ * @copydetails ll_open_cb_t
+ */
+static int journal_open(const char *name, enum ll_level level,
+	struct url *u, void **priv) {
+	static const char * const keys[] = {
+		"facility", "ident", "queue", "size", NULL
+	};
+
+	unused(level);
+
+	assert(name);
+	assert(u);
+
+	if (u->username ||
+		u->password ||
+		u->hostname ||
+		u->port ||
+		ll_query_check(u->query, keys) ||
+		u->fragment) {
+		return (-1);
+	}
+
+	size_t queue = JOURNAL_QUEUE;
+	size_t size = JOURNAL_SIZE;
+	int facility = 1;
+	char ident[64];
+	char *ns;
+
+	if (ll_query_facility(u->query, "facility", &facility) ||
+		ll_query_num(u->query, "queue", &queue) ||
+		ll_query_num(u->query, "size", &size) ||
+		ll_query_get(u->query, "ident", ident, sizeof(ident)) ||
+		!queue || !size) {
+		return (-1);
+	}
+
+	if (!*ident) {
+		snprintf(ident, sizeof(ident), "%s", program_invocation_short_name);
+	}
+
+	if (!(ns = strdup(name))) {
+		return (-1);
+	}
+
+	journal_clean(ident);
+	journal_clean(ns);
+
+	/* header is constant for namespace */
+	const char *format = *ns ? "SYSLOG_IDENTIFIER=%s\nSYSLOG_FACILITY=%d\n"
+		"SYSLOG_PID=%d\nLIBLOG_NAMESPACE=%s\n" :
+		"SYSLOG_IDENTIFIER=%s\nSYSLOG_FACILITY=%d\nSYSLOG_PID=%d\n";
+	int len = snprintf(NULL, 0, format, ident, facility, getpid(), ns);
+	struct jlog *j = malloc(sizeof(*j) + len + 1);
+
+	if (!j) {
+		free(ns);
+
+		return (-1);
+	}
+
+	j->hdr_len = len;
+	snprintf(j->hdr, len + 1, format, ident, facility, getpid(), ns);
+	free(ns);
+
+	if (!(j->d = ll_dgram_open(u->path && *u->path ? u->path :
+		JOURNAL_PATH, queue, size))) {
+		free(j);
+
+		return (-1);
+	}
+
+	*priv = j;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Queue message to journal
+ * @param [in] j pointer to journal logger
+ * @param [in] level logging level of message
+ * @param [in] msg message
+ * @param [in] len length of message
+ * @param [in] fields journal fields of structured message
+ * @param [in] fields_len size of fields
+ * @return on success, zero is returned
+ * @retval -1 message was dropped
+ *
+ * Message is written in binary safe form, so it can have newlines.
+ * Message with fields can't be truncated, too big one is dropped.
+ */
+static int journal_send(const struct jlog *j, enum ll_level level,
+	const char *msg, size_t len, const char *fields, size_t fields_len) {
+	char pri[] = "PRIORITY=0\n";
+	unsigned char size[8];
+
+	pri[9] += level;
+
+	for (int i = 0; i < 8; ++ i) {
+		size[i] = (uint64_t)len >> (i * 8);
+	}
+
+	struct iovec iov[] = {
+		{ pri, sizeof(pri) - 1 },
+		{ (void *)j->hdr, j->hdr_len },
+		{ "MESSAGE\n", 8 },
+		{ size, sizeof(size) },
+		{ (void *)msg, len },
+		{ "\n", 1 },
+		{ (void *)fields, fields_len },
+	};
+
+	for (size_t i = 0; i < countof(iov); ++ i) {
+		ll_record_bytes += iov[i].iov_len;
+	}
+
+	return (ll_dgram_put(j->d, iov, countof(iov), 0));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Queue message to journal
+ * @copydetails ll_pr_cb_t
+ */
+static int journal_pr(void *priv, const char *name, enum ll_level level,
+	const char *format, va_list args) {
+	assert(priv);
+	assert(name);
+	assert(format);
+
+	const char *msg;
+	size_t len;
+
+	unused(name);
+
+	/* message can be formatted already by other logger of namespace */
+	if (ll_record_msg(&msg, &len, format, args)) {
+		return (-1);
+	}
+
+	return (journal_send(priv, level, msg, len, NULL, 0));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Queue structured message to journal
+ * @copydetails ll_kv_cb_t
+ */
+static int journal_kv(void *priv, const char *name, enum ll_level level,
+	const char *msg, const char *fields, size_t len) {
+	assert(priv);
+	assert(name);
+	assert(msg);
+
+	unused(name);
+
+	return (journal_send(priv, level, msg, strlen(msg), fields, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Send queued messages to journal
+ * @copydetails ll_flush_cb_t
+ */
+static int journal_flush(void *priv)
+{
+	const struct jlog *j = priv;
+
+	return (ll_dgram_flush(j->d));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Close journal socket
+ * @copydetails ll_close_cb_t
+ */
+static int journal_close(void *priv)
+{
+	struct jlog *j = priv;
+
+	if (!j) {
+		return (0);
+	}
+
+	ll_dgram_close(j->d);
+	free(j);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_logger_journal(void)
+{
+	const struct ll_logger cbs = {
+		.name = "journal",
+		.open_cb = journal_open,
+		.pr_cb = journal_pr,
+		.flush_cb = journal_flush,
+		.close_cb = journal_close,
+		.kv_cb = journal_kv,
+		.kv_enc = LL_KV_JOURNAL,
+	};
+
+	return (ll_logger_custom(&cbs));
+}
@@ -0,0 +1,286 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libtools/tools.h>
+#include <libtools/url.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/json.h"
+#include "../buf.h"
+#include "../clock.h"
+#include "../escape.h"
+#include "../query.h"
+#include "../record.h"
+
+/*------------------------------------------------------------------------*/
+
+/** Private data of JSON logger */
+struct json {
+	/** output file descriptor */
+	int fd;
+
+	/** resolution of timestamps */
+	enum ll_ts ts;
+};
+
+/*------------------------------------------------------------------------*/
+
+/** initialize @ref json_key */
+static pthread_once_t json_once = PTHREAD_ONCE_INIT;
+
+/** free line buffer of exited thread */
+static pthread_key_t json_key;
+
+/** line buffer of current thread */
+static __thread struct ll_buf *json_buf;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free line buffer of exited thread
+ * @param [in] ptr pointer to buffer
+ */
+static void json_buf_free(void *ptr)
+{
+	ll_buf_free(ptr);
+	free(ptr);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** Initialize key of line buffers once per process */
+static void json_init(void)
+{
+	pthread_key_create(&json_key, json_buf_free);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return line buffer of current thread
+ * @return pointer to empty buffer
+ * @retval NULL error occurred
+ */
+static struct ll_buf *json_buf_get(void)
+{
+	struct ll_buf *b = json_buf;
+
+	if (!b) {
+		pthread_once(&json_once, json_init);
+
+		if (!(b = calloc(1, sizeof(*b)))) {
+			return (NULL);
+		}
+
+		if (pthread_setspecific(json_key, b)) {
+			free(b);
+
+			return (NULL);
+		}
+
+		json_buf = b;
+	}
+
+	b->len = 0;
+
+	return (b);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Render and write JSON line
+ * @param [in] j pointer to JSON logger
+ * @param [in] name namespace of message
+ * @param [in] level logging level of message
+ * @param [in] msg message
+ * @param [in] msg_len length of message
+ * @param [in] fields JSON encoded fields, without braces
+ * @param [in] len size of encoded fields
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int json_write(const struct json *j, const char *name,
+	enum ll_level level, const char *msg, size_t msg_len,
+	const char *fields, size_t len) {
+	struct ll_buf *b = json_buf_get();
+	const char *lvl = ll_level_str(level);
+	char ts[LL_CLOCK_STR_MAX];
+	struct ll_record rec;
+
+	if (!b) {
+		return (-1);
+	}
+
+	rec.ts = ll_clock_now(j->ts);
+	rec.name = name;
+	rec.level = level;
+
+	if (ll_buf_append(b, "{\"ts\":", 6) ||
+		ll_buf_append(b, ts, ll_clock_str(ts, rec.ts, j->ts)) ||
+		ll_buf_append(b, ",\"ns\":", 6) ||
+		ll_escape_json(b, name, strlen(name)) ||
+		ll_buf_append(b, ",\"level\":\"", 10) ||
+		ll_buf_append(b, lvl, strlen(lvl)) ||
+		ll_buf_append(b, "\",\"msg\":", 8) ||
+		ll_escape_json(b, msg, msg_len) ||
+		(len && (ll_buf_append(b, ",", 1) ||
+		ll_buf_append(b, fields, len))) ||
+		ll_buf_append(b, "}\n", 2)) {
+		return (-1);
+	}
+
+	rec.line = b->data;
+	rec.len = b->len;
+	ll_record_bytes += b->len;
+
+	return (ll_record_write(j->fd, &rec));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Open JSON lines output
+ * @copydetails ll_open_cb_t
+ */
+static int json_open(const char *name, enum ll_level level, struct url *u,
+	void **priv) {
+	static const char * const keys[] = { "ts", NULL };
+
+	unused(name);
+	unused(level);
+
+	assert(u);
+
+	if (u->username ||
+		u->password ||
+		u->hostname ||
+		u->port ||
+		ll_query_check(u->query, keys) ||
+		u->fragment) {
+		return (-1);
+	}
+
+	struct json *j = malloc(sizeof(*j));
+	char val[8];
+
+	if (!j) {
+		return (-1);
+	}
+
+	j->ts = LL_TS_SEC;
+	j->fd = STDERR_FILENO;
+
+	if (ll_query_get(u->query, "ts", val, sizeof(val)) ||
+		(*val && ll_clock_res(val, &j->ts)) ||
+		(u->path && *u->path && -1 == (j->fd = open(u->path,
+		O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)))) {
+		free(j);
+
+		return (-1);
+	}
+
+	*priv = j;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write message as JSON line
+ * @copydetails ll_pr_cb_t
+ */
+static int json_pr(void *priv, const char *name, enum ll_level level,
+	const char *format, va_list args) {
+	assert(priv);
+	assert(name);
+	assert(format);
+
+	const char *msg;
+	size_t len;
+
+	/* message can be formatted already by other logger of namespace */
+	if (ll_record_msg(&msg, &len, format, args)) {
+		return (-1);
+	}
+
+	return (json_write(priv, name, level, msg, len, NULL, 0));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write structured message as JSON line
+ * @copydetails ll_kv_cb_t
+ */
+static int json_kv(void *priv, const char *name, enum ll_level level,
+	const char *msg, const char *fields, size_t len) {
+	assert(priv);
+	assert(name);
+	assert(msg);
+
+	return (json_write(priv, name, level, msg, strlen(msg), fields, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Close JSON lines output
+ * @copydetails ll_close_cb_t
+ */
+static int json_close(void *priv)
+{
+	struct json *j = priv;
+	int rc = 0;
+
+	if (!j) {
+		return (0);
+	}
+
+	if (j->fd != STDERR_FILENO && close(j->fd)) {
+		rc = -1;
+	}
+
+	free(j);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_logger_json(void)
+{
+	const struct ll_logger cbs = {
+		.name = "json",
+		.open_cb = json_open,
+		.pr_cb = json_pr,
+		.close_cb = json_close,
+		.kv_cb = json_kv,
+		.kv_enc = LL_KV_JSON,
+	};
+
+	return (ll_logger_custom(&cbs));
+}
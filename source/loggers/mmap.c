@@ -0,0 +1,534 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <libtools/tools.h>
+#include <libtools/url.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/mmap.h"
+#include "../clock.h"
+#include "../namespace.h"
+#include "../query.h"
+#include "../record.h"
+
+/** Default size of segment */
+#define MMAP_SEGMENT_SIZE (64 << 20)
+
+/*------------------------------------------------------------------------*/
+
+/** Mapped segment of log */
+struct mmap_seg {
+	/** offset of next message, can be bigger than segment */
+	size_t cursor __attribute__((aligned(LL_CACHELINE)));
+
+	/** count of threads, which are writing to segment */
+	size_t active;
+
+	/** length of data, known after segment is filled */
+	size_t used __attribute__((aligned(LL_CACHELINE)));
+
+	/** mapped file */
+	char *data;
+
+	/** size of segment */
+	size_t size;
+
+	/** file descriptor */
+	int fd;
+
+	/** number of segment */
+	unsigned n;
+
+	/** next item of retired or previous segments */
+	struct mmap_seg *next;
+};
+
+/** Private data of memory-mapped logger */
+struct mlog {
+	/** segment for messages */
+	struct mmap_seg *cur;
+
+	/** protect everything below */
+	pthread_mutex_t lock;
+
+	/** wake up roller thread */
+	pthread_cond_t wake;
+
+	/** wake up writers, when roller thread prepared segment */
+	pthread_cond_t ready;
+
+	/** roller thread */
+	pthread_t thread;
+
+	/** prepared segment, if any */
+	struct mmap_seg *next;
+
+	/** filled segments to unmap */
+	struct mmap_seg *retired;
+
+	/** unmapped segments, they are freed on close */
+	struct mmap_seg *dead;
+
+	/** roller thread should exit */
+	int stop;
+
+	/** roller thread prepares segment without the lock */
+	int preparing;
+
+	/** number of next segment */
+	unsigned n;
+
+	/** size of segments */
+	size_t size;
+
+	/** resolution of timestamps */
+	enum ll_ts ts;
+
+	/** path to log */
+	char path[];
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return path to segment
+ * @param [in] m private data of logger
+ * @param [in] n number of segment
+ * @param [out] path buffer for path, 16 bytes longer than path of log
+ */
+static void mmap_seg_path(const struct mlog *m, unsigned n, char *path)
+{
+	if (n) {
+		sprintf(path, "%s.%u", m->path, n);
+	} else {
+		strcpy(path, m->path);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Create and map segment
+ * @param [in] m private data of logger
+ * @param [in] n number of segment
+ * @return pointer to segment
+ * @retval NULL error occurred
+ */
+static struct mmap_seg *mmap_seg_new(const struct mlog *m, unsigned n)
+{
+	struct mmap_seg *s;
+	char path[strlen(m->path) + 16];
+
+	mmap_seg_path(m, n, path);
+
+	if (posix_memalign((void **)&s, LL_CACHELINE, sizeof(*s))) {
+		return (NULL);
+	}
+
+	memset(s, 0, sizeof(*s));
+	s->size = m->size;
+	s->used = m->size;
+	s->n = n;
+
+	do {
+		s->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+		if (s->fd < 0) {
+			break;
+		}
+
+		if (posix_fallocate(s->fd, 0, s->size)) {
+			break;
+		}
+
+		s->data = mmap(NULL, s->size, PROT_WRITE, MAP_SHARED, s->fd, 0);
+
+		if (s->data == MAP_FAILED) {
+			break;
+		}
+
+		return (s);
+	} while (0);
+
+	if (s->fd >= 0) {
+		close(s->fd);
+		unlink(path);
+	}
+
+	free(s);
+
+	return (NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Unmap segment and truncate it to written data
+ * @param [in] s segment
+ *
+ * Segment is not freed, because late writers still can touch it's cursor.
+ */
+static void mmap_seg_retire(struct mmap_seg *s)
+{
+	const struct timespec ts = { .tv_nsec = 10000 };
+
+	/* wait for writers, which reserved space in segment */
+	while (__atomic_load_n(&s->active, __ATOMIC_SEQ_CST)) {
+		nanosleep(&ts, NULL);
+	}
+
+	size_t used = __atomic_load_n(&s->used, __ATOMIC_ACQUIRE);
+
+	munmap(s->data, s->size);
+
+	if (ftruncate(s->fd, used)) {
+		/* nothing to do, tail of segment is filled by zeroes */
+	}
+
+	close(s->fd);
+	s->data = NULL;
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Prepare next segment and unmap filled ones
+ * @param [in] arg private data of logger
+ * @return @p arg
+ */
+static void *mmap_roller(void *arg)
+{
+	struct mlog *m = arg;
+
+	pthread_mutex_lock(&m->lock);
+
+	while (!m->stop) {
+		struct mmap_seg *s = m->retired;
+
+		m->retired = NULL;
+
+		if (s) {
+			pthread_mutex_unlock(&m->lock);
+
+			for (struct mmap_seg *i = s; i; i = i->next) {
+				mmap_seg_retire(i);
+			}
+
+			pthread_mutex_lock(&m->lock);
+
+			while (s) {
+				struct mmap_seg *next = s->next;
+
+				s->next = m->dead;
+				m->dead = s;
+				s = next;
+			}
+		}
+
+		/* allocation of segment is slow, writers don't wait for it */
+		if (!m->next) {
+			unsigned n = m->n ++;
+
+			m->preparing = 1;
+			pthread_mutex_unlock(&m->lock);
+			s = mmap_seg_new(m, n);
+			pthread_mutex_lock(&m->lock);
+			m->preparing = 0;
+
+			if (s) {
+				m->next = s;
+			} else if (m->n == n + 1) {
+				m->n = n;
+			}
+
+			pthread_cond_broadcast(&m->ready);
+		}
+
+		if (!m->retired && !m->stop) {
+			pthread_cond_wait(&m->wake, &m->lock);
+		}
+	}
+
+	pthread_mutex_unlock(&m->lock);
+
+	return (arg);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Replace filled segment by prepared one
+ * @param [in] m private data of logger
+ * @param [in] s filled segment
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int mmap_roll(struct mlog *m, struct mmap_seg *s)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&m->lock);
+
+	/* roller thread is already preparing segment */
+	while (__atomic_load_n(&m->cur, __ATOMIC_ACQUIRE) == s && !m->next &&
+		m->preparing) {
+		pthread_cond_wait(&m->ready, &m->lock);
+	}
+
+	/* segment can be already replaced by other thread */
+	if (__atomic_load_n(&m->cur, __ATOMIC_ACQUIRE) == s) {
+		struct mmap_seg *next = m->next;
+
+		/* roller thread is late or failed, do it by self */
+		if (!next && (next = mmap_seg_new(m, m->n))) {
+			++ m->n;
+		}
+
+		if (next) {
+			m->next = NULL;
+			__atomic_store_n(&m->cur, next, __ATOMIC_RELEASE);
+
+			s->next = m->retired;
+			m->retired = s;
+			pthread_cond_signal(&m->wake);
+		} else {
+			rc = -1;
+		}
+	}
+
+	pthread_mutex_unlock(&m->lock);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Copy message to segment
+ * @param [in] m private data of logger
+ * @param [in] msg rendered message
+ * @param [in] len length of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int mmap_put(struct mlog *m, const char *msg, size_t len)
+{
+	if (len > m->size) {
+		return (-1);
+	}
+
+	while (1) {
+		struct mmap_seg *s = __atomic_load_n(&m->cur, __ATOMIC_ACQUIRE);
+
+		__atomic_add_fetch(&s->active, 1, __ATOMIC_SEQ_CST);
+
+		size_t off = __atomic_fetch_add(&s->cursor, len, __ATOMIC_SEQ_CST);
+
+		if (off + len <= s->size) {
+			memcpy(s->data + off, msg, len);
+			__atomic_sub_fetch(&s->active, 1, __ATOMIC_RELEASE);
+
+			return (0);
+		}
+
+		/* first writer, which did not fit, knows end of data */
+		if (off <= s->size) {
+			__atomic_store_n(&s->used, off, __ATOMIC_RELEASE);
+		}
+
+		__atomic_sub_fetch(&s->active, 1, __ATOMIC_RELEASE);
+
+		if (mmap_roll(m, s)) {
+			return (-1);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Map first segment of log
+ * @copydetails ll_open_cb_t
+ */
+static int mmap_open(const char *name, enum ll_level level, struct url *u,
+	void **priv) {
+	static const char * const keys[] = { "ts", "size", NULL };
+
+	unused(name);
+	unused(level);
+
+	assert(u);
+
+	if (u->username ||
+		u->password ||
+		u->hostname ||
+		u->port ||
+		!u->path ||
+		ll_query_check(u->query, keys) ||
+		u->fragment) {
+		return (-1);
+	}
+
+	struct mlog *m;
+	char val[8];
+
+	if (posix_memalign((void **)&m, LL_CACHELINE, sizeof(*m) + strlen(u->path) + 1)) {
+		return (-1);
+	}
+
+	memset(m, 0, sizeof(*m));
+	strcpy(m->path, u->path);
+	m->ts = LL_TS_SEC;
+	m->size = MMAP_SEGMENT_SIZE;
+
+	if (ll_query_get(u->query, "ts", val, sizeof(val)) ||
+		(*val && ll_clock_res(val, &m->ts)) ||
+		ll_query_num(u->query, "size", &m->size) ||
+		!m->size ||
+		!(m->cur = mmap_seg_new(m, m->n ++))) {
+		free(m);
+
+		return (-1);
+	}
+
+	pthread_mutex_init(&m->lock, NULL);
+	pthread_cond_init(&m->wake, NULL);
+	pthread_cond_init(&m->ready, NULL);
+
+	if (pthread_create(&m->thread, NULL, mmap_roller, m)) {
+		mmap_seg_retire(m->cur);
+		free(m->cur);
+		pthread_cond_destroy(&m->ready);
+		pthread_cond_destroy(&m->wake);
+		pthread_mutex_destroy(&m->lock);
+		free(m);
+
+		return (-1);
+	}
+
+	*priv = m;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write message to mapped segment
+ * @copydetails ll_pr_cb_t
+ */
+static int mmap_pr(void *priv, const char *name, enum ll_level level,
+	const char *format, va_list args) {
+	assert(priv);
+	assert(name);
+	assert(format);
+
+	struct ll_record rec;
+
+	if (ll_record_render(&rec, name, level, ((struct mlog *)priv)->ts, format,
+		args)) {
+		return (-1);
+	}
+
+	return (mmap_put(priv, rec.line, rec.len));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Unmap segments of log
+ * @copydetails ll_close_cb_t
+ */
+static int mmap_close(void *priv)
+{
+	struct mlog *m = priv;
+
+	if (!m) {
+		return (0);
+	}
+
+	pthread_mutex_lock(&m->lock);
+	m->stop = 1;
+	pthread_cond_signal(&m->wake);
+	pthread_mutex_unlock(&m->lock);
+	pthread_join(m->thread, NULL);
+
+	/* data of last segment ends at cursor */
+	struct mmap_seg *s = m->cur;
+	size_t used = __atomic_load_n(&s->cursor, __ATOMIC_ACQUIRE);
+
+	if (used < s->used) {
+		s->used = used;
+	}
+
+	s->next = m->retired;
+	m->retired = s;
+
+	/* prepared segment is not needed */
+	if ((s = m->next)) {
+		char path[strlen(m->path) + 16];
+
+		mmap_seg_path(m, s->n, path);
+		s->used = 0;
+		mmap_seg_retire(s);
+		unlink(path);
+		free(s);
+	}
+
+	while ((s = m->retired)) {
+		m->retired = s->next;
+		mmap_seg_retire(s);
+		free(s);
+	}
+
+	while ((s = m->dead)) {
+		m->dead = s->next;
+		free(s);
+	}
+
+	pthread_cond_destroy(&m->ready);
+	pthread_cond_destroy(&m->wake);
+	pthread_mutex_destroy(&m->lock);
+	free(m);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_logger_mmap(void)
+{
+	const struct ll_logger cbs = {
+		.name = "mmap",
+		.open_cb = mmap_open,
+		.pr_cb = mmap_pr,
+		.close_cb = mmap_close,
+	};
+
+	return (ll_logger_custom(&cbs));
+}
@@ -0,0 +1,583 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <libtools/tools.h>
+#include <libtools/url.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/ring.h"
+#include "../clock.h"
+#include "../query.h"
+#include "../record.h"
+
+/** Default size of ring of thread */
+#define RING_SIZE (1 << 20)
+
+
+/*------------------------------------------------------------------------*/
+
+/** Ring of one thread */
+struct ring_buf {
+	/** end of message being written, as bytes since start of ring */
+	uint64_t reserved;
+
+	/** end of written messages, as bytes since start of ring */
+	uint64_t head;
+
+	/** non-zero, if ring is owned by thread */
+	int busy;
+
+	/** id of last owner thread */
+	pid_t tid;
+
+	/** size of mapping */
+	size_t len;
+
+	/** next ring of logger */
+	struct ring_buf *next;
+
+	/** messages */
+	char data[];
+};
+
+/** Private data of flight recorder */
+struct ring {
+	/** rings of threads, new ones are pushed without lock */
+	struct ring_buf *bufs;
+
+	/** ring of current thread */
+	pthread_key_t key;
+
+	/** size of ring of thread */
+	size_t size;
+
+	/** resolution of timestamps */
+	enum ll_ts ts;
+
+	/** next logger, which is dumped on crash */
+	struct ring *next;
+
+	/** path to dump */
+	char path[];
+};
+
+/** Fatal signals, which dump rings */
+static const int ring_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+/** Handler of fatal signals */
+static struct {
+	/** protect list */
+	pthread_mutex_t lock;
+
+	/** previous handlers of fatal signals */
+	struct sigaction old[countof(ring_signals)];
+
+	/** state of dump: 0 - not started, 1 - in progress, 2 - done */
+	int dumped;
+
+	/** loggers, read by signal handler without lock */
+	struct ring *list;
+} crash = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Release ring of exited thread, it can be reused by next thread
+ * @param [in] arg pointer to ring
+ *
+ * Messages of exited thread are kept, until ring is reused.
+ */
+static void ring_buf_release(void *arg)
+{
+	struct ring_buf *b = arg;
+
+	__atomic_store_n(&b->busy, 0, __ATOMIC_RELEASE);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return ring of current thread
+ * @param [in] r private data of logger
+ * @return pointer to ring
+ * @retval NULL error occurred
+ *
+ * Ring of exited thread is reused, otherwise new one is mapped
+ * and populated, so writing of messages never faults on its pages.
+ */
+static struct ring_buf *ring_buf_get(struct ring *r)
+{
+	struct ring_buf *b = pthread_getspecific(r->key);
+
+	if (b) {
+		return (b);
+	}
+
+	for (b = __atomic_load_n(&r->bufs, __ATOMIC_ACQUIRE); b; b = b->next) {
+		int busy = 0;
+
+		if (__atomic_compare_exchange_n(&b->busy, &busy, 1, 0,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+
+	if (b) {
+		__atomic_store_n(&b->head, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&b->reserved, 0, __ATOMIC_RELAXED);
+	} else {
+		size_t len = sizeof(*b) + r->size;
+
+		b = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+
+		if (b == MAP_FAILED) {
+			return (NULL);
+		}
+
+		b->reserved = 0;
+		b->head = 0;
+		b->busy = 1;
+		b->len = len;
+		b->next = __atomic_load_n(&r->bufs, __ATOMIC_RELAXED);
+
+		while (!__atomic_compare_exchange_n(&r->bufs, &b->next, b, 1,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+
+	b->tid = syscall(SYS_gettid);
+
+	if (pthread_setspecific(r->key, b)) {
+		ring_buf_release(b);
+
+		return (NULL);
+	}
+
+	return (b);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Copy message to ring of current thread
+ * @param [in] r private data of logger
+ * @param [in] b ring of current thread
+ * @param [in] msg rendered message
+ * @param [in] len length of message
+ *
+ * Ring has single writer, so message is copied without atomic operations.
+ * Reserved end is published first, so dump skips overwritten messages.
+ */
+static void ring_buf_put(const struct ring *r, struct ring_buf *b,
+	const char *msg, size_t len) {
+	uint64_t head = b->head;
+	size_t off = head % r->size;
+	size_t n = len < r->size - off ? len : r->size - off;
+
+	__atomic_store_n(&b->reserved, head + len, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(b->data + off, msg, n);
+	memcpy(b->data, msg + n, len - n);
+
+	__atomic_store_n(&b->head, head + len, __ATOMIC_RELEASE);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write whole buffer to file, async-signal-safe
+ * @param [in] fd file descriptor
+ * @param [in] buf data to write
+ * @param [in] len length of data
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ring_write(int fd, const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t rc = write(fd, buf, len);
+
+		if (rc < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (rc <= 0) {
+			return (-1);
+		}
+
+		buf += rc;
+		len -= rc;
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write messages of one ring to file, async-signal-safe
+ * @param [in] r private data of logger
+ * @param [in] b ring of thread
+ * @param [in] fd file descriptor of dump
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Section of thread starts by line "# thread TID". Ring of other thread
+ * can be written concurrently, so its oldest message can be lost.
+ */
+static int ring_buf_dump(const struct ring *r, const struct ring_buf *b,
+	int fd) {
+	char hdr[32] = "# thread ";
+	char num[16];
+	size_t len = strlen(hdr);
+	size_t i = 0;
+
+	uint64_t head = __atomic_load_n(&b->head, __ATOMIC_ACQUIRE);
+	uint64_t start = __atomic_load_n(&b->reserved, __ATOMIC_ACQUIRE);
+
+	start = start > r->size ? start - r->size : 0;
+
+	/* skip message, which was overwritten in part */
+	if (start) {
+		while (start < head && b->data[start % r->size] != '\n') {
+			++ start;
+		}
+
+		++ start;
+	}
+
+	if (start >= head) {
+		return (0);
+	}
+
+	/* no snprintf() in signal handler */
+	for (unsigned long tid = b->tid; tid || !i; tid /= 10) {
+		num[i ++] = '0' + tid % 10;
+	}
+
+	while (i) {
+		hdr[len ++] = num[-- i];
+	}
+
+	hdr[len ++] = '\n';
+
+	size_t off = start % r->size;
+	size_t n = head - start;
+
+	if (n > r->size - off) {
+		n = r->size - off;
+	}
+
+	if (ring_write(fd, hdr, len) ||
+		ring_write(fd, b->data + off, n) ||
+		ring_write(fd, b->data, head - start - n)) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write rings of all threads to dump, async-signal-safe
+ * @param [in] r private data of logger
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ring_dump(const struct ring *r)
+{
+	int fd = open(r->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	int rc = 0;
+
+	if (fd < 0) {
+		return (-1);
+	}
+
+	for (struct ring_buf *b = __atomic_load_n(&r->bufs, __ATOMIC_ACQUIRE);
+		b; b = b->next) {
+		if (ring_buf_dump(r, b, fd)) {
+			rc = -1;
+		}
+	}
+
+	if (close(fd)) {
+		rc = -1;
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Dump rings on fatal signal
+ * @param [in] sig signal number
+ * @param [in] info information about signal
+ * @param [in] ctx context of interrupted thread
+ */
+static void ring_handler(int sig, siginfo_t *info, void *ctx)
+{
+	const struct timespec ts = { .tv_nsec = 1000000 };
+	int err = errno;
+	int dumped = 0;
+	size_t i = 0;
+
+	/* first crashed thread dumps, others wait for it */
+	if (__atomic_compare_exchange_n(&crash.dumped, &dumped, 1, 0,
+		__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		for (struct ring *r = __atomic_load_n(&crash.list,
+			__ATOMIC_ACQUIRE); r; r = r->next) {
+			ring_dump(r);
+		}
+
+		__atomic_store_n(&crash.dumped, 2, __ATOMIC_RELEASE);
+	} else {
+		while (__atomic_load_n(&crash.dumped, __ATOMIC_ACQUIRE) == 1) {
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	while (ring_signals[i] != sig) {
+		++ i;
+	}
+
+	/* chain previous handler */
+	struct sigaction *old = &crash.old[i];
+
+	if (old->sa_flags & SA_SIGINFO) {
+		old->sa_sigaction(sig, info, ctx);
+	} else if (old->sa_handler != SIG_DFL &&
+		old->sa_handler != SIG_IGN) {
+		old->sa_handler(sig);
+	} else {
+		/* signal is blocked, it's delivered after return */
+		sigaction(sig, old, NULL);
+		raise(sig);
+	}
+
+	errno = err;
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Dump rings of logger on fatal signals
+ * @param [in] r private data of logger
+ */
+static void ring_crash_add(struct ring *r)
+{
+	struct sigaction sa;
+
+	pthread_mutex_lock(&crash.lock);
+
+	if (!crash.list) {
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_sigaction = ring_handler;
+		sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+		sigemptyset(&sa.sa_mask);
+
+		for (size_t i = 0; i < countof(ring_signals); ++ i) {
+			sigaction(ring_signals[i], &sa, &crash.old[i]);
+		}
+	}
+
+	r->next = crash.list;
+	__atomic_store_n(&crash.list, r, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&crash.lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Don't dump rings of logger on fatal signals anymore
+ * @param [in] r private data of logger
+ */
+static void ring_crash_del(struct ring *r)
+{
+	pthread_mutex_lock(&crash.lock);
+
+	for (struct ring **i = &crash.list; *i; i = &(*i)->next) {
+		if (*i == r) {
+			__atomic_store_n(i, r->next, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+
+	if (!crash.list) {
+		for (size_t i = 0; i < countof(ring_signals); ++ i) {
+			sigaction(ring_signals[i], &crash.old[i], NULL);
+		}
+	}
+
+	pthread_mutex_unlock(&crash.lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Open flight recorder
+ * @copydetails ll_open_cb_t
+ */
+static int ring_open(const char *name, enum ll_level level, struct url *u,
+	void **priv) {
+	static const char * const keys[] = { "ts", "size", NULL };
+
+	unused(name);
+	unused(level);
+
+	assert(u);
+
+	if (u->username ||
+		u->password ||
+		u->hostname ||
+		u->port ||
+		!u->path ||
+		ll_query_check(u->query, keys) ||
+		u->fragment) {
+		return (-1);
+	}
+
+	struct ring *r;
+	char val[8];
+
+	if (!(r = malloc(sizeof(*r) + strlen(u->path) + 1))) {
+		return (-1);
+	}
+
+	memset(r, 0, sizeof(*r));
+	strcpy(r->path, u->path);
+	r->ts = LL_TS_USEC;
+	r->size = RING_SIZE;
+
+	if (ll_query_get(u->query, "ts", val, sizeof(val)) ||
+		(*val && ll_clock_res(val, &r->ts)) ||
+		ll_query_num(u->query, "size", &r->size) ||
+		!r->size ||
+		pthread_key_create(&r->key, ring_buf_release)) {
+		free(r);
+
+		return (-1);
+	}
+
+	ring_crash_add(r);
+	*priv = r;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write message to ring of current thread
+ * @copydetails ll_pr_cb_t
+ */
+static int ring_pr(void *priv, const char *name, enum ll_level level,
+	const char *format, va_list args) {
+	assert(priv);
+	assert(name);
+	assert(format);
+
+	struct ring *r = priv;
+	struct ring_buf *b;
+	struct ll_record rec;
+
+	if (ll_record_render(&rec, name, level, r->ts, format, args) ||
+		rec.len > r->size ||
+		!(b = ring_buf_get(r))) {
+		return (-1);
+	}
+
+	ring_buf_put(r, b, rec.line, rec.len);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write rings to dump on request
+ * @copydetails ll_flush_cb_t
+ */
+static int ring_flush(void *priv)
+{
+	if (!priv) {
+		return (0);
+	}
+
+	return (ring_dump(priv));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Unmap rings of threads
+ * @copydetails ll_close_cb_t
+ */
+static int ring_close(void *priv)
+{
+	struct ring *r = priv;
+	struct ring_buf *b;
+
+	if (!r) {
+		return (0);
+	}
+
+	ring_crash_del(r);
+	pthread_key_delete(r->key);
+
+	while ((b = r->bufs)) {
+		r->bufs = b->next;
+		munmap(b, b->len);
+	}
+
+	free(r);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_logger_ring(void)
+{
+	const struct ll_logger cbs = {
+		.name = "ring",
+		.open_cb = ring_open,
+		.pr_cb = ring_pr,
+		.flush_cb = ring_flush,
+		.close_cb = ring_close,
+	};
+
+	return (ll_logger_custom(&cbs));
+}
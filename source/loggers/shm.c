@@ -0,0 +1,228 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <libtools/tools.h>
+#include <libtools/url.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/shm.h"
+#include "../clock.h"
+#include "../query.h"
+#include "../record.h"
+#include "../shm.h"
+
+/*------------------------------------------------------------------------*/
+
+/** default size of ring */
+#define SHMLOG_SIZE (1 << 20)
+
+/** number of rings created by process */
+static unsigned shmlog_rings;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Create ring for namespace
+ * @copydetails ll_open_cb_t
+ */
+static int shmlog_open(const char *name, enum ll_level level, struct url *u,
+	void **priv) {
+	static const char * const keys[] = { "size", NULL };
+
+	unused(name);
+	unused(level);
+
+	assert(u);
+
+	if (u->username ||
+		u->password ||
+		u->hostname ||
+		u->port ||
+		ll_query_check(u->query, keys) ||
+		u->fragment) {
+		return (-1);
+	}
+
+	size_t size = SHMLOG_SIZE;
+
+	if (ll_query_num(u->query, "size", &size) || !size) {
+		return (-1);
+	}
+
+	const char *ident = u->path && *u->path ? u->path :
+		program_invocation_short_name;
+	char file[128];
+
+	if (*ident == '/') {
+		++ ident;
+	}
+
+	/* every namespace has own ring, collector tells them apart by name */
+	snprintf(file, sizeof(file), LL_SHM_PREFIX "%.64s.%d.%u", ident,
+		getpid(), __atomic_fetch_add(&shmlog_rings, 1, __ATOMIC_RELAXED));
+
+	for (char *p = file; (p = strchr(p, '/')); ++ p) {
+		*p = '_';
+	}
+
+	if (!(*priv = ll_shm_create(file, size))) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Copy message to ring
+ * @param [in] s pointer to ring
+ * @param [in] name namespace of message
+ * @param [in] level logging level of message
+ * @param [in] msg message
+ * @param [in] len length of message
+ * @param [in] fields binary fields of structured message (can be NULL)
+ * @param [in] fields_len size of fields
+ * @return on success, zero is returned
+ * @retval -1 message was dropped
+ *
+ * Fields are dropped and message is truncated, if they don't fit into
+ * ring. Message has timestamp of logging, collector writes it later.
+ */
+static int shmlog_put(struct ll_shm *s, const char *name,
+	enum ll_level level, const char *msg, size_t len, const char *fields,
+	size_t fields_len) {
+	unsigned char hdr[LL_SHM_HDR];
+	uint64_t ts = ll_clock_now(LL_TS_NSEC);
+	size_t name_len = strlen(name) + 1;
+	size_t max = ll_shm_max(s);
+
+	memcpy(hdr, &ts, sizeof(ts));
+	hdr[8] = level;
+
+	if (LL_SHM_HDR + name_len + len + 1 + fields_len > max) {
+		fields_len = 0;
+
+		if (LL_SHM_HDR + name_len + 1 > max) {
+			return (-1);
+		}
+
+		if (LL_SHM_HDR + name_len + len + 1 > max) {
+			len = max - LL_SHM_HDR - name_len - 1;
+		}
+	}
+
+	struct iovec iov[] = {
+		{ hdr, sizeof(hdr) },
+		{ (void *)name, name_len },
+		{ (void *)msg, len },
+		{ "", 1 },
+		{ (void *)fields, fields_len },
+	};
+
+	ll_record_bytes += LL_SHM_HDR + name_len + len + 1 + fields_len;
+
+	return (ll_shm_put(s, iov, countof(iov)));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Copy message to ring
+ * @copydetails ll_pr_cb_t
+ */
+static int shmlog_pr(void *priv, const char *name, enum ll_level level,
+	const char *format, va_list args) {
+	assert(priv);
+	assert(name);
+	assert(format);
+
+	const char *msg;
+	size_t len;
+
+	/* message can be formatted already by other logger of namespace */
+	if (ll_record_msg(&msg, &len, format, args)) {
+		return (-1);
+	}
+
+	return (shmlog_put(priv, name, level, msg, len, NULL, 0));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Copy structured message to ring
+ * @copydetails ll_kv_cb_t
+ */
+static int shmlog_kv(void *priv, const char *name, enum ll_level level,
+	const char *msg, const char *fields, size_t len) {
+	assert(priv);
+	assert(name);
+	assert(msg);
+
+	return (shmlog_put(priv, name, level, msg, strlen(msg), fields, len));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Wait for collector
+ * @copydetails ll_flush_cb_t
+ */
+static int shmlog_flush(void *priv)
+{
+	return (ll_shm_flush(priv));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Unmap ring, collector takes the rest of messages
+ * @copydetails ll_close_cb_t
+ */
+static int shmlog_close(void *priv)
+{
+	ll_shm_close(priv, 0);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_logger_shm(void)
+{
+	const struct ll_logger cbs = {
+		.name = "shm",
+		.open_cb = shmlog_open,
+		.pr_cb = shmlog_pr,
+		.flush_cb = shmlog_flush,
+		.close_cb = shmlog_close,
+		.kv_cb = shmlog_kv,
+		.kv_enc = LL_KV_BINARY,
+	};
+
+	return (ll_logger_custom(&cbs));
+}
@@ -0,0 +1,319 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libtools/tools.h>
+#include <libtools/url.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/syslog.h"
+#include "../clock.h"
+#include "../dgram.h"
+#include "../query.h"
+#include "../record.h"
+
+/*------------------------------------------------------------------------*/
+
+/** default path of syslog socket */
+#define SYSLOG_PATH "/dev/log"
+
+/** default number of queued messages */
+#define SYSLOG_QUEUE 1024
+
+/** default maximum size of message */
+#define SYSLOG_SIZE 2048
+
+/** size of buffer for priority and timestamp */
+#define SYSLOG_PREFIX_MAX 40
+
+/** Private data of syslog logger */
+struct slog {
+	/** datagram sink */
+	struct ll_dgram *d;
+
+	/** facility code */
+	int facility;
+
+	/** length of header */
+	int hdr_len;
+
+	/** constant part of header: " HOSTNAME APP-NAME PROCID MSGID - " */
+	char hdr[];
+};
+
+/*------------------------------------------------------------------------*/
+
+/** date and time of current second, cached by calling thread */
+static __thread struct {
+	/** second since Epoch */
+	uint64_t sec;
+
+	/** "YYYY-MM-DDTHH:MM:SS" */
+	char text[20];
+} syslog_date;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Render priority, version and timestamp of message
+ * @param [out] buf buffer, at least @ref SYSLOG_PREFIX_MAX bytes
+ * @param [in] pri priority of message
+ * @param [in] ts number of nanoseconds since Epoch
+ * @return length of text
+ */
+static size_t syslog_prefix(char *buf, unsigned pri, uint64_t ts)
+{
+	uint64_t sec = ts / 1000000000;
+	uint32_t usec = ts % 1000000000 / 1000;
+	char *p = buf;
+
+	if (!syslog_date.text[0] || syslog_date.sec != sec) {
+		time_t t = sec;
+		struct tm tm;
+
+		gmtime_r(&t, &tm);
+		strftime(syslog_date.text, sizeof(syslog_date.text),
+			"%Y-%m-%dT%H:%M:%S", &tm);
+		syslog_date.sec = sec;
+	}
+
+	*p ++ = '<';
+
+	if (pri >= 100) {
+		*p ++ = '0' + pri / 100;
+	}
+
+	if (pri >= 10) {
+		*p ++ = '0' + pri / 10 % 10;
+	}
+
+	*p ++ = '0' + pri % 10;
+	memcpy(p, ">1 ", 3);
+	p += 3;
+	memcpy(p, syslog_date.text, sizeof(syslog_date.text) - 1);
+	p += sizeof(syslog_date.text) - 1;
+	*p ++ = '.';
+
+	for (int i = 5; i >= 0; -- i, usec /= 10) {
+		p[i] = '0' + usec % 10;
+	}
+
+	p += 6;
+	*p ++ = 'Z';
+
+	return (p - buf);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Copy header field, as RFC 5424 allows it
+ * @param [out] dst buffer, at least @p max + 1 bytes
+ * @param [in] s value of field
+ * @param [in] max maximum length of field
+ *
+ * Only printable ASCII characters are kept, empty field is "-".
+ */
+static void syslog_token(char *dst, const char *s, size_t max)
+{
+	char *p = dst;
+
+	for (; *s && (size_t)(p - dst) < max; ++ s) {
+		if (*s > ' ' && *s <= '~') {
+			*p ++ = *s;
+		}
+	}
+
+	if (p == dst) {
+		*p ++ = '-';
+	}
+
+	*p = '\0';
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Connect to syslog socket
+ * @copydetails ll_open_cb_t
+ */
+static int syslog_open(const char *name, enum ll_level level, struct url *u,
+	void **priv) {
+	static const char * const keys[] = {
+		"facility", "ident", "queue", "size", NULL
+	};
+
+	unused(level);
+
+	assert(name);
+	assert(u);
+
+	if (u->username ||
+		u->password ||
+		u->hostname ||
+		u->port ||
+		ll_query_check(u->query, keys) ||
+		u->fragment) {
+		return (-1);
+	}
+
+	size_t queue = SYSLOG_QUEUE;
+	size_t size = SYSLOG_SIZE;
+	int facility = 1;
+	char ident[64];
+
+	if (ll_query_facility(u->query, "facility", &facility) ||
+		ll_query_num(u->query, "queue", &queue) ||
+		ll_query_num(u->query, "size", &size) ||
+		ll_query_get(u->query, "ident", ident, sizeof(ident)) ||
+		!queue || !size) {
+		return (-1);
+	}
+
+	char raw[256], host[256], app[49], msgid[33];
+
+	if (gethostname(raw, sizeof(raw))) {
+		raw[0] = '\0';
+	}
+
+	raw[sizeof(raw) - 1] = '\0';
+	syslog_token(host, raw, sizeof(host) - 1);
+
+	if (!*ident) {
+		snprintf(ident, sizeof(ident), "%s", program_invocation_short_name);
+	}
+
+	syslog_token(app, ident, sizeof(app) - 1);
+	syslog_token(msgid, name, sizeof(msgid) - 1);
+
+	/* header is constant for namespace */
+	int len = snprintf(NULL, 0, " %s %s %d %s - ", host, app, getpid(),
+		msgid);
+	struct slog *s = malloc(sizeof(*s) + len + 1);
+
+	if (!s) {
+		return (-1);
+	}
+
+	s->facility = facility;
+	s->hdr_len = len;
+	snprintf(s->hdr, len + 1, " %s %s %d %s - ", host, app, getpid(), msgid);
+
+	if (!(s->d = ll_dgram_open(u->path && *u->path ? u->path : SYSLOG_PATH,
+		queue, size))) {
+		free(s);
+
+		return (-1);
+	}
+
+	*priv = s;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Queue message to syslog
+ * @copydetails ll_pr_cb_t
+ */
+static int syslog_pr(void *priv, const char *name, enum ll_level level,
+	const char *format, va_list args) {
+	assert(priv);
+	assert(name);
+	assert(format);
+
+	const struct slog *s = priv;
+	char prefix[SYSLOG_PREFIX_MAX];
+	const char *msg;
+	size_t len;
+
+	unused(name);
+
+	/* message can be formatted already by other logger of namespace */
+	if (ll_record_msg(&msg, &len, format, args)) {
+		return (-1);
+	}
+
+	struct iovec iov[] = {
+		{ prefix, syslog_prefix(prefix, s->facility * 8 + level,
+			ll_clock_now(LL_TS_USEC)) },
+		{ (void *)s->hdr, s->hdr_len },
+		{ (void *)msg, len },
+	};
+
+	ll_record_bytes += iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+	return (ll_dgram_put(s->d, iov, countof(iov), 1));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Send queued messages to syslog
+ * @copydetails ll_flush_cb_t
+ */
+static int syslog_flush(void *priv)
+{
+	const struct slog *s = priv;
+
+	return (ll_dgram_flush(s->d));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Close syslog socket
+ * @copydetails ll_close_cb_t
+ */
+static int syslog_close(void *priv)
+{
+	struct slog *s = priv;
+
+	if (!s) {
+		return (0);
+	}
+
+	ll_dgram_close(s->d);
+	free(s);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_logger_syslog(void)
+{
+	const struct ll_logger cbs = {
+		.name = "syslog",
+		.open_cb = syslog_open,
+		.pr_cb = syslog_pr,
+		.flush_cb = syslog_flush,
+		.close_cb = syslog_close,
+	};
+
+	return (ll_logger_custom(&cbs));
+}
@@ -1,16 +1,187 @@
 #include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <libtools/list.h>
 #include <libtools/string.h>
 #include "namespace.h"
 
+#include "dedup.h"
+#include "format.h"
+#include "kv.h"
 #include "logger.h"
-#include "stderr.h"
+#include "query.h"
+#include "rate.h"
+#include "record.h"
+#include "sample.h"
+#include "stats.h"
 
 /*------------------------------------------------------------------------*/
 
-static struct list namespaces = list_initializer(&namespaces);
+/** initial number of slots in namespaces hash table */
+#define LL_NS_TABLE_SIZE 64
+
+/**
+ * @brief Open addressing hash table of namespaces
+ *
+ * Slots are only filled, never cleared, so readers may probe it without
+ * any locking. When table becomes too full, it replaced by bigger copy
+ * and old one is chained to it until ll_ns_free().
+ */
+struct ns_table {
+	/** previous (retired) table */
+	struct ns_table *prev;
+
+	/** number of slots minus one */
+	size_t mask;
+
+	/** slots, NULL if empty */
+	struct ll_namespace *slot[];
+};
+
+/** Namespace, which loggers are being opened by current thread */
+struct ns_opening {
+	/** name of namespace */
+	const char *name;
+
+	/** namespace opened by outer call */
+	struct ns_opening *prev;
+};
+
+/*------------------------------------------------------------------------*/
+
+/** list of all namespaces, protected by @ref ns_lock */
+static struct list namespaces __attribute__((aligned(LL_CACHELINE))) =
+	list_initializer(&namespaces);
+
+/** serialize creation of namespaces */
+static pthread_mutex_t ns_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** current hash table, readers access it without locking */
+static struct ns_table *ns_table;
+
+/** number of namespaces in @ref ns_table */
+static size_t ns_count;
+
+/** call sites bound to namespaces, protected by @ref ns_lock */
+static struct ll_site *ns_sites;
+
+/** namespaces, which loggers are being opened by current thread */
+static __thread struct ns_opening *ns_opening;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Calculate hash of namespace name (FNV-1a)
+ * @param [in] name namespace
+ * @return hash value
+ */
+static uint32_t ll_ns_hash(const char *name)
+{
+	uint32_t h = 2166136261u;
+
+	while (*name) {
+		h ^= (unsigned char)*name ++;
+		h *= 16777619u;
+	}
+
+	return (h);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Look for namespace in hash table
+ * @param [in] t hash table (can be NULL)
+ * @param [in] name namespace
+ * @param [in] hash hash of namespace name
+ * @return pointer to namespace
+ * @retval NULL namespace not found
+ */
+static struct ll_namespace *ll_ns_find(const struct ns_table *t,
+	const char *name, uint32_t hash) {
+	assert(name);
+
+	if (!t) {
+		return (NULL);
+	}
+
+	for (size_t i = hash & t->mask;; i = (i + 1) & t->mask) {
+		struct ll_namespace *ns = __atomic_load_n(&t->slot[i],
+			__ATOMIC_ACQUIRE);
+
+		if (!ns) {
+			return (NULL);
+		}
+
+		if (ns->hash == hash && !strcmp(ns->name, name)) {
+			return (ns);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Put namespace into empty slot of hash table
+ * @param [in] t hash table
+ * @param [in] ns pointer to namespace
+ */
+static void ll_ns_place(struct ns_table *t, struct ll_namespace *ns)
+{
+	size_t i = ns->hash & t->mask;
+
+	while (t->slot[i]) {
+		i = (i + 1) & t->mask;
+	}
+
+	/* publish fully initialized namespace to readers */
+	__atomic_store_n(&t->slot[i], ns, __ATOMIC_RELEASE);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Make sure, hash table have a room for one more namespace
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Must be called with @ref ns_lock held.
+ */
+static int ll_ns_reserve(void)
+{
+	size_t size = ns_table ? ns_table->mask + 1 : 0;
+
+	/* keep load factor below 3/4 */
+	if ((ns_count + 1) * 4 <= size * 3) {
+		return (0);
+	}
+
+	size = size ? size * 2 : LL_NS_TABLE_SIZE;
+
+	struct ns_table *t = calloc(1, sizeof(*t) + size * sizeof(t->slot[0]));
+
+	if (!t) {
+		return (-1);
+	}
+
+	t->mask = size - 1;
+
+	if ((t->prev = ns_table)) {
+		for (size_t i = 0; i <= ns_table->mask; ++ i) {
+			if (ns_table->slot[i]) {
+				ll_ns_place(t, ns_table->slot[i]);
+			}
+		}
+	}
+
+	/* old table stays valid for readers which still probe it */
+	__atomic_store_n(&ns_table, t, __ATOMIC_RELEASE);
+
+	return (0);
+}
 
 /*------------------------------------------------------------------------*/
 
@@ -47,7 +218,7 @@ static int ll_ns_env(struct ll_namespace *ns)
 	}
 
 	/* logging level */
-	ns->level = atoi(env);
+	ns->base = ns->level = atoi(env);
 
 	/* URI */
 	const char *uri = strchr(env, ',');
@@ -58,17 +229,22 @@ static int ll_ns_env(struct ll_namespace *ns)
 	}
 
 	++ uri;
-	struct url *u;
+	struct ll_ns_opts opts;
+
+	ll_ns_opts_init(&opts);
 
-	if (!url_parse(uri, &u)) {
+	/* try to initialize loggers */
+	if (!(ns->sinks = ll_logger_open_all(uri, ns->name, ns->base, &opts))) {
 		return (-1);
 	}
 
-	/* try to initialize logger */
-	int rc = ll_logger_open(u, ns);
-	url_free(u);
+	ll_ns_opts_set(ns, &opts);
 
-	return (rc);
+	if (ns->sinks->level > ns->level) {
+		ns->level = ns->sinks->level;
+	}
+
+	return (0);
 }
 
 /*------------------------------------------------------------------------*/
@@ -76,26 +252,40 @@ static int ll_ns_env(struct ll_namespace *ns)
 /**
  * @brief Create new logging namespace
  * @param [in] name namespace
+ * @param [in] hash hash of namespace name
  * @return pointer to new namespace
  * @retval NULL error occurred
  */
-static struct ll_namespace *liblog_ns_new(const char *name)
+static struct ll_namespace *liblog_ns_new(const char *name, uint32_t hash)
 {
 	assert(name);
 
-	struct ll_namespace *ns = malloc(sizeof(*ns) + strlen(name) + 1);
+	struct ll_namespace *ns;
 
-	if (ns) {
-		strcpy(ns->name, name);
-		ns->level = _LIBLOG__LEVEL;
-
-		/* try to inherit settings from environment */
-		if (ll_ns_env(ns)) {
-			/* failed, set default logger */
-			ns->priv = NULL;
-			ns->pr_cb = ll_stderr_pr;
-			ns->close_cb = NULL;
-		}
+	if (posix_memalign((void **)&ns, LL_CACHELINE,
+		sizeof(*ns) + strlen(name) + 1)) {
+		return (NULL);
+	}
+
+	strcpy(ns->name, name);
+	ns->hash = hash;
+	ns->base = ns->level = _LIBLOG__LEVEL;
+	ns->sinks = NULL;
+	ns->stats = NULL;
+	memset(&ns->rate, 0, sizeof(ns->rate));
+	ns->dedup = 0;
+	ns->sample = 0;
+	ns->sample_level = LL_LEVEL_DEBUG;
+
+	struct ll_ns_opts opts;
+
+	/* try to inherit settings from environment */
+	if (ll_ns_env(ns) &&
+		!(ns->sinks = ll_logger_open_all("", name, ns->base, &opts))) {
+		/* failed, and even default logger is not available */
+		free(ns);
+
+		return (NULL);
 	}
 
 	return (ns);
@@ -107,18 +297,48 @@ struct ll_namespace *ll_ns_lookup(const char *name)
 {
 	assert(name);
 
+	uint32_t hash = ll_ns_hash(name);
 	struct ll_namespace *i;
 
-	/* look for namespace */
-	list_foreach(&namespaces, i, struct ll_namespace, list) {
-		if (!strcmp(i->name, name)) {
-			return (i);
+	/* fast path, without any locking */
+	i = ll_ns_find(__atomic_load_n(&ns_table, __ATOMIC_ACQUIRE), name, hash);
+
+	if (i) {
+		return (i);
+	}
+
+	/* logger logs to namespace, which it's opened for */
+	for (struct ns_opening *o = ns_opening; o; o = o->prev) {
+		if (!strcmp(o->name, name)) {
+			return (NULL);
 		}
 	}
 
-	/* create new one and add to the list */
-	if ((i = liblog_ns_new(name))) {
-		list_add_head(&namespaces, &i->list);
+	struct ns_opening self = { name, ns_opening };
+	struct ll_namespace *ns;
+
+	/* loggers are opened without the lock, they can log or take own locks */
+	ns_opening = &self;
+	ns = liblog_ns_new(name, hash);
+	ns_opening = self.prev;
+
+	pthread_mutex_lock(&ns_lock);
+
+	/* namespace can be created by another thread meanwhile */
+	if (!(i = ll_ns_find(ns_table, name, hash)) && ns && !ll_ns_reserve()) {
+		list_add_head(&namespaces, &ns->list);
+		ll_ns_place(ns_table, ns);
+		++ ns_count;
+		i = ns;
+		ns = NULL;
+	}
+
+	pthread_mutex_unlock(&ns_lock);
+
+	/* loser is closed without the lock as well */
+	if (ns) {
+		ll_sinks_free(ns->sinks);
+		free(ns);
 	}
 
 	return (i);
@@ -126,17 +346,633 @@ struct ll_namespace *ll_ns_lookup(const char *name)
 
 /*------------------------------------------------------------------------*/
 
+const enum ll_level *ll_site_bind(struct ll_site *site, const char *name)
+{
+	/* call site with unresolved namespace doesn't log anything */
+	static const enum ll_level invalid = LL_LEVEL_INVALID;
+
+	assert(site);
+	assert(name);
+
+	struct ll_namespace *ns = ll_ns_lookup(name);
+
+	if (!ns) {
+		return (&invalid);
+	}
+
+	pthread_mutex_lock(&ns_lock);
+
+	/* call site can be bound by another thread meanwhile */
+	if (!site->level) {
+		site->next = ns_sites;
+		ns_sites = site;
+		site->ns = ns;
+
+		__atomic_store_n(&site->level, &ns->level, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&ns_lock);
+
+	return (&ns->level);
+}
+
+/*------------------------------------------------------------------------*/
+
+const struct ll_fmt *ll_site_fmt(struct ll_site *site, const char *format)
+{
+	assert(site);
+	assert(format);
+
+	struct ll_fmt *fmt = __atomic_load_n(&site->fmt, __ATOMIC_ACQUIRE);
+
+	if (fmt || !(fmt = ll_fmt_parse(format))) {
+		return (fmt);
+	}
+
+	/* arguments don't match format string, so don't unpack them later */
+	if (site->args && !fmt->eager && ll_fmt_check(fmt, site->args)) {
+		fmt->eager = 1;
+	}
+
+	struct ll_fmt *prev = NULL;
+
+	/* format string can be parsed by another thread meanwhile */
+	if (!__atomic_compare_exchange_n(&site->fmt, &prev, fmt, 0,
+		__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		ll_fmt_free(fmt);
+		fmt = prev;
+	}
+
+	return (fmt);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass message to every logger of namespace, which wants it
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] format format string of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Should be called inside of epoch. Loggers share line rendered by
+ * the first of them, so message is formatted only once.
+ */
+static int ll_ns_pr_all(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *format, va_list args) {
+	const struct ll_sinks *sinks = __atomic_load_n(&ns->sinks,
+		__ATOMIC_ACQUIRE);
+	const struct ll_sink *sink = sinks->sink[0];
+
+	/* single logger without own level, it's checked at call time */
+	if (sinks->n == 1 && sink->level < 0) {
+		return (sink->pr_cb(sink->priv, ns->name, level, format, args));
+	}
+
+	int rc = 0;
+
+	ll_record_share(1);
+
+	for (size_t i = 0; i < sinks->n; ++ i) {
+		va_list ap;
+
+		sink = sinks->sink[i];
+
+		if (level > (sink->level < 0 ? base : sink->level)) {
+			continue;
+		}
+
+		va_copy(ap, args);
+
+		if (sink->pr_cb(sink->priv, ns->name, level, format, ap)) {
+			rc = -1;
+		}
+
+		va_end(ap);
+	}
+
+	ll_record_share(0);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass message to loggers of namespace and account it
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] format format string of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_ns_pr_stats(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *format, va_list args) {
+	uint64_t bytes = ll_record_bytes;
+	uint64_t start = ll_stats_start();
+
+	ll_epoch_enter();
+
+	int rc = ll_ns_pr_all(ns, level, base, format, args);
+
+	ll_epoch_exit();
+
+	ll_stats_latency(ns, start);
+	ll_stats_add(ns, level, LL_STAT_BYTES, ll_record_bytes - bytes);
+
+	if (rc) {
+		ll_stats_add(ns, level, LL_STAT_DROPPED, 1);
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass message to loggers of namespace, without collapsing
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] format format string of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_ns_pr_sink(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *format, va_list args) {
+	if (__atomic_load_n(&ll_stats_on, __ATOMIC_RELAXED)) {
+		return (ll_ns_pr_stats(ns, level, base, format, args));
+	}
+
+	ll_epoch_enter();
+
+	int rc = ll_ns_pr_all(ns, level, base, format, args);
+
+	ll_epoch_exit();
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass message to loggers of namespace, without collapsing
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] format format string of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_ns_pr_sinkf(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *format, ...) {
+	va_list ap;
+
+	va_start(ap, format);
+	int rc = ll_ns_pr_sink(ns, level, base, format, ap);
+	va_end(ap);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass message to loggers of namespace, collapse its duplicates
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] format format string of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_ns_pr_dedup(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *format, va_list args) {
+	struct ll_dedup_repeat repeat;
+	const char *body;
+	int rc = ll_dedup(ns, level, format, args, &body, &repeat);
+
+	if (repeat.n) {
+		ll_ns_pr_sinkf(repeat.ns, repeat.level, repeat.ns == ns ? base :
+			__atomic_load_n(&repeat.ns->base, __ATOMIC_RELAXED),
+			"last message repeated %" PRIu64 " times", repeat.n);
+	}
+
+	if (rc <= 0) {
+		return (rc);
+	}
+
+	/* message is formatted already */
+	return (ll_ns_pr_sinkf(ns, level, base, "%s", body));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_ns_pr(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *format, va_list args) {
+	assert(ns);
+	assert(format);
+
+	if (__atomic_load_n(&ns->dedup, __ATOMIC_RELAXED)) {
+		return (ll_ns_pr_dedup(ns, level, base, format, args));
+	}
+
+	return (ll_ns_pr_sink(ns, level, base, format, args));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass structured message to logger as text
+ * @param [in] sink pointer to logger
+ * @param [in] name namespace of message
+ * @param [in] level logging level of message
+ * @param [in] format format of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_ns_kv_text(const struct ll_sink *sink, const char *name,
+	enum ll_level level, const char *format, ...) {
+	va_list ap;
+
+	va_start(ap, format);
+	int rc = sink->pr_cb(sink->priv, name, level, format, ap);
+	va_end(ap);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass structured message to every logger, which wants it
+ * @param [in] ns pointer to namespace
+ * @param [in] name namespace of message, given to loggers
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] msg message
+ * @param [in] kv fields of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Should be called inside of epoch. Every encoding of fields is made
+ * once, and text loggers share line rendered by the first of them.
+ */
+static int ll_ns_kv_all(struct ll_namespace *ns, const char *name,
+	enum ll_level level, enum ll_level base, const char *msg,
+	const struct ll_kv *kv) {
+	const struct ll_sinks *sinks = __atomic_load_n(&ns->sinks,
+		__ATOMIC_ACQUIRE);
+	int rc = 0;
+
+	ll_kv_reset();
+	ll_record_share(1);
+
+	for (size_t i = 0; i < sinks->n; ++ i) {
+		const struct ll_sink *sink = sinks->sink[i];
+		const char *data;
+		size_t len;
+
+		if (level > (sink->level < 0 ? base : sink->level)) {
+			continue;
+		}
+
+		if (ll_kv_get(kv, sink->kv_cb ? sink->kv_enc : LL_KV_LOGFMT,
+			&data, &len)) {
+			rc = -1;
+
+			continue;
+		}
+
+		if (sink->kv_cb ?
+			sink->kv_cb(sink->priv, name, level, msg, data, len) :
+			ll_ns_kv_text(sink, name, level, len ? "%s %.*s" : "%s",
+			msg, (int)len, data)) {
+			rc = -1;
+		}
+	}
+
+	ll_record_share(0);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_ns_kv(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *msg, const struct ll_kv *kv) {
+	assert(ns);
+	assert(msg);
+	assert(kv);
+
+	if (!__atomic_load_n(&ll_stats_on, __ATOMIC_RELAXED)) {
+		ll_epoch_enter();
+
+		int rc = ll_ns_kv_all(ns, ns->name, level, base, msg, kv);
+
+		ll_epoch_exit();
+
+		return (rc);
+	}
+
+	uint64_t bytes = ll_record_bytes;
+	uint64_t start = ll_stats_start();
+
+	ll_epoch_enter();
+
+	int rc = ll_ns_kv_all(ns, ns->name, level, base, msg, kv);
+
+	ll_epoch_exit();
+
+	ll_stats_latency(ns, start);
+	ll_stats_add(ns, level, LL_STAT_BYTES, ll_record_bytes - bytes);
+
+	if (rc) {
+		ll_stats_add(ns, level, LL_STAT_DROPPED, 1);
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_ns_relay(struct ll_namespace *ns, const char *name,
+	enum ll_level level, const char *msg, const struct ll_kv *kv) {
+	assert(ns);
+	assert(name);
+	assert(msg);
+	assert(kv);
+
+	ll_epoch_enter();
+
+	int rc = ll_ns_kv_all(ns, name, level,
+		__atomic_load_n(&ns->base, __ATOMIC_RELAXED), msg, kv);
+
+	ll_epoch_exit();
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_ns_flush(struct ll_namespace *ns)
+{
+	assert(ns);
+
+	int rc = 0;
+
+	ll_epoch_enter();
+
+	const struct ll_sinks *sinks = __atomic_load_n(&ns->sinks,
+		__ATOMIC_ACQUIRE);
+
+	for (size_t i = 0; i < sinks->n; ++ i) {
+		const struct ll_sink *sink = sinks->sink[i];
+
+		if (sink->flush_cb && sink->flush_cb(sink->priv)) {
+			rc = -1;
+		}
+	}
+
+	ll_epoch_exit();
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_ns_flush_all(void)
+{
+	struct ll_namespace *i;
+	int rc = 0;
+
+	pthread_mutex_lock(&ns_lock);
+
+	list_foreach(&namespaces, i, struct ll_namespace, list) {
+		if (ll_ns_flush(i)) {
+			rc = -1;
+		}
+	}
+
+	pthread_mutex_unlock(&ns_lock);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_ns_opts_init(struct ll_ns_opts *opts)
+{
+	assert(opts);
+
+	opts->rate = 0;
+	opts->burst = 0;
+	opts->dedup = 0;
+	opts->sample = 0;
+	opts->sample_level = LL_LEVEL_DEBUG;
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_ns_opts_parse(const char *query, struct ll_ns_opts *opts)
+{
+	assert(opts);
+
+	if (ll_query_num(query, "rate", &opts->rate) ||
+		ll_query_num(query, "burst", &opts->burst) ||
+		ll_query_num(query, "dedup", &opts->dedup) ||
+		ll_query_level(query, "sample_level", &opts->sample_level) ||
+		opts->rate > UINT32_MAX || opts->burst > UINT32_MAX) {
+		return (-1);
+	}
+
+	char val[32];
+
+	if (ll_query_get(query, "sample", val, sizeof(val)) ||
+		(*val && ll_sample_parse(val, &opts->sample))) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_ns_opts_set(struct ll_namespace *ns, const struct ll_ns_opts *opts)
+{
+	assert(ns);
+	assert(opts);
+
+	ll_rate_set(&ns->rate, opts->rate, opts->burst);
+	__atomic_store_n(&ns->dedup, !!opts->dedup, __ATOMIC_RELAXED);
+	__atomic_store_n(&ns->sample_level, opts->sample_level,
+		__ATOMIC_RELAXED);
+	__atomic_store_n(&ns->sample, opts->sample, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_ns_foreach(int (*cb)(struct ll_namespace *ns, void *priv), void *priv)
+{
+	assert(cb);
+
+	struct ll_namespace *i;
+	int rc = 0;
+
+	pthread_mutex_lock(&ns_lock);
+
+	list_foreach(&namespaces, i, struct ll_namespace, list) {
+		if ((rc = cb(i, priv))) {
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&ns_lock);
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free retired loggers
+ * @param [in] node node of loggers
+ */
+static void ll_sinks_retired(struct ll_epoch_node *node)
+{
+	ll_sinks_free((struct ll_sinks *)node);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_ns_sinks_set(struct ll_namespace *ns, struct ll_sinks *sinks)
+{
+	assert(ns);
+	assert(sinks);
+
+	struct ll_sinks *old = __atomic_exchange_n(&ns->sinks, sinks,
+		__ATOMIC_ACQ_REL);
+
+	ll_epoch_retire(&old->node, ll_sinks_retired);
+}
+
+/*------------------------------------------------------------------------*/
+
+enum ll_level ll_ns_level_set(struct ll_namespace *ns, enum ll_level level)
+{
+	assert(ns);
+
+	enum ll_level ret = __atomic_exchange_n(&ns->base, level,
+		__ATOMIC_RELAXED);
+
+	/* loggers can be replaced and reclaimed meanwhile */
+	ll_epoch_enter();
+
+	const struct ll_sinks *sinks = __atomic_load_n(&ns->sinks,
+		__ATOMIC_ACQUIRE);
+
+	/* loggers with own level are fed by logging macros too */
+	if (sinks->level > level) {
+		level = sinks->level;
+	}
+
+	ll_epoch_exit();
+
+	__atomic_store_n(&ns->level, level, __ATOMIC_RELAXED);
+
+	return (ret);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_sink_free(struct ll_sink *sink)
+{
+	if (!sink) {
+		return;
+	}
+
+	if (sink->close_cb) {
+		sink->close_cb(sink->priv);
+	}
+
+	free(sink);
+}
+
+/*------------------------------------------------------------------------*/
+
+struct ll_sinks *ll_sinks_new(size_t n)
+{
+	struct ll_sinks *sinks = malloc(sizeof(*sinks) +
+		n * sizeof(sinks->sink[0]));
+
+	if (sinks) {
+		sinks->level = LL_LEVEL_INVALID;
+		sinks->n = 0;
+	}
+
+	return (sinks);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_sinks_free(struct ll_sinks *sinks)
+{
+	if (!sinks) {
+		return;
+	}
+
+	for (size_t i = 0; i < sinks->n; ++ i) {
+		ll_sink_free(sinks->sink[i]);
+	}
+
+	free(sinks);
+}
+
+/*------------------------------------------------------------------------*/
+
 void ll_ns_free(void)
 {
 	struct ll_namespace *i, *tmp;
 
+	pthread_mutex_lock(&ns_lock);
+
+	/* forget cached namespaces, they will be freed now */
+	while (ns_sites) {
+		struct ll_site *site = ns_sites;
+
+		ns_sites = site->next;
+		site->next = NULL;
+		site->ns = NULL;
+		ll_fmt_free(site->fmt);
+		site->fmt = NULL;
+		__atomic_store_n(&site->level, NULL, __ATOMIC_RELAXED);
+	}
+
+	/* close replaced loggers, which were not closed yet */
+	ll_epoch_free();
+
 	list_foreach_safe(&namespaces, i, tmp, struct ll_namespace, list) {
 		list_del_node(&i->list);
+		ll_sinks_free(i->sinks);
+		free(i->stats);
+		free(i);
+	}
 
-		if (i->close_cb) {
-			i->close_cb(i->priv);
-		}
+	while (ns_table) {
+		struct ns_table *t = ns_table;
 
-		free(i);
+		ns_table = t->prev;
+		free(t);
 	}
+
+	ns_count = 0;
+
+	pthread_mutex_unlock(&ns_lock);
 }
@@ -20,38 +20,297 @@
 #ifndef __LIBLOG_NAMESPACE_H
 #define __LIBLOG_NAMESPACE_H
 
+#include <stdarg.h>
+#include <stdint.h>
 #include <liblog/types.h>
 #include <libtools/list.h>
 
-/** Namespace structure */
-struct ll_namespace {
-	/** list node */
-	struct list list;
+#include "epoch.h"
+
+/** statistics of namespace, see stats.h */
+struct ll_stats_shard;
 
-	/** pointer to private data of logger used in this namespace */
+/** fields of structured message, see kv.h */
+struct ll_kv;
+
+/** size of CPU cache line */
+#define LL_CACHELINE 64
+
+/** Logger opened for namespace */
+struct ll_sink {
+	/** pointer to private data of logger */
 	void *priv;
 
 	/** @copydoc ll_pr_cb_t */
 	ll_pr_cb_t pr_cb;
 
+	/** @copydoc ll_flush_cb_t */
+	ll_flush_cb_t flush_cb;
+
 	/** @copydoc ll_close_cb_t */
 	ll_close_cb_t close_cb;
 
-	/** current logging level for this namespace */
+	/** @copydoc ll_kv_cb_t */
+	ll_kv_cb_t kv_cb;
+
+	/** encoding of fields passed to @ref kv_cb */
+	enum ll_kv_enc kv_enc;
+
+	/**
+	 * least severe level of messages, given by "level" option,
+	 * LL_LEVEL_INVALID to follow level of namespace
+	 */
+	enum ll_level level;
+};
+
+/**
+ * @brief Loggers of namespace
+ *
+ * Array is immutable, reconfiguration replaces it by new one.
+ * Old loggers are closed, when all writers finished with them.
+ */
+struct ll_sinks {
+	/** reclamation of retired loggers */
+	struct ll_epoch_node node;
+
+	/** least severe level of loggers, LL_LEVEL_INVALID if not given */
 	enum ll_level level;
 
+	/** number of loggers */
+	size_t n;
+
+	/** loggers */
+	struct ll_sink *sink[];
+};
+
+/** Namespace structure */
+struct ll_namespace {
+	/**
+	 * list node, it's first, so list head aligned like namespace
+	 * converts to aligned pointer by list_foreach()
+	 */
+	struct list list __attribute__((aligned(LL_CACHELINE)));
+
+	/**
+	 * current logging level for this namespace,
+	 * read by logging macros directly, so keep it on own cache line
+	 */
+	enum ll_level level __attribute__((aligned(LL_CACHELINE)));
+
+	/** loggers of this namespace, replaced atomically by ll_setup() */
+	struct ll_sinks *sinks;
+
+	/**
+	 * logging level given by ll_setup() or ll_level_set(),
+	 * @ref level can be less severe to feed loggers with own level
+	 */
+	enum ll_level base;
+
+	/** shards of statistics, allocated by first counted message */
+	struct ll_stats_shard *stats;
+
+	/** rate limit of messages */
+	struct ll_rate rate;
+
+	/** non-zero, if consecutive duplicates are collapsed */
+	int dedup;
+
+	/** threshold of sampling, zero if all messages are kept */
+	uint64_t sample;
+
+	/** messages of this level and below in severity are sampled */
+	enum ll_level sample_level;
+
+	/** hash of namespace name */
+	uint32_t hash;
+
 	/** name of namespace */
 	char name[];
 };
 
+/**
+ * @brief Options of namespace, given by URI query of any logger
+ *
+ * Keys are listed in @ref ll_query_common.
+ */
+struct ll_ns_opts {
+	/** "rate", messages per second, zero if unlimited */
+	size_t rate;
+
+	/** "burst", number of messages allowed at once, zero for rate */
+	size_t burst;
+
+	/** "dedup", non-zero to collapse consecutive duplicates */
+	size_t dedup;
+
+	/** "sample", threshold parsed by ll_sample_parse() */
+	uint64_t sample;
+
+	/** "sample_level", most severe level, which is sampled */
+	enum ll_level sample_level;
+};
+
 /**
  * @brief Return pointer to liblog namespace
+ *
+ * Namespace is created on first lookup. Lookup of existing namespace
+ * doesn't take any locks, so it's safe and cheap to call it concurrently.
+ *
  * @param [in] ns namespace
  * @return pointer to liblog namespace @sa liblog_ns
  * @retval NULL error occurred
  */
 struct ll_namespace *ll_ns_lookup(const char *ns);
 
+/**
+ * @brief Return parsed format string of call site
+ * @param [in] site pointer to bound call site
+ * @param [in] format format string of call site
+ * @return pointer to parsed format string
+ * @retval NULL error occurred
+ */
+const struct ll_fmt *ll_site_fmt(struct ll_site *site, const char *format);
+
+/**
+ * @brief Pass message to loggers of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] format format string of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Loggers without own level take message, if @p level fits @p base.
+ * Loggers can be replaced concurrently, old ones are closed after return.
+ */
+int ll_ns_pr(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *format, va_list args
+);
+
+/**
+ * @brief Pass structured message to loggers of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] base logging level of namespace, when message was logged
+ * @param [in] msg message
+ * @param [in] kv fields of message
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Loggers without @ref ll_sink.kv_cb take message with fields appended
+ * in logfmt encoding. Duplicates of structured messages aren't collapsed.
+ */
+int ll_ns_kv(struct ll_namespace *ns, enum ll_level level,
+	enum ll_level base, const char *msg, const struct ll_kv *kv
+);
+
+/**
+ * @brief Pass message of other process to loggers of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] name namespace of message, given to loggers
+ * @param [in] level logging level of message
+ * @param [in] msg message
+ * @param [in] kv fields of message, can be empty
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Used by collector of shm: rings, message was filtered by its process.
+ */
+int ll_ns_relay(struct ll_namespace *ns, const char *name,
+	enum ll_level level, const char *msg, const struct ll_kv *kv
+);
+
+/**
+ * @brief Flush logger of namespace
+ * @param [in] ns pointer to namespace
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_ns_flush(struct ll_namespace *ns);
+
+/**
+ * @brief Flush loggers of all namespaces
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_ns_flush_all(void);
+
+/**
+ * @brief Set default options of namespace
+ * @param [out] opts options of namespace
+ */
+void ll_ns_opts_init(struct ll_ns_opts *opts);
+
+/**
+ * @brief Parse options of namespace
+ * @param [in] query query of URI (can be NULL)
+ * @param [in,out] opts parsed options, missing ones are untouched
+ * @return on success, zero is returned
+ * @retval -1 invalid value found
+ *
+ * Options can be given by query of any logger of namespace.
+ */
+int ll_ns_opts_parse(const char *query, struct ll_ns_opts *opts);
+
+/**
+ * @brief Apply options to namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] opts options of namespace
+ */
+void ll_ns_opts_set(struct ll_namespace *ns, const struct ll_ns_opts *opts);
+
+/**
+ * @brief Call routine for every namespace
+ * @param [in] cb routine, non-zero result stops iteration
+ * @param [in] priv private data of routine
+ * @return result of last call of routine
+ *
+ * Namespaces can't be created by routine.
+ */
+int ll_ns_foreach(int (*cb)(struct ll_namespace *ns, void *priv), void *priv);
+
+/**
+ * @brief Replace loggers of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] sinks new loggers of namespace
+ *
+ * Old loggers are closed, when all writers finished with them.
+ * Logging level of namespace is updated by ll_ns_level_set().
+ */
+void ll_ns_sinks_set(struct ll_namespace *ns, struct ll_sinks *sinks);
+
+/**
+ * @brief Set logging level of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level
+ * @return previous logging level
+ *
+ * Level checked by logging macros is the least severe one of @p level
+ * and levels of loggers, so messages reach loggers, which want them.
+ */
+enum ll_level ll_ns_level_set(struct ll_namespace *ns, enum ll_level level);
+
+/**
+ * @brief Close logger and free sink
+ * @param [in] sink sink of namespace (can be NULL)
+ */
+void ll_sink_free(struct ll_sink *sink);
+
+/**
+ * @brief Allocate empty array of loggers
+ * @param [in] n number of loggers
+ * @return pointer to array, free it by ll_sinks_free()
+ * @retval NULL error occurred
+ */
+struct ll_sinks *ll_sinks_new(size_t n);
+
+/**
+ * @brief Close loggers and free array
+ * @param [in] sinks loggers of namespace (can be NULL)
+ */
+void ll_sinks_free(struct ll_sinks *sinks);
+
 /** Cleanup all namespaces */
 void ll_ns_free(void);
 
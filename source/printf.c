@@ -0,0 +1,536 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "printf.h"
+
+/*------------------------------------------------------------------------*/
+
+/** left justify */
+#define LL_PF_LEFT 0x01
+
+/** pad by zeroes */
+#define LL_PF_ZERO 0x02
+
+/** print plus for positive numbers */
+#define LL_PF_PLUS 0x04
+
+/** print space for positive numbers */
+#define LL_PF_SPACE 0x08
+
+/** maximal length of formatted 64-bit number */
+#define LL_PF_NUM_MAX 24
+
+/** Length modifier of conversion */
+enum ll_pf_len {
+	LL_PF_HH,
+	LL_PF_H,
+	LL_PF_NONE,
+	LL_PF_L,
+	LL_PF_LL,
+	LL_PF_J,
+	LL_PF_Z,
+	LL_PF_T,
+};
+
+/** Conversion specification */
+struct ll_pf_spec {
+	/** LL_PF_* flags */
+	unsigned flags;
+
+	/** minimal width */
+	int width;
+
+	/** precision, -1 if not set */
+	int prec;
+
+	/** length modifier */
+	enum ll_pf_len len;
+};
+
+/*------------------------------------------------------------------------*/
+
+/** decimal digits of numbers from 00 to 99 */
+static const char ll_pf_digits[200] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Convert number to decimal digits
+ * @param [in] end end of buffer for digits
+ * @param [in] v number
+ * @return pointer to first digit
+ */
+static char *ll_pf_dec(char *end, uint64_t v)
+{
+	char *p = end;
+
+	/* two digits per division */
+	while (v > UINT32_MAX) {
+		unsigned i = (v % 100) * 2;
+
+		v /= 100;
+		p -= 2;
+		p[0] = ll_pf_digits[i];
+		p[1] = ll_pf_digits[i + 1];
+	}
+
+	/* 32-bit division is much cheaper */
+	uint32_t w = v;
+
+	while (w >= 100) {
+		unsigned i = (w % 100) * 2;
+
+		w /= 100;
+		p -= 2;
+		p[0] = ll_pf_digits[i];
+		p[1] = ll_pf_digits[i + 1];
+	}
+
+	if (w >= 10) {
+		p -= 2;
+		p[0] = ll_pf_digits[w * 2];
+		p[1] = ll_pf_digits[w * 2 + 1];
+	} else {
+		*-- p = '0' + w;
+	}
+
+	return (p);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Convert number to hexadecimal digits
+ * @param [in] end end of buffer for digits
+ * @param [in] v number
+ * @param [in] upper use upper case letters
+ * @return pointer to first digit
+ */
+static char *ll_pf_hex(char *end, uint64_t v, int upper)
+{
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char *p = end;
+
+	do {
+		*-- p = digits[v & 0xf];
+		v >>= 4;
+	} while (v);
+
+	return (p);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Append padded field to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] s spec of conversion
+ * @param [in] prefix sign or "0x"
+ * @param [in] plen length of prefix
+ * @param [in] zeroes count of zeroes between prefix and data
+ * @param [in] data data of field
+ * @param [in] n length of data
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_pf_put(struct ll_buf *b, const struct ll_pf_spec *s,
+	const char *prefix, size_t plen, size_t zeroes, const char *data,
+	size_t n) {
+	size_t total = plen + zeroes + n;
+	size_t pad = 0;
+
+	if ((size_t)s->width > total) {
+		pad = s->width - total;
+
+		/* zero padding is ignored for left justification and precision */
+		if ((s->flags & (LL_PF_ZERO | LL_PF_LEFT)) == LL_PF_ZERO &&
+			s->prec < 0) {
+			zeroes += pad;
+			pad = 0;
+		}
+	}
+
+	if (ll_buf_reserve(b, plen + zeroes + n + pad + 1)) {
+		return (-1);
+	}
+
+	char *p = b->data + b->len;
+
+	if (!(s->flags & LL_PF_LEFT)) {
+		memset(p, ' ', pad);
+		p += pad;
+	}
+
+	memcpy(p, prefix, plen);
+	p += plen;
+	memset(p, '0', zeroes);
+	p += zeroes;
+	memcpy(p, data, n);
+	p += n;
+
+	if (s->flags & LL_PF_LEFT) {
+		memset(p, ' ', pad);
+		p += pad;
+	}
+
+	b->len = p - b->data;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Append formatted integer to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] s spec of conversion
+ * @param [in] v absolute value of number
+ * @param [in] neg number is negative
+ * @param [in] conv conversion character
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_pf_int(struct ll_buf *b, const struct ll_pf_spec *s,
+	uint64_t v, int neg, char conv) {
+	char buf[LL_PF_NUM_MAX];
+	char *end = buf + sizeof(buf);
+	const char *prefix = "";
+	size_t plen = 0;
+	char *p;
+
+	if (conv == 'x' || conv == 'X') {
+		p = ll_pf_hex(end, v, conv == 'X');
+	} else {
+		p = ll_pf_dec(end, v);
+
+		if (neg) {
+			prefix = "-";
+			plen = 1;
+		} else if (conv != 'u' && (s->flags & LL_PF_PLUS)) {
+			prefix = "+";
+			plen = 1;
+		} else if (conv != 'u' && (s->flags & LL_PF_SPACE)) {
+			prefix = " ";
+			plen = 1;
+		}
+	}
+
+	size_t n = end - p;
+
+	/* zero with zero precision has no digits */
+	if (!s->prec && !v) {
+		n = 0;
+	}
+
+	size_t zeroes = s->prec > (int)n ? s->prec - n : 0;
+
+	return (ll_pf_put(b, s, prefix, plen, zeroes, p, n));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Parse decimal number of format string
+ * @param [in,out] p position in format string
+ * @return parsed number
+ */
+static int ll_pf_num(const char **p)
+{
+	int n = 0;
+
+	while (**p >= '0' && **p <= '9') {
+		n = n * 10 + (*(*p) ++ - '0');
+	}
+
+	return (n);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Format string by own code
+ * @param [in] b pointer to buffer
+ * @param [in] format format of string
+ * @param [in] ap list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ * @retval 1 format string is not supported
+ */
+static int ll_pf_format(struct ll_buf *b, const char *format, va_list ap)
+{
+	const char *p = format;
+
+	while (*p) {
+		const char *pct = strchrnul(p, '%');
+
+		if (pct != p && ll_buf_append(b, p, pct - p)) {
+			return (-1);
+		}
+
+		if (!*pct) {
+			break;
+		}
+
+		p = pct + 1;
+
+		struct ll_pf_spec s = { 0, 0, -1, LL_PF_NONE };
+
+		/* flags */
+		for (;; ++ p) {
+			if (*p == '-') {
+				s.flags |= LL_PF_LEFT;
+			} else if (*p == '0') {
+				s.flags |= LL_PF_ZERO;
+			} else if (*p == '+') {
+				s.flags |= LL_PF_PLUS;
+			} else if (*p == ' ') {
+				s.flags |= LL_PF_SPACE;
+			} else {
+				break;
+			}
+		}
+
+		/* width */
+		if (*p == '*') {
+			++ p;
+
+			if ((s.width = va_arg(ap, int)) < 0) {
+				s.flags |= LL_PF_LEFT;
+				s.width = -s.width;
+			}
+		} else {
+			s.width = ll_pf_num(&p);
+		}
+
+		/* positional arguments */
+		if (*p == '$') {
+			return (1);
+		}
+
+		/* precision */
+		if (*p == '.') {
+			++ p;
+
+			if (*p == '*') {
+				++ p;
+
+				if ((s.prec = va_arg(ap, int)) < 0) {
+					s.prec = -1;
+				}
+			} else {
+				s.prec = ll_pf_num(&p);
+			}
+		}
+
+		/* length modifier */
+		switch (*p) {
+		case 'h':
+			s.len = *++ p == 'h' ? (++ p, LL_PF_HH) : LL_PF_H;
+			break;
+
+		case 'l':
+			s.len = *++ p == 'l' ? (++ p, LL_PF_LL) : LL_PF_L;
+			break;
+
+		case 'j':
+			s.len = LL_PF_J;
+			++ p;
+			break;
+
+		case 'z':
+			s.len = LL_PF_Z;
+			++ p;
+			break;
+
+		case 't':
+			s.len = LL_PF_T;
+			++ p;
+			break;
+		}
+
+		int rc;
+
+		switch (*p) {
+		case 'd':
+		case 'i': {
+			intmax_t v;
+
+			switch (s.len) {
+			case LL_PF_HH: v = (signed char)va_arg(ap, int); break;
+			case LL_PF_H: v = (short)va_arg(ap, int); break;
+			case LL_PF_L: v = va_arg(ap, long); break;
+			case LL_PF_LL: v = va_arg(ap, long long); break;
+			case LL_PF_J: v = va_arg(ap, intmax_t); break;
+			case LL_PF_Z: v = va_arg(ap, ssize_t); break;
+			case LL_PF_T: v = va_arg(ap, ptrdiff_t); break;
+			default: v = va_arg(ap, int); break;
+			}
+
+			rc = ll_pf_int(b, &s, v < 0 ? -(uintmax_t)v : (uintmax_t)v, v < 0,
+				*p);
+			break;
+		}
+
+		case 'u':
+		case 'x':
+		case 'X': {
+			uintmax_t v;
+
+			switch (s.len) {
+			case LL_PF_HH: v = (unsigned char)va_arg(ap, unsigned); break;
+			case LL_PF_H: v = (unsigned short)va_arg(ap, unsigned); break;
+			case LL_PF_L: v = va_arg(ap, unsigned long); break;
+			case LL_PF_LL: v = va_arg(ap, unsigned long long); break;
+			case LL_PF_J: v = va_arg(ap, uintmax_t); break;
+			case LL_PF_Z: v = va_arg(ap, size_t); break;
+			case LL_PF_T: v = (uintmax_t)va_arg(ap, ptrdiff_t); break;
+			default: v = va_arg(ap, unsigned); break;
+			}
+
+			rc = ll_pf_int(b, &s, v, 0, *p);
+			break;
+		}
+
+		case 'c': {
+			if (s.len != LL_PF_NONE) {
+				return (1);
+			}
+
+			char c = va_arg(ap, int);
+
+			s.flags &= ~LL_PF_ZERO;
+			rc = ll_pf_put(b, &s, "", 0, 0, &c, 1);
+			break;
+		}
+
+		case 's': {
+			if (s.len != LL_PF_NONE) {
+				return (1);
+			}
+
+			const char *str = va_arg(ap, const char *);
+
+			/* let libc print "(null)" */
+			if (!str) {
+				return (1);
+			}
+
+			size_t n = s.prec < 0 ? strlen(str) : strnlen(str, s.prec);
+
+			s.prec = -1;
+			s.flags &= ~LL_PF_ZERO;
+			rc = ll_pf_put(b, &s, "", 0, 0, str, n);
+			break;
+		}
+
+		case 'p': {
+			const void *ptr = va_arg(ap, const void *);
+			char buf[LL_PF_NUM_MAX];
+			char *end = buf + sizeof(buf);
+
+			/* libc pads pointer by zeroes after "0x" and signs it */
+			if (!ptr || s.len != LL_PF_NONE ||
+				(s.flags & (LL_PF_ZERO | LL_PF_PLUS | LL_PF_SPACE)) ||
+				s.prec >= 0) {
+				return (1);
+			}
+
+			const char *h = ll_pf_hex(end, (uintptr_t)ptr, 0);
+
+			rc = ll_pf_put(b, &s, "0x", 2, 0, h, end - h);
+			break;
+		}
+
+		case '%':
+			if (p != pct + 1) {
+				return (1);
+			}
+
+			rc = ll_buf_append(b, "%", 1);
+			break;
+
+		default:
+			/* floating point, "%n", "%m", "%o", alternate form, etc */
+			return (1);
+		}
+
+		if (rc) {
+			return (rc);
+		}
+
+		++ p;
+	}
+
+	/* keep data null-terminated, like ll_buf_vprintf() does */
+	if (ll_buf_reserve(b, 1)) {
+		return (-1);
+	}
+
+	b->data[b->len] = 0;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_vformat(struct ll_buf *b, const char *format, va_list args)
+{
+	assert(b);
+	assert(format);
+
+	size_t len = b->len;
+	va_list ap;
+
+	va_copy(ap, args);
+	int rc = ll_pf_format(b, format, ap);
+	va_end(ap);
+
+	if (rc > 0) {
+		/* unsupported conversion, start from scratch by libc */
+		b->len = len;
+		rc = ll_buf_vprintf(b, format, args);
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_format_dec(struct ll_buf *b, uint64_t v, int neg)
+{
+	char num[LL_PF_NUM_MAX];
+	char *p = ll_pf_dec(num + sizeof(num), v);
+
+	if (neg) {
+		*-- p = '-';
+	}
+
+	return (ll_buf_append(b, p, num + sizeof(num) - p));
+}
@@ -0,0 +1,56 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_PRINTF_H
+#define __LIBLOG_PRINTF_H
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "buf.h"
+
+/**
+ * @brief Append formatted string to buffer, faster than vsnprintf()
+ * @param [in] b pointer to buffer
+ * @param [in] format format of string
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Integers, characters, strings and pointers with flags, width and
+ * precision are formatted by own code. If format string has anything
+ * else (floating point, "%n", "%m", positional arguments, wide or
+ * locale dependent conversions), whole string is formatted by
+ * ll_buf_vprintf(). Data of buffer is null-terminated after call.
+ */
+int ll_vformat(struct ll_buf *b, const char *format, va_list args);
+
+/**
+ * @brief Append decimal number to buffer
+ * @param [in] b pointer to buffer
+ * @param [in] v number
+ * @param [in] neg non-zero, if number is negative
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Unlike ll_vformat(), data of buffer is not null-terminated.
+ */
+int ll_format_dec(struct ll_buf *b, uint64_t v, int neg);
+
+#endif /* __LIBLOG_PRINTF_H */
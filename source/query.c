@@ -0,0 +1,239 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <libtools/tools.h>
+
+#include "liblog/log.h"
+#include "query.h"
+
+/*------------------------------------------------------------------------*/
+
+const char * const ll_query_common[] = {
+	"rate",
+	"burst",
+	"dedup",
+	"sample",
+	"sample_level",
+	"level",
+	NULL,
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Look for parameter in list
+ * @param [in] keys NULL-terminated list of parameters
+ * @param [in] key name of parameter, not null-terminated
+ * @param [in] len length of name
+ * @return non-zero, if parameter found
+ */
+static int ll_query_known(const char * const keys[], const char *key,
+	size_t len) {
+	const char * const *k = keys;
+
+	while (*k && (strlen(*k) != len || strncmp(*k, key, len))) {
+		++ k;
+	}
+
+	return (!!*k);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_query_get(const char *query, const char *key, char *val,
+	size_t size) {
+	assert(key);
+	assert(val);
+	assert(size);
+
+	size_t klen = strlen(key);
+
+	*val = 0;
+
+	while (query && *query) {
+		size_t len = strcspn(query, "&");
+
+		if (len > klen && !strncmp(query, key, klen) && query[klen] == '=') {
+			len -= klen + 1;
+
+			if (len >= size) {
+				return (-1);
+			}
+
+			memcpy(val, query + klen + 1, len);
+			val[len] = 0;
+
+			return (0);
+		}
+
+		query += len;
+		query += *query == '&';
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_query_check(const char *query, const char * const keys[])
+{
+	assert(keys);
+
+	while (query && *query) {
+		size_t len = strcspn(query, "&=");
+
+		if (!ll_query_known(keys, query, len) &&
+			!ll_query_known(ll_query_common, query, len)) {
+			return (-1);
+		}
+
+		query += strcspn(query, "&");
+		query += *query == '&';
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_query_num(const char *query, const char *key, size_t *val)
+{
+	assert(val);
+
+	char buf[32];
+	char *end;
+
+	if (ll_query_get(query, key, buf, sizeof(buf))) {
+		return (-1);
+	}
+
+	if (!*buf) {
+		return (0);
+	}
+
+	if (*buf < '0' || *buf > '9') {
+		return (-1);
+	}
+
+	errno = 0;
+
+	size_t n = strtoul(buf, &end, 10);
+	unsigned shift = 0;
+
+	switch (*end) {
+	case 'G':
+	case 'g':
+		shift += 10;
+		/* fall through */
+	case 'M':
+	case 'm':
+		shift += 10;
+		/* fall through */
+	case 'K':
+	case 'k':
+		shift += 10;
+		++ end;
+		break;
+	}
+
+	if (*end || errno || n > SIZE_MAX >> shift) {
+		return (-1);
+	}
+
+	*val = n << shift;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_query_level(const char *query, const char *key, enum ll_level *val)
+{
+	assert(val);
+
+	char buf[16];
+
+	if (ll_query_get(query, key, buf, sizeof(buf))) {
+		return (-1);
+	}
+
+	if (!*buf) {
+		return (0);
+	}
+
+	for (int l = LL_LEVEL_EMERG; l <= LL_LEVEL_DEBUG; ++ l) {
+		if (!strcasecmp(buf, ll_level_str(l)) ||
+			(buf[0] == '0' + l && !buf[1])) {
+			*val = l;
+
+			return (0);
+		}
+	}
+
+	return (-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_query_facility(const char *query, const char *key, int *val)
+{
+	static const char * const names[] = {
+		"kern", "user", "mail", "daemon", "auth", "syslog", "lpr", "news",
+		"uucp", "cron", "authpriv", "ftp", NULL, NULL, NULL, NULL,
+		"local0", "local1", "local2", "local3",
+		"local4", "local5", "local6", "local7",
+	};
+
+	assert(val);
+
+	char buf[16];
+	char *end;
+
+	if (ll_query_get(query, key, buf, sizeof(buf))) {
+		return (-1);
+	}
+
+	if (!*buf) {
+		return (0);
+	}
+
+	for (size_t i = 0; i < countof(names); ++ i) {
+		if (names[i] && !strcasecmp(buf, names[i])) {
+			*val = i;
+
+			return (0);
+		}
+	}
+
+	unsigned long n = strtoul(buf, &end, 10);
+
+	if (end == buf || *end || n >= countof(names) || !names[n]) {
+		return (-1);
+	}
+
+	*val = n;
+
+	return (0);
+}
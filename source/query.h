@@ -0,0 +1,94 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_QUERY_H
+#define __LIBLOG_QUERY_H
+
+#include <stddef.h>
+
+#include "liblog/types.h"
+
+/**
+ * @brief Parameters of namespace, accepted by URI query of every logger
+ *
+ * They are handled by liblog itself, see struct ll_ns_opts.
+ */
+extern const char * const ll_query_common[];
+
+/**
+ * @brief Get value of parameter from URI query
+ * @param [in] query query of URI, like "a=1&b=2" (can be NULL)
+ * @param [in] key name of parameter
+ * @param [out] val buffer for value, empty string if parameter not found
+ * @param [in] size size of buffer
+ * @return on success, zero is returned
+ * @retval -1 value is too long
+ */
+int ll_query_get(const char *query, const char *key, char *val,
+	size_t size
+);
+
+/**
+ * @brief Check, that URI query have only known parameters
+ * @param [in] query query of URI (can be NULL)
+ * @param [in] keys NULL-terminated list of known parameters
+ * @return on success, zero is returned
+ * @retval -1 unknown parameter found
+ *
+ * Parameters of @ref ll_query_common are always known.
+ */
+int ll_query_check(const char *query, const char * const keys[]);
+
+/**
+ * @brief Get numeric parameter from URI query
+ * @param [in] query query of URI (can be NULL)
+ * @param [in] key name of parameter
+ * @param [out] val parsed value, untouched if parameter not found
+ * @return on success, zero is returned
+ * @retval -1 value is not a number or too big
+ *
+ * Value can have binary suffix K, M or G, like "buffer=1M".
+ */
+int ll_query_num(const char *query, const char *key, size_t *val);
+
+/**
+ * @brief Get logging level parameter from URI query
+ * @param [in] query query of URI (can be NULL)
+ * @param [in] key name of parameter
+ * @param [out] val parsed level, untouched if parameter not found
+ * @return on success, zero is returned
+ * @retval -1 value is not a logging level
+ *
+ * Level can be given by number or name, like "level=ERR".
+ */
+int ll_query_level(const char *query, const char *key, enum ll_level *val);
+
+/**
+ * @brief Get syslog facility parameter from URI query
+ * @param [in] query query of URI (can be NULL)
+ * @param [in] key name of parameter
+ * @param [out] val parsed facility code, untouched if parameter not found
+ * @return on success, zero is returned
+ * @retval -1 value is not a facility
+ *
+ * Facility can be given by number or name, like "facility=local0".
+ */
+int ll_query_facility(const char *query, const char *key, int *val);
+
+#endif /* __LIBLOG_QUERY_H */
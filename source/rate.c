@@ -0,0 +1,133 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "liblog/log.h"
+#include "namespace.h"
+#include "rate.h"
+
+/*------------------------------------------------------------------------*/
+
+/** nanoseconds per second */
+#define LL_RATE_SEC UINT64_C(1000000000)
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return monotonic time
+ * @return time in nanoseconds
+ */
+static uint64_t ll_rate_now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (t.tv_sec * LL_RATE_SEC + t.tv_nsec);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_rate_take(struct ll_rate *r, uint64_t *report)
+{
+	assert(r);
+	assert(report);
+
+	uint32_t rate = __atomic_load_n(&r->rate, __ATOMIC_RELAXED);
+	int pass = 1;
+
+	*report = 0;
+
+	if (!rate) {
+		return (pass);
+	}
+
+	uint32_t burst = __atomic_load_n(&r->burst, __ATOMIC_RELAXED);
+	uint64_t now = ll_rate_now();
+
+	/* message is allowed, if bucket doesn't overflow by it */
+	uint64_t t = LL_RATE_SEC / rate;
+	uint64_t limit = (burst ? burst : 1) * t;
+	uint64_t tat = __atomic_load_n(&r->tat, __ATOMIC_RELAXED);
+	uint64_t next;
+
+	do {
+		next = (tat > now ? tat : now) + t;
+
+		if (next - now > limit) {
+			pass = 0;
+			break;
+		}
+	} while (!__atomic_compare_exchange_n(&r->tat, &tat, next, 1,
+		__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	if (!pass) {
+		__atomic_add_fetch(&r->suppressed, 1, __ATOMIC_RELAXED);
+	}
+
+	if (!__atomic_load_n(&r->suppressed, __ATOMIC_RELAXED)) {
+		return (pass);
+	}
+
+	uint64_t reported = __atomic_load_n(&r->reported, __ATOMIC_RELAXED);
+
+	/* first summary is done a second after storm began */
+	if (!reported) {
+		__atomic_compare_exchange_n(&r->reported, &reported, now, 0,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	} else if (now - reported >= LL_RATE_SEC &&
+		__atomic_compare_exchange_n(&r->reported, &reported, now, 0,
+		__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		*report = __atomic_exchange_n(&r->suppressed, 0, __ATOMIC_RELAXED);
+	}
+
+	return (pass);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_rate_set(struct ll_rate *r, uint32_t rate, uint32_t burst)
+{
+	assert(r);
+
+	__atomic_store_n(&r->burst, burst ? burst : rate, __ATOMIC_RELAXED);
+	__atomic_store_n(&r->rate, rate, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_site_rate(struct ll_site *site, struct ll_rate *rate,
+	enum ll_level level, const char *format) {
+	assert(site);
+	assert(rate);
+	assert(format);
+
+	uint64_t report;
+	int pass = ll_rate_take(rate, &report);
+
+	if (report && site->ns) {
+		ll_printf_ns(site->ns, level, "suppressed %" PRIu64
+			" messages like \"%s\"", report, format);
+	}
+
+	return (pass);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_RATE_H
+#define __LIBLOG_RATE_H
+
+#include <stdint.h>
+#include <liblog/types.h>
+
+/**
+ * @brief Try to take a place for message
+ * @param [in] r pointer to rate limit
+ * @param [out] report number of suppressed messages to report, or zero
+ * @return non-zero, if message can be logged
+ *
+ * Suppressed messages are reported at most once per second, so summary
+ * appears periodically while the storm lasts.
+ */
+int ll_rate_take(struct ll_rate *r, uint64_t *report);
+
+/**
+ * @brief Change rate limit
+ * @param [in] r pointer to rate limit
+ * @param [in] rate messages per second, zero if unlimited
+ * @param [in] burst number of messages allowed at once, zero for rate
+ */
+void ll_rate_set(struct ll_rate *r, uint32_t rate, uint32_t burst);
+
+#endif /* __LIBLOG_RATE_H */
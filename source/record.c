@@ -0,0 +1,289 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "liblog/log.h"
+#include "buf.h"
+#include "clock.h"
+#include "printf.h"
+#include "record.h"
+
+/*------------------------------------------------------------------------*/
+
+/** initialize @ref ll_record_key */
+static pthread_once_t ll_record_once = PTHREAD_ONCE_INIT;
+
+/** free buffer of exited thread */
+static pthread_key_t ll_record_key;
+
+/** rendering buffers of current thread, for line and shared message */
+static __thread struct ll_buf *ll_record_buf;
+
+/** message of current thread shared by loggers, see ll_record_share() */
+static __thread struct {
+	/** sharing is on */
+	int on;
+
+	/** message is formatted into second buffer */
+	int msg;
+
+	/** line is rendered into first buffer */
+	int line;
+
+	/** resolution of timestamp of line */
+	enum ll_ts ts;
+
+	/** text before message of line */
+	const char *pre;
+
+	/** text after message of line */
+	const char *post;
+
+	/** rendered line */
+	struct ll_record rec;
+} ll_record_shared;
+
+__thread uint64_t ll_record_bytes;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free rendering buffers of exited thread
+ * @param [in] ptr pointer to buffers
+ */
+static void ll_record_free(void *ptr)
+{
+	struct ll_buf *b = ptr;
+
+	ll_buf_free(&b[0]);
+	ll_buf_free(&b[1]);
+	free(ptr);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** Initialize key of rendering buffers once per process */
+static void ll_record_init(void)
+{
+	pthread_key_create(&ll_record_key, ll_record_free);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return rendering buffers of current thread
+ * @return pointer to buffer of line, followed by buffer of message
+ * @retval NULL error occurred
+ */
+static struct ll_buf *ll_record_get(void)
+{
+	struct ll_buf *b = ll_record_buf;
+
+	if (b) {
+		return (b);
+	}
+
+	pthread_once(&ll_record_once, ll_record_init);
+
+	if (!(b = calloc(2, sizeof(*b)))) {
+		return (NULL);
+	}
+
+	if (pthread_setspecific(ll_record_key, b)) {
+		free(b);
+
+		return (NULL);
+	}
+
+	return (ll_record_buf = b);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Format message into second buffer, unless it's shared already
+ * @param [in] b rendering buffers of current thread
+ * @param [in] format format of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_record_format(struct ll_buf *b, const char *format,
+	va_list args) {
+	if (ll_record_shared.msg) {
+		return (0);
+	}
+
+	b[1].len = 0;
+
+	if (ll_vformat(&b[1], format, args)) {
+		return (-1);
+	}
+
+	ll_record_shared.msg = ll_record_shared.on;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_record_vrender(struct ll_record *rec, const char *name,
+	enum ll_level level, enum ll_ts ts, const char *pre, const char *post,
+	const char *format, va_list args) {
+	assert(rec);
+	assert(name);
+	assert(format);
+
+	struct ll_buf *b = ll_record_get();
+	const char *lvl = ll_level_str(level);
+	size_t name_len = strlen(name);
+	size_t lvl_len = strlen(lvl);
+
+	if (!b) {
+		return (-1);
+	}
+
+	if (ll_record_shared.on) {
+		/* the same decoration, line is ready */
+		if (ll_record_shared.line && ll_record_shared.ts == ts &&
+			ll_record_shared.pre == pre &&
+			ll_record_shared.post == post) {
+			*rec = ll_record_shared.rec;
+			ll_record_bytes += rec->len;
+
+			return (0);
+		}
+
+		if (ll_record_format(b, format, args)) {
+			return (-1);
+		}
+	}
+
+	rec->ts = ll_clock_now(ts);
+	rec->name = name;
+	rec->level = level;
+
+	b->len = 0;
+
+	/* header has known size, so reserve it at once */
+	if (ll_buf_reserve(b, LL_CLOCK_STR_MAX + name_len + lvl_len + 3)) {
+		return (-1);
+	}
+
+	b->len = ll_clock_str(b->data, rec->ts, ts);
+	b->data[b->len ++] = ';';
+	memcpy(b->data + b->len, name, name_len);
+	b->len += name_len;
+	b->data[b->len ++] = ';';
+	memcpy(b->data + b->len, lvl, lvl_len);
+	b->len += lvl_len;
+	b->data[b->len ++] = ';';
+
+	if ((pre && ll_buf_append(b, pre, strlen(pre))) ||
+		(ll_record_shared.on ? ll_buf_append(b, b[1].data, b[1].len) :
+		ll_vformat(b, format, args)) ||
+		(post && ll_buf_append(b, post, strlen(post))) ||
+		ll_buf_append(b, "\n", 1)) {
+		return (-1);
+	}
+
+	rec->line = b->data;
+	rec->len = b->len;
+	ll_record_bytes += b->len;
+
+	if (ll_record_shared.on) {
+		ll_record_shared.line = 1;
+		ll_record_shared.ts = ts;
+		ll_record_shared.pre = pre;
+		ll_record_shared.post = post;
+		ll_record_shared.rec = *rec;
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_record_msg(const char **msg, size_t *len, const char *format,
+	va_list args) {
+	assert(msg);
+	assert(len);
+	assert(format);
+
+	struct ll_buf *b = ll_record_get();
+
+	if (!b || ll_record_format(b, format, args)) {
+		return (-1);
+	}
+
+	*msg = b[1].data;
+	*len = b[1].len;
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_record_share(int on)
+{
+	ll_record_shared.on = on;
+	ll_record_shared.msg = 0;
+	ll_record_shared.line = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_record_render(struct ll_record *rec, const char *name,
+	enum ll_level level, enum ll_ts ts, const char *format, va_list args) {
+	return (ll_record_vrender(rec, name, level, ts, NULL, NULL, format,
+		args));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_record_write(int fd, const struct ll_record *rec)
+{
+	assert(rec);
+
+	const char *p = rec->line;
+	size_t len = rec->len;
+
+	while (len) {
+		ssize_t n = write(fd, p, len);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return (-1);
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return (0);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_RECORD_H
+#define __LIBLOG_RECORD_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "liblog/types.h"
+
+/** total size of lines rendered by current thread, used by statistics */
+extern __thread uint64_t ll_record_bytes;
+
+/**
+ * @brief Render log line with decorated message
+ * @param [out] rec rendered record
+ * @param [in] name namespace of message
+ * @param [in] level logging level of message
+ * @param [in] ts resolution of timestamp
+ * @param [in] pre text before message (can be NULL)
+ * @param [in] post text after message (can be NULL)
+ * @param [in] format format of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_record_vrender(struct ll_record *rec, const char *name,
+	enum ll_level level, enum ll_ts ts, const char *pre, const char *post,
+	const char *format, va_list args
+);
+
+/**
+ * @brief Format message without decoration
+ * @param [out] msg null-terminated message
+ * @param [out] len length of message
+ * @param [in] format format of message
+ * @param [in] args list of arguments
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ *
+ * Message is kept by buffer of current thread until next rendering,
+ * it's shared like message of ll_record_vrender().
+ */
+int ll_record_msg(const char **msg, size_t *len, const char *format,
+	va_list args
+);
+
+/**
+ * @brief Share rendered message between loggers of namespace
+ * @param [in] on non-zero to start sharing, zero to stop it
+ *
+ * While sharing is on, message is formatted by first rendering only,
+ * next renderings of current thread reuse it and ignore format and
+ * arguments. Line is reused as is, if it has the same decoration.
+ */
+void ll_record_share(int on);
+
+/**
+ * @brief Write rendered line to file descriptor
+ * @param [in] fd file descriptor
+ * @param [in] rec rendered record
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_record_write(int fd, const struct ll_record *rec);
+
+#endif /* __LIBLOG_RECORD_H */
@@ -0,0 +1,143 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "liblog/log.h"
+#include "sample.h"
+
+/*------------------------------------------------------------------------*/
+
+/** state of PRNG of current thread, zero until seeded */
+static __thread uint64_t ll_sample_state;
+
+/** trace id of next message of current thread */
+static __thread uint64_t ll_sample_id;
+
+/** non-zero, if @ref ll_sample_id is set */
+static __thread int ll_sample_traced;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Scramble number (finalizer of splitmix64)
+ * @param [in] v number
+ * @return scrambled number
+ */
+static uint64_t ll_sample_mix(uint64_t v)
+{
+	v += UINT64_C(0x9e3779b97f4a7c15);
+	v = (v ^ (v >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	v = (v ^ (v >> 27)) * UINT64_C(0x94d049bb133111eb);
+
+	return (v ^ (v >> 31));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return next random number of current thread (xorshift64*)
+ * @return random number
+ */
+static uint64_t ll_sample_rand(void)
+{
+	uint64_t x = ll_sample_state;
+
+	if (!x) {
+		struct timespec t;
+
+		/* threads are seeded by time and address of own state */
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		x = ll_sample_mix(t.tv_nsec ^ (uintptr_t)&ll_sample_state) | 1;
+	}
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	ll_sample_state = x;
+
+	return (x * UINT64_C(0x2545f4914f6cdd1d));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_sample_parse(const char *val, uint64_t *threshold)
+{
+	assert(val);
+	assert(threshold);
+
+	char *end;
+
+	if (*val < '0' || *val > '9') {
+		return (-1);
+	}
+
+	if (strchr(val, '.')) {
+		double p = strtod(val, &end);
+
+		if (*end || p <= 0 || p > 1) {
+			return (-1);
+		}
+
+		/* 2^64 * p, probability of 1 keeps all */
+		*threshold = p < 1 ? (uint64_t)(p * 18446744073709551616.0) : 0;
+	} else {
+		unsigned long long n = strtoull(val, &end, 10);
+
+		if (*end || !n) {
+			return (-1);
+		}
+
+		*threshold = n > 1 ? UINT64_MAX / n : 0;
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_sample_keep(uint64_t threshold)
+{
+	uint64_t v;
+
+	if (ll_sample_traced) {
+		/* the same trace id gives the same decision everywhere */
+		v = ll_sample_mix(ll_sample_id);
+		ll_sample_traced = 0;
+	} else if (threshold) {
+		v = ll_sample_rand();
+	} else {
+		return (1);
+	}
+
+	return (!threshold || v < threshold);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_sample_trace(uint64_t id)
+{
+	ll_sample_id = id;
+	ll_sample_traced = 1;
+
+	return (1);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_SAMPLE_H
+#define __LIBLOG_SAMPLE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Parse sampling ratio
+ * @param [in] val ratio, "N" for 1-in-N or "0.P" for probability
+ * @param [out] threshold threshold of random number, zero to keep all
+ * @return on success, zero is returned
+ * @retval -1 invalid ratio
+ */
+int ll_sample_parse(const char *val, uint64_t *threshold);
+
+/**
+ * @brief Decide, if message is kept by sampling
+ * @param [in] threshold threshold of random number, see ll_sample_parse()
+ * @return non-zero, if message is kept
+ *
+ * Random number is taken from PRNG of current thread, or derived from
+ * trace id, given by ll_sample_trace() for this message. Trace id is
+ * consumed by each call, even if threshold is zero.
+ */
+int ll_sample_keep(uint64_t threshold);
+
+#endif /* __LIBLOG_SAMPLE_H */
@@ -0,0 +1,737 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "namespace.h"
+#include "shm.h"
+
+/*------------------------------------------------------------------------*/
+
+/** signature of ring, "LLSHM" and version of format on little-endian */
+#define LL_SHM_MAGIC 0x014d48534c4cULL
+
+/** size of message data in slot */
+#define LL_SHM_DATA (LL_SHM_SLOT - 16)
+
+/** maximum number of slots of message */
+#define LL_SHM_SPAN 512
+
+/** how long slot can stay taken and not published (ms) */
+#define LL_SHM_STALL_MS 1000
+
+/** how long flush waits for collector (ns) */
+#define LL_SHM_PAUSE_NS 50000
+
+/** how many pauses flush waits for collector, one second in total */
+#define LL_SHM_FLUSH_PAUSES 20000
+
+/** Slot of ring */
+struct ll_shm_slot {
+	/** sequence of slot */
+	uint64_t seq;
+
+	/** size of message in first slot, zero in next ones */
+	uint32_t len;
+
+	/** number of slots of message in first slot, zero in next ones */
+	uint32_t n;
+
+	/** part of message */
+	char data[LL_SHM_DATA];
+};
+
+/** Control block of ring, shared by processes */
+struct ll_shm_ctl {
+	/** signature, set when ring is initialized */
+	uint64_t magic;
+
+	/** number of slots, power of two */
+	uint64_t slots;
+
+	/** process, which created ring */
+	int32_t pid;
+
+	/** non-zero, if producer closed ring */
+	uint32_t closed;
+
+	/** process of collector, zero if ring is not attached */
+	int32_t collector;
+
+	/** reserved */
+	uint32_t pad;
+
+	/** number of messages dropped by producers or skipped by collector */
+	uint64_t dropped;
+
+	/** position of next slot, taken by producers */
+	uint64_t head __attribute__((aligned(LL_CACHELINE)));
+
+	/** position of first slot, moved by collector */
+	uint64_t tail __attribute__((aligned(LL_CACHELINE)));
+
+	/** futex word, non-zero if collector is sleeping */
+	uint32_t sleeping __attribute__((aligned(LL_CACHELINE)));
+
+	/** slots */
+	struct ll_shm_slot slot[] __attribute__((aligned(LL_CACHELINE)));
+};
+
+/** Mapped ring */
+struct ll_shm {
+	/** shared control block and slots */
+	struct ll_shm_ctl *ctl;
+
+	/** size of mapping */
+	size_t size;
+
+	/** number of slots minus one */
+	uint64_t mask;
+
+	/** maximum number of slots of message */
+	uint64_t span;
+
+	/** number of dropped messages, when flush was called */
+	uint64_t reported;
+
+	/** non-zero, if ring is mapped by collector */
+	int attached;
+
+	/** position of slot, which is not published yet (collector) */
+	uint64_t stall;
+
+	/** when collector noticed @ref stall (ms), zero if not yet */
+	uint64_t stall_since;
+
+	/** name of ring file */
+	char name[];
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return slot of position
+ * @param [in] s pointer to ring
+ * @param [in] pos position of ring
+ * @return pointer to slot
+ */
+static struct ll_shm_slot *ll_shm_slot(const struct ll_shm *s, uint64_t pos)
+{
+	return (&s->ctl->slot[pos & s->mask]);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, if slot at given position is published
+ * @param [in] s pointer to ring
+ * @param [in] pos position of ring
+ * @return non-zero, if slot is published
+ */
+static int ll_shm_ready(const struct ll_shm *s, uint64_t pos)
+{
+	return (__atomic_load_n(&ll_shm_slot(s, pos)->seq, __ATOMIC_ACQUIRE) ==
+		pos + 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return monotonic time
+ * @return number of milliseconds
+ */
+static uint64_t ll_shm_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Wake up collector, if it's sleeping
+ * @param [in] c pointer to control block
+ */
+static void ll_shm_wake(struct ll_shm_ctl *c)
+{
+	if (__atomic_load_n(&c->sleeping, __ATOMIC_RELAXED) &&
+		__atomic_exchange_n(&c->sleeping, 0, __ATOMIC_RELAXED)) {
+		syscall(SYS_futex, &c->sleeping, FUTEX_WAKE, 1, NULL, NULL, 0);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return path of ring file
+ * @param [in] name name of ring file
+ * @param [out] path buffer for path, 16 bytes longer than name
+ * @return @p path
+ */
+static char *ll_shm_path(const char *name, char *path)
+{
+	strcpy(path, LL_SHM_DIR "/");
+	strcat(path, name);
+
+	return (path);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Allocate handle of mapped ring
+ * @param [in] name name of ring file
+ * @param [in] ctl mapped control block
+ * @param [in] size size of mapping
+ * @return pointer to ring
+ * @retval NULL error occurred
+ */
+static struct ll_shm *ll_shm_new(const char *name, struct ll_shm_ctl *ctl,
+	size_t size) {
+	struct ll_shm *s = calloc(1, sizeof(*s) + strlen(name) + 1);
+
+	if (!s) {
+		return (NULL);
+	}
+
+	strcpy(s->name, name);
+	s->ctl = ctl;
+	s->size = size;
+	s->mask = ctl->slots - 1;
+
+	/* one message can't take more than quarter of ring */
+	s->span = ctl->slots / 4 < LL_SHM_SPAN ? ctl->slots / 4 : LL_SHM_SPAN;
+
+	return (s);
+}
+
+/*------------------------------------------------------------------------*/
+
+struct ll_shm *ll_shm_create(const char *name, size_t size)
+{
+	assert(name);
+
+	char path[strlen(name) + 16];
+	uint64_t slots = 4;
+
+	while (slots * LL_SHM_SLOT < size) {
+		slots <<= 1;
+	}
+
+	size = sizeof(struct ll_shm_ctl) + slots * LL_SHM_SLOT;
+	ll_shm_path(name, path);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+	if (fd < 0) {
+		return (NULL);
+	}
+
+	/* allocate pages now, full tmpfs would kill writer by SIGBUS */
+	struct ll_shm_ctl *c = MAP_FAILED;
+
+	if (!posix_fallocate(fd, 0, size)) {
+		c = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+
+	close(fd);
+
+	if (c == MAP_FAILED) {
+		unlink(path);
+
+		return (NULL);
+	}
+
+	c->slots = slots;
+	c->pid = getpid();
+
+	for (uint64_t i = 0; i < slots; ++ i) {
+		c->slot[i].seq = i;
+	}
+
+	/* collector ignores ring until it's initialized */
+	__atomic_store_n(&c->magic, LL_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	struct ll_shm *s = ll_shm_new(name, c, size);
+
+	if (!s) {
+		munmap(c, size);
+		unlink(path);
+	}
+
+	return (s);
+}
+
+/*------------------------------------------------------------------------*/
+
+struct ll_shm *ll_shm_attach(const char *name)
+{
+	assert(name);
+
+	char path[strlen(name) + 16];
+	int fd = open(ll_shm_path(name, path), O_RDWR | O_CLOEXEC);
+	struct stat st;
+
+	if (fd < 0) {
+		return (NULL);
+	}
+
+	struct ll_shm_ctl *c = MAP_FAILED;
+
+	if (!fstat(fd, &st) && (size_t)st.st_size >= sizeof(*c)) {
+		c = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+	}
+
+	close(fd);
+
+	if (c == MAP_FAILED) {
+		return (NULL);
+	}
+
+	struct ll_shm *s = NULL;
+
+	/* size of file should match number of slots, if it's a ring */
+	if (__atomic_load_n(&c->magic, __ATOMIC_ACQUIRE) == LL_SHM_MAGIC &&
+		c->slots >= 4 &&
+		!(c->slots & (c->slots - 1)) &&
+		c->slots <= ((size_t)st.st_size - sizeof(*c)) / LL_SHM_SLOT &&
+		(size_t)st.st_size == sizeof(*c) + c->slots * LL_SHM_SLOT) {
+		s = ll_shm_new(name, c, st.st_size);
+	}
+
+	if (!s) {
+		munmap(c, st.st_size);
+
+		return (NULL);
+	}
+
+	s->attached = 1;
+	__atomic_store_n(&c->collector, getpid(), __ATOMIC_RELAXED);
+
+	return (s);
+}
+
+/*------------------------------------------------------------------------*/
+
+size_t ll_shm_max(const struct ll_shm *s)
+{
+	assert(s);
+
+	return (s->span * LL_SHM_DATA);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_shm_put(struct ll_shm *s, const struct iovec *iov, int n)
+{
+	assert(s);
+	assert(iov);
+
+	struct ll_shm_ctl *c = s->ctl;
+	size_t len = 0;
+
+	for (int i = 0; i < n; ++ i) {
+		len += iov[i].iov_len;
+	}
+
+	uint64_t k = len ? (len + LL_SHM_DATA - 1) / LL_SHM_DATA : 1;
+
+	if (k > s->span) {
+		__atomic_add_fetch(&c->dropped, 1, __ATOMIC_RELAXED);
+
+		return (-1);
+	}
+
+	uint64_t pos = __atomic_load_n(&c->head, __ATOMIC_RELAXED);
+
+	/*
+	 * take free slots, other producers can take them meanwhile;
+	 * slots are freed in order, so it's enough to check the last one
+	 */
+	for (;;) {
+		int64_t dif = (int64_t)(__atomic_load_n(&ll_shm_slot(s,
+			pos + k - 1)->seq, __ATOMIC_ACQUIRE) - (pos + k - 1));
+
+		if (dif < 0) {
+			/* ring is full */
+			__atomic_add_fetch(&c->dropped, 1, __ATOMIC_RELAXED);
+
+			return (-1);
+		}
+
+		if (!dif && __atomic_compare_exchange_n(&c->head, &pos, pos + k, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			break;
+		}
+
+		if (dif) {
+			pos = __atomic_load_n(&c->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	size_t off = 0;
+	int i = 0;
+
+	for (uint64_t j = 0; j < k; ++ j) {
+		struct ll_shm_slot *sl = ll_shm_slot(s, pos + j);
+		size_t used = 0;
+
+		while (used < LL_SHM_DATA && i < n) {
+			size_t m = iov[i].iov_len - off;
+
+			if (m > LL_SHM_DATA - used) {
+				m = LL_SHM_DATA - used;
+			}
+
+			if (m) {
+				memcpy(sl->data + used, (char *)iov[i].iov_base + off, m);
+				used += m;
+			}
+
+			if ((off += m) == iov[i].iov_len) {
+				off = 0;
+				++ i;
+			}
+		}
+
+		sl->len = j ? 0 : len;
+		sl->n = j ? 0 : k;
+	}
+
+	int rc = 0;
+
+	/* collector could skip slots, if producer was stopped for too long */
+	for (uint64_t j = 0; j < k; ++ j) {
+		uint64_t seq = pos + j;
+
+		if (!__atomic_compare_exchange_n(&ll_shm_slot(s, pos + j)->seq,
+			&seq, pos + j + 1, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+			rc = -1;
+		}
+	}
+
+	/* pairs with collector, which checks slot after sleeping is set */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	/* collector can sleep only at first message of ring */
+	if (__atomic_load_n(&c->tail, __ATOMIC_RELAXED) == pos) {
+		ll_shm_wake(c);
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Free slots taken by collector
+ * @param [in] s pointer to ring
+ * @param [in] pos position of first slot
+ * @param [in] n number of slots
+ */
+static void ll_shm_release(struct ll_shm *s, uint64_t pos, uint64_t n)
+{
+	for (uint64_t i = pos; i < pos + n; ++ i) {
+		__atomic_store_n(&ll_shm_slot(s, i)->seq, i + s->ctl->slots,
+			__ATOMIC_RELEASE);
+	}
+
+	__atomic_store_n(&s->ctl->tail, pos + n, __ATOMIC_RELEASE);
+	s->stall_since = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Wait until slot is published
+ * @param [in] s pointer to ring
+ * @param [in] first position of first slot of message
+ * @param [in] pos position of slot
+ * @param [in] ms how long to wait (ms)
+ * @return one, if slot is published
+ * @retval 0 slot isn't published yet
+ * @retval -1 slot was skipped, with previous slots of message
+ */
+static int ll_shm_wait(struct ll_shm *s, uint64_t first, uint64_t pos,
+	unsigned ms) {
+	struct ll_shm_ctl *c = s->ctl;
+
+	if (ll_shm_ready(s, pos)) {
+		return (1);
+	}
+
+	/* slot is taken by producer, but not published */
+	if ((int64_t)(__atomic_load_n(&c->head, __ATOMIC_ACQUIRE) - pos) > 0) {
+		uint64_t now = ll_shm_ms();
+
+		if (!s->stall_since || s->stall != pos) {
+			s->stall = pos;
+			s->stall_since = now;
+		}
+
+		uint64_t left = s->stall_since + LL_SHM_STALL_MS - now;
+
+		if ((int64_t)left <= 0) {
+			uint64_t seq = pos;
+
+			/* producer died or hangs, it won't publish slot */
+			ll_shm_release(s, first, pos - first);
+
+			if (!__atomic_compare_exchange_n(&ll_shm_slot(s, pos)->seq, &seq,
+				pos + c->slots, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+				/* published at last moment, but previous part is lost */
+				return (first == pos ? 1 : -1);
+			}
+
+			__atomic_store_n(&c->tail, pos + 1, __ATOMIC_RELEASE);
+			__atomic_add_fetch(&c->dropped, 1, __ATOMIC_RELAXED);
+
+			return (-1);
+		}
+
+		if (ms > left) {
+			ms = left;
+		}
+	}
+
+	if (!ms) {
+		return (0);
+	}
+
+	__atomic_store_n(&c->sleeping, 1, __ATOMIC_RELAXED);
+
+	/* pairs with producer, which checks sleeping after slot is published */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (!ll_shm_ready(s, pos)) {
+		struct timespec ts = { ms / 1000, ms % 1000 * 1000000 };
+
+		syscall(SYS_futex, &c->sleeping, FUTEX_WAIT, 1, &ts, NULL, 0);
+	}
+
+	__atomic_store_n(&c->sleeping, 0, __ATOMIC_RELAXED);
+
+	return (ll_shm_ready(s, pos));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Copy message from published slots
+ * @param [in] s pointer to ring
+ * @param [in] pos position of first slot of message
+ * @param [out] b buffer for message
+ * @param [in] ms how long to wait for next slots (ms)
+ * @return one, if message is taken
+ * @retval 0 message isn't published completely yet
+ * @retval -1 message is broken, its slots were freed
+ */
+static int ll_shm_take(struct ll_shm *s, uint64_t pos, struct ll_buf *b,
+	unsigned ms) {
+	const struct ll_shm_slot *sl = ll_shm_slot(s, pos);
+	uint64_t k = sl->n;
+	size_t len = sl->len;
+
+	/* rest of message, which head was skipped */
+	if (!k || k > s->span || len > k * LL_SHM_DATA ||
+		(k > 1 && len <= (k - 1) * LL_SHM_DATA)) {
+		ll_shm_release(s, pos, 1);
+
+		return (-1);
+	}
+
+	b->len = 0;
+
+	if (ll_buf_reserve(b, len + 1)) {
+		return (0);
+	}
+
+	for (uint64_t j = 0; j < k; ++ j) {
+		int rc = j ? ll_shm_wait(s, pos, pos + j, ms) : 1;
+
+		if (rc <= 0) {
+			return (rc);
+		}
+
+		sl = ll_shm_slot(s, pos + j);
+
+		/* head of other message, so this one was broken */
+		if (j && sl->n) {
+			ll_shm_release(s, pos, j);
+
+			return (-1);
+		}
+
+		size_t m = len - b->len < LL_SHM_DATA ? len - b->len : LL_SHM_DATA;
+
+		memcpy(b->data + b->len, sl->data, m);
+		b->len += m;
+	}
+
+	b->data[b->len] = 0;
+	ll_shm_release(s, pos, k);
+
+	return (1);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_shm_get(struct ll_shm *s, struct ll_buf *b, unsigned ms)
+{
+	assert(s);
+	assert(b);
+
+	for (;;) {
+		uint64_t pos = __atomic_load_n(&s->ctl->tail, __ATOMIC_RELAXED);
+		int rc = ll_shm_wait(s, pos, pos, ms);
+
+		if (!rc) {
+			return (0);
+		}
+
+		if (rc > 0 && (rc = ll_shm_take(s, pos, b, ms)) >= 0) {
+			return (rc);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+uint64_t ll_shm_dropped(const struct ll_shm *s)
+{
+	assert(s);
+
+	return (__atomic_load_n(&s->ctl->dropped, __ATOMIC_RELAXED));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_shm_pid(const struct ll_shm *s)
+{
+	assert(s);
+
+	return (s->ctl->pid);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, if process is running
+ * @param [in] pid process
+ * @return non-zero, if process is running
+ */
+static int ll_shm_alive(int pid)
+{
+	return (pid && (!kill(pid, 0) || errno != ESRCH));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_shm_done(const struct ll_shm *s)
+{
+	assert(s);
+
+	const struct ll_shm_ctl *c = s->ctl;
+
+	if (__atomic_load_n(&c->head, __ATOMIC_ACQUIRE) !=
+		__atomic_load_n(&c->tail, __ATOMIC_RELAXED)) {
+		return (0);
+	}
+
+	if (__atomic_load_n(&c->closed, __ATOMIC_ACQUIRE)) {
+		return (1);
+	}
+
+	/* producer was killed, and can't close ring */
+	return (!ll_shm_alive(c->pid));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_shm_flush(struct ll_shm *s)
+{
+	assert(s);
+
+	struct ll_shm_ctl *c = s->ctl;
+	int rc = -1;
+
+	/* without collector, messages wait in ring for the next one */
+	for (int i = 0; i < LL_SHM_FLUSH_PAUSES &&
+		ll_shm_alive(__atomic_load_n(&c->collector, __ATOMIC_RELAXED));
+		++ i) {
+		if (__atomic_load_n(&c->tail, __ATOMIC_ACQUIRE) ==
+			__atomic_load_n(&c->head, __ATOMIC_RELAXED)) {
+			rc = 0;
+
+			break;
+		}
+
+		nanosleep(&(struct timespec){0, LL_SHM_PAUSE_NS}, NULL);
+	}
+
+	uint64_t dropped = ll_shm_dropped(s);
+
+	/* report loss once, including messages skipped by collector */
+	if (__atomic_exchange_n(&s->reported, dropped, __ATOMIC_RELAXED) !=
+		dropped) {
+		rc = -1;
+	}
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_shm_close(struct ll_shm *s, int remove)
+{
+	if (!s) {
+		return;
+	}
+
+	if (s->attached && remove) {
+		char path[strlen(s->name) + 16];
+
+		unlink(ll_shm_path(s->name, path));
+	} else if (s->attached) {
+		/* ring stays for the next collector */
+		__atomic_store_n(&s->ctl->collector, 0, __ATOMIC_RELAXED);
+	} else {
+		/* collector removes ring, when it takes the rest of messages */
+		__atomic_store_n(&s->ctl->closed, 1, __ATOMIC_RELEASE);
+		ll_shm_wake(s->ctl);
+	}
+
+	munmap(s->ctl, s->size);
+	free(s);
+}
@@ -0,0 +1,155 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_SHM_H
+#define __LIBLOG_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "buf.h"
+
+/**
+ * @brief Shared memory ring of messages
+ *
+ * Ring is a file of @ref LL_SHM_DIR, mapped by producer process and
+ * collector process. It starts by control block: magic, number of slots,
+ * pid of producer, counters and positions. Slots of @ref LL_SHM_SLOT bytes
+ * follow, message takes one or more consecutive slots.
+ *
+ * Sequence of slot tells its state for position of ring: equal to
+ * position, if slot is free or taken by producer, position plus one,
+ * if slot is published. Producers take slots by moving head and publish
+ * them by exchange of sequence, so collector can skip slots of producer,
+ * which died or hangs between these steps, and ring stays usable by
+ * others.
+ *
+ * Message of shm: logger is: 8 bytes of timestamp in nanoseconds, one
+ * byte of logging level, null-terminated namespace, null-terminated
+ * message and binary fields of structured message (see kv.h).
+ */
+
+/** directory of rings */
+#define LL_SHM_DIR "/dev/shm"
+
+/** prefix of ring names */
+#define LL_SHM_PREFIX "liblog."
+
+/** size of slot */
+#define LL_SHM_SLOT 128
+
+/** size of message header: timestamp and level */
+#define LL_SHM_HDR 9
+
+/** Mapped ring, see ll_shm_create() and ll_shm_attach() */
+struct ll_shm;
+
+/**
+ * @brief Create ring for producer
+ * @param [in] name name of ring file, without directory
+ * @param [in] size size of ring, rounded up to power of two slots
+ * @return pointer to ring, free it by ll_shm_close()
+ * @retval NULL error occurred
+ */
+struct ll_shm *ll_shm_create(const char *name, size_t size);
+
+/**
+ * @brief Map ring for collector
+ * @param [in] name name of ring file, without directory
+ * @return pointer to ring, free it by ll_shm_close()
+ * @retval NULL not a ring, or it's not initialized yet
+ */
+struct ll_shm *ll_shm_attach(const char *name);
+
+/**
+ * @brief Return maximum size of message
+ * @param [in] s pointer to ring
+ * @return size of message
+ */
+size_t ll_shm_max(const struct ll_shm *s);
+
+/**
+ * @brief Put message gathered from pieces
+ * @param [in] s pointer to ring
+ * @param [in] iov pieces of message
+ * @param [in] n number of pieces
+ * @return on success, zero is returned
+ * @retval -1 ring is full or message is too big (message was dropped)
+ *
+ * Producer never waits for collector. Collector is woken up only,
+ * if it's sleeping and message is first one in ring.
+ */
+int ll_shm_put(struct ll_shm *s, const struct iovec *iov, int n);
+
+/**
+ * @brief Take message from ring
+ * @param [in] s pointer to ring
+ * @param [out] b buffer for message, it's replaced
+ * @param [in] ms how long to wait for message (ms)
+ * @return one, if message is taken
+ * @retval 0 no message
+ *
+ * Only one collector thread can take messages from ring. Slots taken
+ * and not published for a second are skipped.
+ */
+int ll_shm_get(struct ll_shm *s, struct ll_buf *b, unsigned ms);
+
+/**
+ * @brief Return number of dropped messages
+ * @param [in] s pointer to ring
+ * @return number of messages dropped by full ring or skipped by collector
+ */
+uint64_t ll_shm_dropped(const struct ll_shm *s);
+
+/**
+ * @brief Return process of producer
+ * @param [in] s pointer to ring
+ * @return pid of process, which created ring
+ */
+int ll_shm_pid(const struct ll_shm *s);
+
+/**
+ * @brief Check, if ring can be removed by collector
+ * @param [in] s pointer to ring
+ * @return non-zero, if ring is empty and producer is closed or dead
+ */
+int ll_shm_done(const struct ll_shm *s);
+
+/**
+ * @brief Wait until collector takes messages
+ * @param [in] s pointer to ring
+ * @return on success, zero is returned
+ * @retval -1 ring wasn't drained in time, or messages were dropped
+ * since previous call
+ */
+int ll_shm_flush(struct ll_shm *s);
+
+/**
+ * @brief Unmap ring
+ * @param [in] s pointer to ring (can be NULL)
+ * @param [in] remove non-zero to remove ring file, used by collector
+ *
+ * Ring closed by producer is removed by collector, when it takes the rest
+ * of messages. Ring, which wasn't removed by collector, is taken by next
+ * collector.
+ */
+void ll_shm_close(struct ll_shm *s, int remove);
+
+#endif /* __LIBLOG_SHM_H */
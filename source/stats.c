@@ -0,0 +1,315 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "liblog/log.h"
+#include "stats.h"
+
+/*------------------------------------------------------------------------*/
+
+int ll_stats_on;
+
+/** number of linear sub-buckets per power of two */
+#define LL_STATS_SUB (1 << LL_STATS_SUB_BITS)
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return shards of namespace statistics, allocate them if needed
+ * @param [in] ns pointer to namespace
+ * @return pointer to shard of current CPU
+ * @retval NULL error occurred
+ */
+static struct ll_stats_shard *ll_stats_shard(struct ll_namespace *ns)
+{
+	struct ll_stats_shard *s = __atomic_load_n(&ns->stats, __ATOMIC_ACQUIRE);
+
+	if (!s) {
+		struct ll_stats_shard *prev = NULL;
+
+		if (posix_memalign((void **)&s, LL_CACHELINE,
+			LL_STATS_SHARDS * sizeof(*s))) {
+			return (NULL);
+		}
+
+		memset(s, 0, LL_STATS_SHARDS * sizeof(*s));
+
+		/* shards can be allocated by another thread meanwhile */
+		if (!__atomic_compare_exchange_n(&ns->stats, &prev, s, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			free(s);
+			s = prev;
+		}
+	}
+
+	int cpu = sched_getcpu();
+
+	return (&s[cpu < 0 ? 0 : cpu % LL_STATS_SHARDS]);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return bucket of latency histogram
+ * @param [in] v latency in nanoseconds
+ * @return index of bucket
+ */
+static size_t ll_stats_bucket(uint64_t v)
+{
+	if (v < LL_STATS_SUB) {
+		return (v);
+	}
+
+	if (v >> LL_STATS_MAX_BITS) {
+		v = (UINT64_C(1) << LL_STATS_MAX_BITS) - 1;
+	}
+
+	unsigned e = 63 - __builtin_clzll(v);
+
+	return (((e - LL_STATS_SUB_BITS + 1) << LL_STATS_SUB_BITS) |
+		((v >> (e - LL_STATS_SUB_BITS)) & (LL_STATS_SUB - 1)));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return highest latency of bucket
+ * @param [in] i index of bucket
+ * @return latency in nanoseconds
+ */
+static uint64_t ll_stats_value(size_t i)
+{
+	if (i < LL_STATS_SUB) {
+		return (i);
+	}
+
+	unsigned shift = (i >> LL_STATS_SUB_BITS) - 1;
+	uint64_t low = (uint64_t)(LL_STATS_SUB + (i & (LL_STATS_SUB - 1))) << shift;
+
+	return (low + (UINT64_C(1) << shift) - 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_stats_add(struct ll_namespace *ns, enum ll_level level,
+	enum ll_stat stat, uint64_t n) {
+	assert(ns);
+
+	struct ll_stats_shard *s;
+
+	if ((unsigned)level > LL_LEVEL_DEBUG || !n || !(s = ll_stats_shard(ns))) {
+		return;
+	}
+
+	/* shard is shared only by threads of the same CPU, so it's cheap */
+	__atomic_add_fetch(&s->count[level][stat], n, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------------------------------------*/
+
+uint64_t ll_stats_start(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (t.tv_sec * UINT64_C(1000000000) + t.tv_nsec);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_stats_latency(struct ll_namespace *ns, uint64_t start)
+{
+	assert(ns);
+
+	uint64_t t = ll_stats_start() - start;
+	struct ll_stats_shard *s = ll_stats_shard(ns);
+
+	if (s) {
+		__atomic_add_fetch(&s->time, t, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&s->lat[ll_stats_bucket(t)], 1, __ATOMIC_RELAXED);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Sum shards of namespace statistics
+ * @param [in] ns pointer to namespace
+ * @param [out] st statistics
+ */
+static void ll_stats_sum(struct ll_namespace *ns, struct ll_stats *st)
+{
+	const struct ll_stats_shard *s = __atomic_load_n(&ns->stats,
+		__ATOMIC_ACQUIRE);
+	uint64_t lat[LL_STATS_BUCKETS] = { 0 };
+
+	memset(st, 0, sizeof(*st));
+
+	if (!s) {
+		return;
+	}
+
+	for (size_t i = 0; i < LL_STATS_SHARDS; ++ i, ++ s) {
+		for (size_t l = 0; l <= LL_LEVEL_DEBUG; ++ l) {
+			struct ll_stats_level *sl = &st->level[l];
+
+			sl->emitted += __atomic_load_n(&s->count[l][LL_STAT_EMITTED],
+				__ATOMIC_RELAXED);
+			sl->filtered += __atomic_load_n(&s->count[l][LL_STAT_FILTERED],
+				__ATOMIC_RELAXED);
+			sl->dropped += __atomic_load_n(&s->count[l][LL_STAT_DROPPED],
+				__ATOMIC_RELAXED);
+			sl->bytes += __atomic_load_n(&s->count[l][LL_STAT_BYTES],
+				__ATOMIC_RELAXED);
+		}
+
+		st->time += __atomic_load_n(&s->time, __ATOMIC_RELAXED);
+
+		for (size_t b = 0; b < LL_STATS_BUCKETS; ++ b) {
+			lat[b] += __atomic_load_n(&s->lat[b], __ATOMIC_RELAXED);
+		}
+	}
+
+	for (size_t b = 0; b < LL_STATS_BUCKETS; ++ b) {
+		st->calls += lat[b];
+	}
+
+	/* percentiles are reported as highest latency of their buckets */
+	struct {
+		uint64_t *v;
+		uint64_t rank;
+	} q[] = {
+		{ &st->min, 1 },
+		{ &st->p50, (st->calls * 500 + 999) / 1000 },
+		{ &st->p90, (st->calls * 900 + 999) / 1000 },
+		{ &st->p99, (st->calls * 990 + 999) / 1000 },
+		{ &st->p999, (st->calls * 999 + 999) / 1000 },
+		{ &st->max, st->calls },
+	};
+	uint64_t n = 0;
+	size_t k = 0;
+
+	for (size_t b = 0; b < LL_STATS_BUCKETS && st->calls; ++ b) {
+		n += lat[b];
+
+		while (k < sizeof(q) / sizeof(q[0]) && n >= q[k].rank) {
+			*q[k ++].v = ll_stats_value(b);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_stats_enable(int enable)
+{
+	return (__atomic_exchange_n(&ll_stats_on, !!enable, __ATOMIC_RELAXED));
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_stats(const char *name, struct ll_stats *st)
+{
+	assert(name);
+	assert(st);
+
+	struct ll_namespace *ns = ll_ns_lookup(name);
+
+	/* out of memory? */
+	if (!ns) {
+		return (-1);
+	}
+
+	ll_stats_sum(ns, st);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** Target of ll_stats_dump() */
+struct ll_stats_target {
+	/** namespace, which receives statistics */
+	struct ll_namespace *ns;
+
+	/** logging level of statistics */
+	enum ll_level level;
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Log statistics of one namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] priv pointer to target
+ * @return always zero, to continue iteration
+ */
+static int ll_stats_dump_ns(struct ll_namespace *ns, void *priv)
+{
+	const struct ll_stats_target *t = priv;
+	struct ll_stats_level sum = { 0, 0, 0, 0 };
+	struct ll_stats st;
+
+	if (!__atomic_load_n(&ns->stats, __ATOMIC_ACQUIRE)) {
+		return (0);
+	}
+
+	ll_stats_sum(ns, &st);
+
+	for (size_t l = 0; l <= LL_LEVEL_DEBUG; ++ l) {
+		sum.emitted += st.level[l].emitted;
+		sum.filtered += st.level[l].filtered;
+		sum.dropped += st.level[l].dropped;
+		sum.bytes += st.level[l].bytes;
+	}
+
+	ll_printf_ns(t->ns, t->level, "stats \"%s\": emitted=%" PRIu64
+		" filtered=%" PRIu64 " dropped=%" PRIu64 " bytes=%" PRIu64
+		" calls=%" PRIu64 " time=%" PRIu64 "ns min=%" PRIu64
+		"ns p50=%" PRIu64 "ns p90=%" PRIu64 "ns p99=%" PRIu64
+		"ns p999=%" PRIu64 "ns max=%" PRIu64 "ns", ns->name,
+		sum.emitted, sum.filtered, sum.dropped, sum.bytes, st.calls,
+		st.time, st.min, st.p50, st.p90, st.p99, st.p999, st.max);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_stats_dump(const char *name, enum ll_level level)
+{
+	assert(name);
+
+	struct ll_stats_target t = { ll_ns_lookup(name), level };
+
+	/* out of memory? */
+	if (!t.ns) {
+		return (-1);
+	}
+
+	ll_ns_foreach(ll_stats_dump_ns, &t);
+
+	return (0);
+}
@@ -0,0 +1,105 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_STATS_H
+#define __LIBLOG_STATS_H
+
+#include <stdint.h>
+#include <liblog/types.h>
+
+#include "namespace.h"
+
+/** number of shards of counters, selected by CPU of thread */
+#define LL_STATS_SHARDS 16
+
+/** number of linear sub-buckets per power of two, as bits */
+#define LL_STATS_SUB_BITS 3
+
+/** latencies above 2^40 ns (~18 minutes) are clamped */
+#define LL_STATS_MAX_BITS 40
+
+/** number of buckets of latency histogram */
+#define LL_STATS_BUCKETS \
+	((LL_STATS_MAX_BITS - LL_STATS_SUB_BITS + 1) << LL_STATS_SUB_BITS)
+
+/** Counter of messages */
+enum ll_stat {
+	/** @copydoc ll_stats_level::emitted */
+	LL_STAT_EMITTED,
+
+	/** @copydoc ll_stats_level::filtered */
+	LL_STAT_FILTERED,
+
+	/** @copydoc ll_stats_level::dropped */
+	LL_STAT_DROPPED,
+
+	/** @copydoc ll_stats_level::bytes */
+	LL_STAT_BYTES,
+
+	/** number of counters */
+	LL_STAT_MAX,
+};
+
+/**
+ * @brief Shard of namespace statistics
+ *
+ * Threads running on different CPUs update different shards,
+ * shards are summed only by ll_stats().
+ */
+struct ll_stats_shard {
+	/** counters of messages per logging level */
+	uint64_t count[LL_LEVEL_DEBUG + 1][LL_STAT_MAX];
+
+	/** total time of logger calls */
+	uint64_t time;
+
+	/** log-linear histogram of logger call time */
+	uint64_t lat[LL_STATS_BUCKETS];
+} __attribute__((aligned(LL_CACHELINE)));
+
+/** non-zero, if statistics are collected, see ll_stats_enable() */
+extern int ll_stats_on;
+
+/**
+ * @brief Increase counter of namespace
+ * @param [in] ns pointer to namespace
+ * @param [in] level logging level of message
+ * @param [in] stat counter
+ * @param [in] n increment
+ *
+ * Should be called only if @ref ll_stats_on is set.
+ */
+void ll_stats_add(struct ll_namespace *ns, enum ll_level level,
+	enum ll_stat stat, uint64_t n
+);
+
+/**
+ * @brief Return start time of logger call
+ * @return monotonic time in nanoseconds
+ */
+uint64_t ll_stats_start(void);
+
+/**
+ * @brief Account time of logger call
+ * @param [in] ns pointer to namespace
+ * @param [in] start value returned by ll_stats_start()
+ */
+void ll_stats_latency(struct ll_namespace *ns, uint64_t start);
+
+#endif /* __LIBLOG_STATS_H */
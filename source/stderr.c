@@ -18,12 +18,13 @@
  */
 
 #include <assert.h>
-#include <inttypes.h>
-#include <stdio.h>
-#include <time.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <libtools/tools.h>
 
 #include "liblog/log.h"
+#include "namespace.h"
+#include "record.h"
 #include "stderr.h"
 
 /*------------------------------------------------------------------------*/
@@ -36,28 +37,25 @@ int ll_stderr_pr(void *priv, const char *name, enum ll_level level,
 	assert(name);
 	assert(format);
 
-	int rc = -1;
+	struct ll_record rec;
 
-	flockfile(stderr);
+	if (ll_record_render(&rec, name, level, LL_TS_SEC, format, args)) {
+		return (-1);
+	}
 
-	do {
-		if (fprintf(stderr, "%" PRIi64 ";%s;%s;",
-			(int64_t)time(NULL), name, ll_level_str(level)) < 0) {
-			break;
-		}
-
-		if (vfprintf(stderr, format, args) < 0) {
-			break;
-		}
+	return (ll_record_write(STDERR_FILENO, &rec));
+}
 
-		if (fputc('\n', stderr) < 0) {
-			break;
-		}
+/*------------------------------------------------------------------------*/
 
-		rc = 0;
-	} while (0);
+struct ll_sink *ll_stderr_sink(void)
+{
+	struct ll_sink *sink = calloc(1, sizeof(*sink));
 
-	funlockfile(stderr);
+	if (sink) {
+		sink->pr_cb = ll_stderr_pr;
+		sink->level = LL_LEVEL_INVALID;
+	}
 
-	return (rc);
+	return (sink);
 }
@@ -30,4 +30,11 @@ int ll_stderr_pr(void *priv, const char *name, enum ll_level level,
 	const char *format, va_list args
 );
 
+/**
+ * @brief Create sink of default logger
+ * @return pointer to sink, free it by ll_sink_free()
+ * @retval NULL error occurred
+ */
+struct ll_sink *ll_stderr_sink(void);
+
 #endif /* __LIBLOG_STDERR_H */
@@ -0,0 +1,502 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <libtools/tools.h>
+
+#include "uring.h"
+
+#ifdef LIBLOG_HAVE_IO_URING
+#include <linux/io_uring.h>
+
+/*------------------------------------------------------------------------*/
+
+/** Buffer of pool */
+struct ll_uring_buf {
+	/** file descriptor */
+	int fd;
+
+	/** offset of data in file */
+	off_t off;
+
+	/** length of data */
+	size_t len;
+
+	/** buffer is submitted */
+	int busy;
+};
+
+/** io_uring writer */
+struct ll_uring {
+	/** io_uring descriptor */
+	int ring;
+
+	/** mapped submission queue ring */
+	void *sq;
+
+	/** size of @ref sq */
+	size_t sq_size;
+
+	/** mapped completion queue ring, can be the same as @ref sq */
+	void *cq;
+
+	/** size of @ref cq */
+	size_t cq_size;
+
+	/** mapped submission queue entries */
+	struct io_uring_sqe *sqes;
+
+	/** size of @ref sqes */
+	size_t sqes_size;
+
+	/** submission queue head, advanced by kernel */
+	unsigned *sq_head;
+
+	/** submission queue tail */
+	unsigned *sq_tail;
+
+	/** submission queue mask */
+	unsigned sq_mask;
+
+	/** submission queue array */
+	unsigned *sq_array;
+
+	/** completion queue head */
+	unsigned *cq_head;
+
+	/** completion queue tail */
+	unsigned *cq_tail;
+
+	/** completion queue mask */
+	unsigned cq_mask;
+
+	/** completion queue entries */
+	struct io_uring_cqe *cqes;
+
+	/** some write failed */
+	int error;
+
+	/** count of buffers */
+	unsigned n;
+
+	/** size of each buffer */
+	size_t size;
+
+	/** memory of all buffers */
+	char *mem;
+
+	/** state of buffers */
+	struct ll_uring_buf bufs[];
+};
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Write data synchronously
+ * @param [in] fd file descriptor
+ * @param [in] buf data
+ * @param [in] len length of data
+ * @param [in] off offset in file
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_uring_pwrite(int fd, const char *buf, size_t len, off_t off)
+{
+	while (len) {
+		ssize_t n = pwrite(fd, buf, len, off);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return (-1);
+		}
+
+		buf += n;
+		len -= n;
+		off += n;
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Enter io_uring
+ * @param [in] u io_uring writer
+ * @param [in] submit count of entries to submit
+ * @param [in] wait count of completions to wait for
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_uring_enter(struct ll_uring *u, unsigned submit, unsigned wait)
+{
+	while (syscall(__NR_io_uring_enter, u->ring, submit, wait,
+		wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0) < 0) {
+		if (errno != EINTR) {
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return completed buffers to pool
+ * @param [in] u io_uring writer
+ */
+static void ll_uring_reap(struct ll_uring *u)
+{
+	unsigned head = *u->cq_head;
+
+	while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+		const struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+		struct ll_uring_buf *b = &u->bufs[cqe->user_data];
+		char *data = u->mem + cqe->user_data * u->size;
+
+		if (cqe->res < 0) {
+			u->error = 1;
+		} else if ((size_t)cqe->res < b->len) {
+			/* finish short write synchronously */
+			if (ll_uring_pwrite(b->fd, data + cqe->res, b->len - cqe->res,
+				b->off + cqe->res)) {
+				u->error = 1;
+			}
+		}
+
+		b->busy = 0;
+		++ head;
+	}
+
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Map rings of io_uring
+ * @param [in] u io_uring writer
+ * @param [in] p parameters returned by io_uring_setup()
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int ll_uring_map(struct ll_uring *u, const struct io_uring_params *p)
+{
+	u->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	u->cq_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_size > u->sq_size) {
+			u->sq_size = u->cq_size;
+		}
+
+		u->cq_size = u->sq_size;
+	}
+
+	u->sq = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_SQ_RING);
+
+	if (u->sq == MAP_FAILED) {
+		return (-1);
+	}
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		u->cq = u->sq;
+	} else {
+		u->cq = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_CQ_RING);
+
+		if (u->cq == MAP_FAILED) {
+			return (-1);
+		}
+	}
+
+	u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, u->ring, IORING_OFF_SQES);
+
+	if (u->sqes == MAP_FAILED) {
+		return (-1);
+	}
+
+	u->sq_head = (unsigned *)((char *)u->sq + p->sq_off.head);
+	u->sq_tail = (unsigned *)((char *)u->sq + p->sq_off.tail);
+	u->sq_mask = *(unsigned *)((char *)u->sq + p->sq_off.ring_mask);
+	u->sq_array = (unsigned *)((char *)u->sq + p->sq_off.array);
+	u->cq_head = (unsigned *)((char *)u->cq + p->cq_off.head);
+	u->cq_tail = (unsigned *)((char *)u->cq + p->cq_off.tail);
+	u->cq_mask = *(unsigned *)((char *)u->cq + p->cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)((char *)u->cq + p->cq_off.cqes);
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+struct ll_uring *ll_uring_new(unsigned n, size_t size)
+{
+	assert(n);
+	assert(size);
+
+	struct ll_uring *u = calloc(1, sizeof(*u) + n * sizeof(u->bufs[0]));
+	struct io_uring_params p;
+	struct iovec iov[n];
+
+	if (!u) {
+		return (NULL);
+	}
+
+	u->n = n;
+	u->size = size;
+	u->sq = u->cq = u->sqes = MAP_FAILED;
+
+	memset(&p, 0, sizeof(p));
+	u->ring = syscall(__NR_io_uring_setup, n, &p);
+
+	do {
+		if (u->ring < 0) {
+			break;
+		}
+
+		if (ll_uring_map(u, &p)) {
+			break;
+		}
+
+		if (posix_memalign((void **)&u->mem, sysconf(_SC_PAGESIZE),
+			n * size)) {
+			u->mem = NULL;
+
+			break;
+		}
+
+		for (unsigned i = 0; i < n; ++ i) {
+			iov[i].iov_base = u->mem + i * size;
+			iov[i].iov_len = size;
+		}
+
+		if (syscall(__NR_io_uring_register, u->ring, IORING_REGISTER_BUFFERS,
+			iov, n) < 0) {
+			break;
+		}
+
+		return (u);
+	} while (0);
+
+	ll_uring_free(u);
+
+	return (NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+char *ll_uring_buf(struct ll_uring *u)
+{
+	assert(u);
+
+	while (1) {
+		ll_uring_reap(u);
+
+		for (unsigned i = 0; i < u->n; ++ i) {
+			if (!u->bufs[i].busy) {
+				return (u->mem + i * u->size);
+			}
+		}
+
+		if (ll_uring_enter(u, 0, 1)) {
+			return (NULL);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_uring_write(struct ll_uring *u, int fd, char *buf, size_t len,
+	off_t off) {
+	assert(u);
+	assert(buf);
+	assert(len <= u->size);
+
+	unsigned i = (buf - u->mem) / u->size;
+	unsigned tail = *u->sq_tail;
+	unsigned idx = tail & u->sq_mask;
+	struct io_uring_sqe *sqe = &u->sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->fd = fd;
+	sqe->off = off;
+	sqe->addr = (uintptr_t)buf;
+	sqe->len = len;
+	sqe->buf_index = i;
+	sqe->user_data = i;
+
+	u->bufs[i].fd = fd;
+	u->bufs[i].off = off;
+	u->bufs[i].len = len;
+	u->bufs[i].busy = 1;
+
+	u->sq_array[idx] = idx;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	ll_uring_enter(u, 1, 0);
+
+	/*
+	 * Entry, consumed by kernel, will be completed even if enter failed,
+	 * so buffer stays busy until its completion. Otherwise take it back
+	 * and write buffer by self, there is no SQPOLL thread to race with.
+	 */
+	if (__atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) == tail) {
+		__atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+		u->bufs[i].busy = 0;
+		u->error = ll_uring_pwrite(fd, buf, len, off) ? 1 : u->error;
+	}
+
+	int rc = u->error ? -1 : 0;
+
+	u->error = 0;
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_uring_wait(struct ll_uring *u)
+{
+	assert(u);
+
+	while (1) {
+		unsigned busy = 0;
+
+		ll_uring_reap(u);
+
+		for (unsigned i = 0; i < u->n; ++ i) {
+			busy += u->bufs[i].busy;
+		}
+
+		if (!busy) {
+			break;
+		}
+
+		if (ll_uring_enter(u, 0, 1)) {
+			return (-1);
+		}
+	}
+
+	int rc = u->error ? -1 : 0;
+
+	u->error = 0;
+
+	return (rc);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_uring_free(struct ll_uring *u)
+{
+	if (!u) {
+		return;
+	}
+
+	if (u->ring >= 0) {
+		if (u->sqes != MAP_FAILED) {
+			ll_uring_wait(u);
+			munmap(u->sqes, u->sqes_size);
+		}
+
+		if (u->cq != MAP_FAILED && u->cq != u->sq) {
+			munmap(u->cq, u->cq_size);
+		}
+
+		if (u->sq != MAP_FAILED) {
+			munmap(u->sq, u->sq_size);
+		}
+
+		close(u->ring);
+	}
+
+	free(u->mem);
+	free(u);
+}
+
+#else /* LIBLOG_HAVE_IO_URING */
+
+/*------------------------------------------------------------------------*/
+
+struct ll_uring *ll_uring_new(unsigned n, size_t size)
+{
+	unused(n);
+	unused(size);
+
+	errno = ENOSYS;
+
+	return (NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+char *ll_uring_buf(struct ll_uring *u)
+{
+	unused(u);
+
+	return (NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_uring_write(struct ll_uring *u, int fd, char *buf, size_t len,
+	off_t off) {
+	unused(u);
+	unused(fd);
+	unused(buf);
+	unused(len);
+	unused(off);
+
+	return (-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+int ll_uring_wait(struct ll_uring *u)
+{
+	unused(u);
+
+	return (-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void ll_uring_free(struct ll_uring *u)
+{
+	unused(u);
+}
+
+#endif /* LIBLOG_HAVE_IO_URING */
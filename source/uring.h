@@ -0,0 +1,74 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LIBLOG_URING_H
+#define __LIBLOG_URING_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/** Opaque io_uring writer */
+struct ll_uring;
+
+/**
+ * @brief Create io_uring writer with pool of registered buffers
+ * @param [in] n count of buffers
+ * @param [in] size size of each buffer
+ * @return pointer to writer
+ * @retval NULL error occurred or io_uring is not available
+ */
+struct ll_uring *ll_uring_new(unsigned n, size_t size);
+
+/**
+ * @brief Get free buffer from pool, wait for completion if there is no one
+ * @param [in] u io_uring writer
+ * @return pointer to buffer
+ * @retval NULL error occurred
+ */
+char *ll_uring_buf(struct ll_uring *u);
+
+/**
+ * @brief Submit writing of buffer, it returns to pool after completion
+ * @param [in] u io_uring writer
+ * @param [in] fd file descriptor, should stay open until completion
+ * @param [in] buf buffer returned by ll_uring_buf()
+ * @param [in] len length of data
+ * @param [in] off offset in file
+ * @return on success, zero is returned
+ * @retval -1 error occurred, also reported for failed previous writes
+ */
+int ll_uring_write(struct ll_uring *u, int fd, char *buf, size_t len,
+	off_t off
+);
+
+/**
+ * @brief Wait for completion of all submitted writes
+ * @param [in] u io_uring writer
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+int ll_uring_wait(struct ll_uring *u);
+
+/**
+ * @brief Wait for submitted writes and free io_uring writer
+ * @param [in] u io_uring writer
+ */
+void ll_uring_free(struct ll_uring *u);
+
+#endif /* __LIBLOG_URING_H */
@@ -0,0 +1,118 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/binlog.h"
+#include "liblog/loggers/file.h"
+#include "liblog/loggers/mmap.h"
+#include "liblog/loggers/shm.h"
+
+/** Compile all messages of benchmark namespace */
+#define _LIBLOG_BENCH_LEVEL _LL_LEVEL_DEBUG
+
+/*------------------------------------------------------------------------*/
+
+/** Count of messages of each thread */
+static long bench_lines;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Log messages of one thread
+ * @param [in] arg number of thread
+ * @return @p arg
+ */
+static void *bench_writer(void *arg)
+{
+	int t = (int)(intptr_t)arg;
+
+	for (long i = 0; i < bench_lines; ++ i) {
+		LL_PR_NOTICE(BENCH, "thread %d message %ld payload %s", t, i,
+			"abcdefgh");
+	}
+
+	return (arg);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Measure throughput of logging
+ * @param [in] argc count of arguments
+ * @param [in] argv arguments: URI [threads [messages]]
+ * @return EXIT_SUCCESS on success
+ */
+int main(int argc, char **argv)
+{
+	struct timespec start, end;
+	long threads = 4;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s URI [threads [messages]]\n", argv[0]);
+
+		return (EXIT_FAILURE);
+	}
+
+	if (argc > 2) {
+		threads = strtol(argv[2], NULL, 0);
+	}
+
+	bench_lines = argc > 3 ? strtol(argv[3], NULL, 0) : 1000000;
+
+	pthread_t t[threads > 0 ? threads : 1];
+
+	if (threads <= 0 || bench_lines <= 0 ||
+		ll_logger_binlog() ||
+		ll_logger_file() ||
+		ll_logger_mmap() ||
+		ll_logger_shm() ||
+		ll_setup("BENCH", LL_LEVEL_DEBUG, argv[1])) {
+		fprintf(stderr, "%s: can't open logger\n", argv[1]);
+
+		return (EXIT_FAILURE);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (intptr_t i = 0; i < threads; ++ i) {
+		pthread_create(&t[i], NULL, bench_writer, (void *)i);
+	}
+
+	for (long i = 0; i < threads; ++ i) {
+		pthread_join(t[i], NULL);
+	}
+
+	/* buffered messages are part of work */
+	ll_cleanup();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double s = end.tv_sec - start.tv_sec +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%ld messages in %.3f s, %.0f messages/s\n", threads * bench_lines,
+		s, threads * bench_lines / s);
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,382 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "liblog/log.h"
+#include "liblog/loggers/file.h"
+
+/** Count of writer threads */
+#define TEST_THREADS 8
+
+/** Count of messages of each thread */
+#define TEST_LINES 20000
+
+/** Limit of file size for rotation cases */
+#define TEST_ROTATE_SIZE (1 << 20)
+
+/*------------------------------------------------------------------------*/
+
+/** State of one case */
+static struct {
+	/** writers are done */
+	int done;
+
+	/** messages, which were found in files */
+	unsigned char seen[TEST_THREADS][TEST_LINES];
+
+	/** count of failed checks */
+	unsigned failed;
+} test;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Log messages of one thread
+ * @param [in] arg number of thread
+ * @return @p arg
+ */
+static void *test_writer(void *arg)
+{
+	int t = (int)(intptr_t)arg;
+
+	for (int i = 0; i < TEST_LINES; ++ i) {
+		ll_printf("TEST", LL_LEVEL_NOTICE, "thread %d line %d", t, i);
+	}
+
+	return (arg);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Flush and reopen file, while writers are running
+ * @param [in] arg unused
+ * @return @p arg
+ */
+static void *test_flusher(void *arg)
+{
+	while (!__atomic_load_n(&test.done, __ATOMIC_ACQUIRE)) {
+		ll_flush("TEST");
+	}
+
+	return (arg);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Log messages by all threads and close logger
+ * @param [in] uri URI of file logger
+ * @param [in] flush flush file concurrently
+ * @return on success, zero is returned
+ * @retval -1 error occurred
+ */
+static int test_log(const char *uri, int flush)
+{
+	pthread_t t[TEST_THREADS], f;
+
+	if (ll_logger_file() || ll_setup("TEST", LL_LEVEL_DEBUG, uri)) {
+		fprintf(stderr, "%s: can't open logger\n", uri);
+		ll_cleanup();
+
+		return (-1);
+	}
+
+	test.done = 0;
+
+	if (flush) {
+		pthread_create(&f, NULL, test_flusher, NULL);
+	}
+
+	for (intptr_t i = 0; i < TEST_THREADS; ++ i) {
+		pthread_create(&t[i], NULL, test_writer, (void *)i);
+	}
+
+	for (int i = 0; i < TEST_THREADS; ++ i) {
+		pthread_join(t[i], NULL);
+	}
+
+	__atomic_store_n(&test.done, 1, __ATOMIC_RELEASE);
+
+	if (flush) {
+		pthread_join(f, NULL);
+	}
+
+	ll_cleanup();
+
+	return (0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Mark messages found in data
+ * @param [in] name name of checked file
+ * @param [in] data logged lines, null-terminated
+ */
+static void test_scan(const char *name, char *data)
+{
+	char *save = NULL;
+
+	for (char *line = strtok_r(data, "\n", &save); line;
+		line = strtok_r(NULL, "\n", &save)) {
+		const char *msg = strstr(line, "thread ");
+		int t, i;
+
+		if (!msg || sscanf(msg, "thread %d line %d", &t, &i) != 2 ||
+			t < 0 || t >= TEST_THREADS || i < 0 || i >= TEST_LINES) {
+			fprintf(stderr, "%s: broken line \"%s\"\n", name, line);
+			++ test.failed;
+		} else if (test.seen[t][i] ++) {
+			fprintf(stderr, "%s: duplicated line \"%s\"\n", name, line);
+			++ test.failed;
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check, that every message was logged once
+ * @param [in] name name of case
+ */
+static void test_seen(const char *name)
+{
+	unsigned lost = 0;
+
+	for (int t = 0; t < TEST_THREADS; ++ t) {
+		for (int i = 0; i < TEST_LINES; ++ i) {
+			lost += !test.seen[t][i];
+		}
+	}
+
+	if (lost) {
+		fprintf(stderr, "%s: %u lines lost\n", name, lost);
+		++ test.failed;
+	}
+
+	memset(test.seen, 0, sizeof(test.seen));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check and remove log files in directory
+ * @param [in] dir directory with log files
+ * @param [in] name name of case
+ * @param [in] limit maximal size of file, 0 - unlimited
+ */
+static void test_files(const char *dir, const char *name, size_t limit)
+{
+	DIR *d = opendir(dir);
+	struct dirent *e;
+
+	if (!d) {
+		perror(dir);
+		++ test.failed;
+
+		return;
+	}
+
+	while ((e = readdir(d))) {
+		char path[strlen(dir) + strlen(e->d_name) + 2];
+		struct stat st;
+		FILE *fp;
+
+		if (*e->d_name == '.') {
+			continue;
+		}
+
+		sprintf(path, "%s/%s", dir, e->d_name);
+
+		if (stat(path, &st) || !(fp = fopen(path, "r"))) {
+			perror(path);
+			++ test.failed;
+			continue;
+		}
+
+		char *data = malloc(st.st_size + 1);
+
+		if (!data || fread(data, 1, st.st_size, fp) != (size_t)st.st_size) {
+			fprintf(stderr, "%s: can't read\n", path);
+			++ test.failed;
+		} else {
+			data[st.st_size] = 0;
+			test_scan(path, data);
+		}
+
+		if (limit && (size_t)st.st_size > limit) {
+			fprintf(stderr, "%s: %s is bigger than %zu bytes\n", name, path,
+				limit);
+			++ test.failed;
+		}
+
+		free(data);
+		fclose(fp);
+		unlink(path);
+	}
+
+	closedir(d);
+	test_seen(name);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Log to regular file
+ * @param [in] dir directory for log files
+ * @param [in] query query of URI
+ * @param [in] flush flush file concurrently
+ * @param [in] limit maximal size of file, 0 - unlimited
+ */
+static void test_regular(const char *dir, const char *query, int flush,
+	size_t limit) {
+	char uri[strlen(dir) + strlen(query) + 16];
+
+	sprintf(uri, "file:%s/log?%s", dir, query);
+
+	if (test_log(uri, flush)) {
+		++ test.failed;
+
+		return;
+	}
+
+	test_files(dir, uri, limit);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Read pipe until end of file
+ * @param [in] arg pointer to read end of pipe
+ * @return read data, null-terminated
+ */
+static void *test_reader(void *arg)
+{
+	int fd = *(int *)arg;
+	size_t len = 0, size = 1 << 16;
+	char *data = malloc(size);
+	ssize_t n;
+
+	while (data && (n = read(fd, data + len, size - len - 1)) > 0) {
+		len += n;
+
+		if (size - len < 4096 && !(data = realloc(data, size *= 2))) {
+			break;
+		}
+	}
+
+	if (data) {
+		data[len] = 0;
+	}
+
+	return (data);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Log to pipe, which can't be written by offset
+ * @param [in] query query of URI
+ */
+static void test_pipe(const char *query)
+{
+	char uri[64];
+	pthread_t r;
+	void *data;
+	int fds[2];
+
+	if (pipe(fds)) {
+		perror("pipe");
+		++ test.failed;
+
+		return;
+	}
+
+	snprintf(uri, sizeof(uri), "file:/dev/fd/%d?%s", fds[1], query);
+	pthread_create(&r, NULL, test_reader, &fds[0]);
+
+	if (test_log(uri, 0)) {
+		++ test.failed;
+	}
+
+	close(fds[1]);
+	pthread_join(r, &data);
+	close(fds[0]);
+
+	if (!data) {
+		fprintf(stderr, "%s: can't read\n", uri);
+		++ test.failed;
+
+		return;
+	}
+
+	test_scan(uri, data);
+	test_seen(uri);
+	free(data);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Check file logger under concurrent writes, flushes and rotation
+ * @return EXIT_SUCCESS, if no message is lost
+ */
+int main(void)
+{
+	char dir[] = "liblog-file-XXXXXX";
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+
+		return (EXIT_FAILURE);
+	}
+
+	/* reopening by ll_flush() doesn't lose buffered data */
+	test_regular(dir, "buffer=64K", 1, 0);
+	test_regular(dir, "buffer=0", 1, 0);
+	test_regular(dir, "engine=uring&buffer=8K", 1, 0);
+
+	/* rotated files don't grow over limit */
+	test_regular(dir, "rotate_size=1M", 0, TEST_ROTATE_SIZE);
+	test_regular(dir, "rotate_size=1M&buffer=0", 1, TEST_ROTATE_SIZE);
+	test_regular(dir, "rotate_size=1M&engine=uring&buffer=8K", 1,
+		TEST_ROTATE_SIZE);
+
+	/* pipes can't be written by offset */
+	test_pipe("buffer=64K");
+	test_pipe("engine=uring&buffer=8K");
+
+	rmdir(dir);
+
+	if (test.failed) {
+		fprintf(stderr, "%u checks failed\n", test.failed);
+
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,370 @@
+/**
+ * @file
+ *
+ * Copyright (C) 2016  Oleh Kravchenko <oleg@kaa.org.ua>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../source/buf.h"
+#include "../source/format.h"
+#include "../source/printf.h"
+
+/** Default count of random format strings */
+#define TEST_ITERATIONS 200000
+
+/** Size of buffers for formatted and packed data */
+#define TEST_BUF_SIZE 1024
+
+/*------------------------------------------------------------------------*/
+
+/** State of random generator */
+static uint64_t test_seed;
+
+/** Count of mismatches */
+static unsigned test_failed;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return random number (xorshift64)
+ * @return random number
+ */
+static uint64_t test_rand(void)
+{
+	test_seed ^= test_seed << 13;
+	test_seed ^= test_seed >> 7;
+	test_seed ^= test_seed << 17;
+
+	return (test_seed);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return random number of random magnitude
+ * @return random number
+ */
+static uint64_t test_num(void)
+{
+	uint64_t v = test_rand();
+
+	return (v >> (v % 64));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return random floating point number
+ * @return random number, including special values
+ */
+static double test_double(void)
+{
+	static const double special[] = {
+		0.0, -0.0, 1.0, -1.5, 0.1, 1e300, -1e-300, 123456.789,
+	};
+
+	switch (test_rand() % 4) {
+	case 0:
+		return (special[test_rand() % (sizeof(special) / sizeof(*special))]);
+
+	case 1:
+		return (test_rand() % 2 ? INFINITY : -INFINITY);
+
+	case 2:
+		return (NAN);
+
+	default:
+		return ((double)(int64_t)test_rand() / (double)(test_num() | 1));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Return random string
+ * @return pointer to string or NULL
+ */
+static const char *test_str(void)
+{
+	static const char * const pool[] = {
+		"", "a", "hello", "liblog message",
+		"0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ",
+		NULL,
+	};
+
+	return (pool[test_rand() % (sizeof(pool) / sizeof(*pool))]);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Format arguments by libc, own printf and deferred formatting
+ * @param [in] format format string
+ * @param [in] ... arguments
+ *
+ * Outputs of own code are compared with vsnprintf().
+ */
+static void test_check(const char *format, ...)
+{
+	char ref[TEST_BUF_SIZE];
+	unsigned char packed[TEST_BUF_SIZE];
+	struct ll_buf own, def;
+	struct ll_fmt *fmt;
+	va_list args, ap;
+
+	memset(&own, 0, sizeof(own));
+	memset(&def, 0, sizeof(def));
+	va_start(args, format);
+
+	va_copy(ap, args);
+	vsnprintf(ref, sizeof(ref), format, ap);
+	va_end(ap);
+
+	va_copy(ap, args);
+
+	if (ll_vformat(&own, format, ap) || strcmp(ref, own.data)) {
+		fprintf(stderr, "printf \"%s\": \"%s\" != \"%s\"\n", format,
+			own.data ? own.data : "", ref);
+		++ test_failed;
+	}
+
+	va_end(ap);
+
+	/* conversions, which can't be deferred, are printed at once */
+	if ((fmt = ll_fmt_parse(format)) && !fmt->eager) {
+		va_copy(ap, args);
+
+		int n = ll_fmt_pack(fmt, packed, sizeof(packed), ap);
+
+		if (n < 0 || ll_fmt_render(fmt, packed, n, &def) ||
+			strcmp(ref, def.data)) {
+			fprintf(stderr, "deferred \"%s\": \"%s\" != \"%s\"\n", format,
+				def.data ? def.data : "", ref);
+			++ test_failed;
+		}
+
+		va_end(ap);
+	}
+
+	va_end(args);
+	ll_fmt_free(fmt);
+	ll_buf_free(&def);
+	ll_buf_free(&own);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Pass argument after optional width and precision
+ * @param [in] stars count of arguments for width and precision
+ * @param [in] spec format string
+ * @param [in] w width, or precision if there is only one star
+ * @param [in] p precision
+ * @param [in] v argument of conversion
+ */
+#define TEST_CHECK(stars, spec, w, p, v) \
+	do { \
+		if ((stars) == 2) { \
+			test_check((spec), (w), (p), (v)); \
+		} else if ((stars) == 1) { \
+			test_check((spec), (w), (v)); \
+		} else { \
+			test_check((spec), (v)); \
+		} \
+	} while (0)
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Generate random conversion and check it
+ *
+ * Only combinations of flags, length modifiers and conversions,
+ * which are defined by C standard or glibc, are generated.
+ */
+static void test_random(void)
+{
+	static const char convs[] = "diuxXocspfeEgGaA%";
+	static const char * const lens[] = {
+		"", "hh", "h", "l", "ll", "j", "z", "t",
+	};
+	char conv = convs[test_rand() % (sizeof(convs) - 1)];
+	const char *len = "";
+	char spec[64];
+	size_t n = 0;
+	int star[2] = { 0, 0 };
+	int stars = 0;
+
+	n += sprintf(spec + n, "%s", test_rand() % 2 ? "text " : "");
+	spec[n ++] = '%';
+
+	if (conv == '%') {
+		sprintf(spec + n, "%% tail");
+		test_check(spec, 0);
+
+		return;
+	}
+
+	/* flags */
+	if (test_rand() % 4 == 0) {
+		spec[n ++] = '-';
+	}
+
+	if (test_rand() % 4 == 0 && strchr("dipfeEgGaA", conv)) {
+		spec[n ++] = test_rand() % 2 ? '+' : ' ';
+	}
+
+	if (test_rand() % 4 == 0 && strchr("xXofeEgGaA", conv)) {
+		spec[n ++] = '#';
+	}
+
+	if (test_rand() % 4 == 0 && !strchr("cs", conv)) {
+		spec[n ++] = '0';
+	}
+
+	/* width */
+	switch (test_rand() % 3) {
+	case 1:
+		n += sprintf(spec + n, "%d", (int)(test_rand() % 21));
+		break;
+
+	case 2:
+		spec[n ++] = '*';
+		star[stars ++] = (int)(test_rand() % 41) - 20;
+		break;
+	}
+
+	/* precision */
+	switch (conv == 'c' ? 0 : test_rand() % 4) {
+	case 1:
+		spec[n ++] = '.';
+		break;
+
+	case 2:
+		n += sprintf(spec + n, ".%d", (int)(test_rand() % 21));
+		break;
+
+	case 3:
+		n += sprintf(spec + n, ".*");
+		star[stars ++] = (int)(test_rand() % 24) - 3;
+		break;
+	}
+
+	if (strchr("diuxXo", conv)) {
+		len = lens[test_rand() % (sizeof(lens) / sizeof(*lens))];
+	} else if (strchr("feEgGaA", conv) && test_rand() % 4 == 0) {
+		len = "L";
+	}
+
+	sprintf(spec + n, "%s%c tail", len, conv);
+
+	uint64_t v = test_num();
+	int neg = strchr("di", conv) && test_rand() % 2;
+
+	switch (conv) {
+	case 'd':
+	case 'i':
+		if (neg) {
+			v = -v;
+		}
+
+		/* fall through */
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'o':
+		if (!strcmp(len, "l")) {
+			TEST_CHECK(stars, spec, star[0], star[1], (unsigned long)v);
+		} else if (!strcmp(len, "ll")) {
+			TEST_CHECK(stars, spec, star[0], star[1], (unsigned long long)v);
+		} else if (!strcmp(len, "j")) {
+			TEST_CHECK(stars, spec, star[0], star[1], (uintmax_t)v);
+		} else if (!strcmp(len, "z")) {
+			TEST_CHECK(stars, spec, star[0], star[1], (size_t)v);
+		} else if (!strcmp(len, "t")) {
+			TEST_CHECK(stars, spec, star[0], star[1], (ptrdiff_t)v);
+		} else {
+			TEST_CHECK(stars, spec, star[0], star[1], (unsigned)v);
+		}
+
+		break;
+
+	case 'c':
+		TEST_CHECK(stars, spec, star[0], star[1], (int)(' ' + v % 95));
+		break;
+
+	case 's':
+		TEST_CHECK(stars, spec, star[0], star[1], test_str());
+		break;
+
+	case 'p':
+		TEST_CHECK(stars, spec, star[0], star[1], (void *)(uintptr_t)(v % 4 ? v : 0));
+		break;
+
+	default:
+		if (*len) {
+			TEST_CHECK(stars, spec, star[0], star[1], (long double)test_double());
+		} else {
+			TEST_CHECK(stars, spec, star[0], star[1], test_double());
+		}
+
+		break;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief Compare own and deferred formatting with libc
+ * @param [in] argc count of arguments
+ * @param [in] argv arguments: [seed [iterations]]
+ * @return EXIT_SUCCESS, if all outputs are the same
+ */
+int main(int argc, char **argv)
+{
+	unsigned long n = TEST_ITERATIONS;
+
+	test_seed = argc > 1 ? strtoull(argv[1], NULL, 0) : 0x9e3779b97f4a7c15;
+	test_seed |= 1;
+
+	if (argc > 2) {
+		n = strtoul(argv[2], NULL, 0);
+	}
+
+	/* cases, which were broken before */
+	test_check("%020p|%-20p|%+p|% p|%.12p", (void *)0x1234abc,
+		(void *)0x1234abc, (void *)0x1234abc, (void *)0x1234abc,
+		(void *)0x1234abc);
+	test_check("%.3s|%8.3s|%-8s|%.0s|%s", (char *)NULL, (char *)NULL,
+		(char *)NULL, (char *)NULL, (char *)NULL);
+
+	while (n --) {
+		test_random();
+	}
+
+	if (test_failed) {
+		fprintf(stderr, "%u mismatches\n", test_failed);
+
+		return (EXIT_FAILURE);
+	}
+
+	return (EXIT_SUCCESS);
+}